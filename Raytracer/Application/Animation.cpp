@@ -0,0 +1,73 @@
+#include "Animation.h"
+#include <algorithm>
+
+namespace
+{
+    Math::Vector Lerp(const Math::Vector& a, const Math::Vector& b, const float t)
+    {
+        return a + (b - a) * t;
+    }
+
+    // Index of the last key at or before the time and the blend factor to the next key.
+    template<typename Key>
+    size_t FindKey(const std::vector<Key>& keys, const float time, float& t)
+    {
+        const auto next = std::upper_bound(keys.begin(), keys.end(), time, [](const float value, const Key& key) { return value < key.time; });
+        t = 0.f;
+        if (next == keys.begin())
+        {
+            return 0;
+        }
+        const auto index = static_cast<size_t>(next - keys.begin()) - 1;
+        if (next != keys.end() && next->time > keys[index].time)
+        {
+            t = (time - keys[index].time) / (next->time - keys[index].time);
+        }
+        return index;
+    }
+}
+
+float Animation::Duration() const
+{
+    float duration = camera.empty() ? 0.f : camera.back().time;
+    for (const auto& track : tracks)
+    {
+        if (!track.keys.empty())
+        {
+            duration = std::max(duration, track.keys.back().time);
+        }
+    }
+    return duration;
+}
+
+void Animation::Apply(const float time, Camera& output) const
+{
+    if (!camera.empty())
+    {
+        float t;
+        const auto index = FindKey(camera, time, t);
+        const auto& key = camera[index];
+        const auto& next = camera[std::min(index + 1, camera.size() - 1)];
+        output.position = Lerp(key.position, next.position, t);
+        output.LookAtTarget(Lerp(key.target, next.target, t));
+    }
+
+    for (const auto& track : tracks)
+    {
+        if (track.keys.empty())
+        {
+            continue;
+        }
+        float t;
+        const auto index = FindKey(track.keys, time, t);
+        const auto& key = track.keys[index];
+        const auto& next = track.keys[std::min(index + 1, track.keys.size() - 1)];
+        const auto position = Lerp(key.position, next.position, t);
+        const auto rotation = Lerp(key.rotation, next.rotation, t);
+        for (const auto& primitive : track.primitives)
+        {
+            primitive->position = position;
+            primitive->rotation = rotation;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Raytracer/Camera.h"
+#include "Raytracer/Primitives.h"
+
+// Keyframed motion of the camera and the scene primitives.
+// Values are interpolated linearly between the keys and hold before the first and after the last key.
+// Keys are sorted by their time in seconds.
+struct Animation
+{
+    struct CameraKey
+    {
+        float time = 0.f;
+        Math::Vector position;
+        Math::Vector target;
+    };
+
+    struct PrimitiveKey
+    {
+        float time = 0.f;
+        Math::Vector position;
+        Math::Vector rotation;
+    };
+
+    // Primitives moved together by the same keys, e.g. the instances of a model.
+    struct Track
+    {
+        std::vector<Primitive*> primitives;
+        std::vector<PrimitiveKey> keys;
+    };
+
+    std::vector<CameraKey> camera;
+    std::vector<Track> tracks;
+
+    bool Empty() const { return camera.empty() && tracks.empty(); }
+
+    // Time of the last key.
+    float Duration() const;
+
+    // Move the camera and the primitives to their state at the time.
+    // The camera is not changed if there are no camera keys.
+    void Apply(const float time, Camera&) const;
+};
@@ -0,0 +1,627 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include "Application/CacheCounters.h"
+#include "Application/Distributed.h"
+#include "Application/ImageFile.h"
+#include "Application/ObjFile.h"
+#include "Application/SceneCache.h"
+#include "Application/Sample.h"
+#include "Application/SceneFile.h"
+#include "Application/Sequence.h"
+
+// Headless batch renderer.
+// Renders the sample scene or a scene file and prints the timing report.
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        std::string scene;
+        std::string cache;
+        std::string output = "output.ppm";
+        int width = 1280;
+        int height = 720;
+        int frames = 1;
+        bool progressive = false;
+        int sequence = 0;
+        float frameRate = 24.f;
+        int inFlight = 2;
+        bool turntable = false;
+        std::string listen;
+        std::string connect;
+        std::string costs;
+        std::string stats;
+        Distributed::Settings distributed;
+        RenderSettings settings;
+        ResolveSettings resolve;
+    };
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: raytracer-batch [options]\n"
+            "  --scene FILE      Scene file or .obj model to render, the sample scene is used by default.\n"
+            "  --width N         Image width (default 1280).\n"
+            "  --height N        Image height (default 720).\n"
+            "  --threads N       Rendering threads, 0 uses all hardware threads (default 0).\n"
+            "  --tile N          Tile size in pixels (default 32).\n"
+            "  --order NAME      Pixel order within the tiles: scanline, morton or hilbert (default hilbert).\n"
+            "  --frames N        Number of rendered frames, timings are averaged (default 1).\n"
+            "  --no-packets      Trace single rays instead of SIMD packets.\n"
+            "  --aa N            Adaptive anti-aliasing with up to N samples per edge pixel, rounded down to a\n"
+            "                    square grid of at least 2x2 (default 1, off).\n"
+            "  --aa-threshold T  Color difference of the anti-aliased neighbours (default 0.1).\n"
+            "  --exposure E      Exposure multiplier of the colors (default 1).\n"
+            "  --tonemap NAME    Tone mapping: clamp, reinhard or aces (default clamp).\n"
+            "  --srgb            Encode the output with the sRGB curve.\n"
+            "  --cache FILE      Binary scene cache, loaded if its sources did not change, otherwise written.\n"
+            "  --progressive     Render in coarse to fine passes and print the pass times.\n"
+            "  --incremental     Retrace only the pixels affected by the scene changes after the first frame.\n"
+            "  --sequence N      Render N animation frames to numbered images, see the scene file keys.\n"
+            "  --fps F           Frame rate of the sequence (default 24).\n"
+            "  --in-flight N     Framebuffers rendered or written at the same time by the sequence (default 2).\n"
+            "  --turntable       The camera orbits the scene once over the sequence.\n"
+            "  --listen ADDRESS  Coordinate the workers rendering the image, host:port or unix:path.\n"
+            "  --connect ADDRESS Work for the coordinator, the scene has to be the same.\n"
+            "  --chunk N         Tile size handed out to the workers (default 64).\n"
+            "  --costs PREFIX    Record the per-pixel costs and write PREFIX-tests, -nodes, -lights and -cycles\n"
+            "                    as .png heatmaps and .pfm float maps.\n"
+            "  --stats FILE      Write the render statistics of the last frame as JSON, - prints them.\n"
+            "  --output FILE     Output image, .png or .ppm (default output.ppm).\n"
+        );
+    }
+
+    // Returns false for invalid arguments.
+    bool ParseOptions(const int argc, char** const argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string name = argv[i];
+            if (name == "--no-packets")
+            {
+                options.settings.packetTracing = false;
+                continue;
+            }
+            if (name == "--srgb")
+            {
+                options.resolve.srgb = true;
+                continue;
+            }
+            if (name == "--progressive")
+            {
+                options.progressive = true;
+                continue;
+            }
+            if (name == "--incremental")
+            {
+                options.settings.incrementalRendering = true;
+                continue;
+            }
+            if (name == "--turntable")
+            {
+                options.turntable = true;
+                continue;
+            }
+
+            // Options with a value.
+            if (i + 1 >= argc)
+            {
+                return false;
+            }
+            const char* const value = argv[++i];
+
+            if (name == "--scene")
+            {
+                options.scene = value;
+            }
+            else if (name == "--cache")
+            {
+                options.cache = value;
+            }
+            else if (name == "--output")
+            {
+                options.output = value;
+            }
+            else if (name == "--stats")
+            {
+                options.stats = value;
+            }
+            else if (name == "--costs")
+            {
+                options.costs = value;
+                options.settings.costInstrumentation = true;
+            }
+            else if (name == "--width")
+            {
+                options.width = std::atoi(value);
+            }
+            else if (name == "--height")
+            {
+                options.height = std::atoi(value);
+            }
+            else if (name == "--threads")
+            {
+                options.settings.threadCount = std::atoi(value);
+            }
+            else if (name == "--tile")
+            {
+                options.settings.tileSize = std::atoi(value);
+            }
+            else if (name == "--aa")
+            {
+                options.settings.antialiasingSamples = std::atoi(value);
+            }
+            else if (name == "--aa-threshold")
+            {
+                options.settings.antialiasingThreshold = static_cast<float>(std::atof(value));
+            }
+            else if (name == "--exposure")
+            {
+                options.resolve.exposure = static_cast<float>(std::atof(value));
+            }
+            else if (name == "--tonemap")
+            {
+                const std::string toneMapping = value;
+                if (toneMapping == "clamp")
+                {
+                    options.resolve.toneMapping = ToneMapping::Clamp;
+                }
+                else if (toneMapping == "reinhard")
+                {
+                    options.resolve.toneMapping = ToneMapping::Reinhard;
+                }
+                else if (toneMapping == "aces")
+                {
+                    options.resolve.toneMapping = ToneMapping::Aces;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if (name == "--order")
+            {
+                const std::string order = value;
+                if (order == "scanline")
+                {
+                    options.settings.pixelOrder = PixelOrder::Scanline;
+                }
+                else if (order == "morton")
+                {
+                    options.settings.pixelOrder = PixelOrder::Morton;
+                }
+                else if (order == "hilbert")
+                {
+                    options.settings.pixelOrder = PixelOrder::Hilbert;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if (name == "--frames")
+            {
+                options.frames = std::atoi(value);
+            }
+            else if (name == "--listen")
+            {
+                options.listen = value;
+            }
+            else if (name == "--connect")
+            {
+                options.connect = value;
+            }
+            else if (name == "--chunk")
+            {
+                options.distributed.tileSize = std::atoi(value);
+            }
+            else if (name == "--sequence")
+            {
+                options.sequence = std::atoi(value);
+            }
+            else if (name == "--fps")
+            {
+                options.frameRate = static_cast<float>(std::atof(value));
+            }
+            else if (name == "--in-flight")
+            {
+                options.inFlight = std::atoi(value);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return options.width > 0 && options.height > 0 && options.frames > 0 && options.settings.threadCount >= 0 &&
+            options.sequence >= 0 && options.frameRate > 0.f && options.inFlight > 0 && !(options.sequence > 0 && options.progressive) &&
+            options.distributed.tileSize > 0 && (options.listen.empty() || options.connect.empty()) &&
+            ((options.listen.empty() && options.connect.empty()) || (options.sequence == 0 && !options.progressive)) &&
+            (options.costs.empty() || (options.sequence == 0 && !options.progressive && options.listen.empty() && options.connect.empty()));
+    }
+
+    double Milliseconds(const double seconds)
+    {
+        return seconds * 1000.0;
+    }
+
+    bool EndsWith(const std::string& text, const std::string& suffix)
+    {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // Load the OBJ model with a camera in front of it and a light at the camera.
+    bool LoadObj(const std::string& path, Raytracer& raytracer, Scene& scene, Camera& camera, std::string& error, std::vector<std::string>& sources)
+    {
+        ObjFile::Model model;
+        ObjFile::Statistics statistics;
+        if (!ObjFile::LoadScene(path, raytracer, scene, camera, model, statistics, error, raytracer.Settings().threadCount))
+        {
+            return false;
+        }
+        sources = model.files;
+
+        const double megabytes = static_cast<double>(statistics.bytes) / (1024.0 * 1024.0);
+        std::printf("Load: %.3f ms parse, %.3f ms build, %.1f MB at %.1f MB/s\n", Milliseconds(statistics.parseTime), Milliseconds(statistics.buildTime),
+            megabytes, statistics.parseTime > 0.0 ? megabytes / statistics.parseTime : 0.0);
+        std::printf("Model: %zu meshes, %zu vertices, %zu triangles, %zu materials\n", model.parts.size(), statistics.vertices, statistics.triangles, statistics.materials);
+        return true;
+    }
+
+    // Write the heatmap and the float map of every pixel cost and print their statistics.
+    // The heatmaps are scaled to the 99th percentile, so a few expensive pixels do not hide the rest of the image.
+    bool WriteCosts(const std::string& prefix, const PixelCosts& costs)
+    {
+        const struct
+        {
+            const char* name;
+            const std::vector<float>& values;
+        } maps[] = {
+            {"tests", costs.tests},
+            {"nodes", costs.nodes},
+            {"lights", costs.lights},
+            {"cycles", costs.cycles},
+        };
+
+        for (const auto& map : maps)
+        {
+            if (map.values.empty())
+            {
+                continue;
+            }
+
+            double sum = 0.0;
+            for (const float value : map.values)
+            {
+                sum += value;
+            }
+            std::vector<float> sorted = map.values;
+            const auto percentile = sorted.begin() + static_cast<std::ptrdiff_t>((sorted.size() - 1) * 99 / 100);
+            std::nth_element(sorted.begin(), percentile, sorted.end());
+            const float scale = *percentile;
+            const float maximum = *std::max_element(percentile, sorted.end());
+
+            const std::string path = prefix + "-" + map.name;
+            if (!ImageFile::WritePng(path + ".png", ImageFile::Heatmap(map.values, scale), costs.width, costs.height) ||
+                !ImageFile::WritePfm(path + ".pfm", map.values, costs.width, costs.height))
+            {
+                std::fprintf(stderr, "Can not write %s\n", path.c_str());
+                return false;
+            }
+            std::printf("Costs %s: %.1f mean, %.0f at 99%%, %.0f max per pixel (%s.png, %s.pfm)\n", map.name, sum / static_cast<double>(map.values.size()),
+                scale, maximum, path.c_str(), path.c_str());
+        }
+        return true;
+    }
+
+    // Replace the camera keys by one orbit around the vertical axis through the center of the bounded primitives.
+    // The camera keeps its height and its view relative to the axis.
+    void AddTurntable(const Scene& scene, const Camera& camera, const int frameCount, const float frameRate, Animation& animation)
+    {
+        Math::Box bounds;
+        for (const auto& primitive : scene.primitives)
+        {
+            if (primitive == nullptr)
+            {
+                continue;
+            }
+
+            primitive->Transform();
+            const auto box = primitive->Bounds();
+            if (!box.Empty() && box.Finite())
+            {
+                bounds.Extend(box);
+            }
+        }
+        const auto pivot = bounds.Empty() ? Math::Vector() : bounds.Center();
+        const auto position = camera.position - pivot;
+        const auto target = position + camera.Look();
+
+        // A key per frame, the last frame is one step before the full turn.
+        animation.camera.clear();
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            const float angle = 2.f * Math::Pi * static_cast<float>(frame) / static_cast<float>(frameCount);
+            const float c = std::cos(angle);
+            const float s = std::sin(angle);
+            Animation::CameraKey key;
+            key.time = static_cast<float>(frame) / frameRate;
+            key.position = pivot + Math::Vector(position.x * c + position.z * s, position.y, position.z * c - position.x * s, 0.f);
+            key.target = pivot + Math::Vector(target.x * c + target.z * s, target.y, target.z * c - target.x * s, 0.f);
+            animation.camera.push_back(key);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // The counters have to exist before the rendering threads.
+    CacheCounters cacheCounters;
+
+    Raytracer raytracer;
+    raytracer.SetSettings(options.settings);
+
+    // Create the scene, the cache is used if its sources did not change.
+    // The cache does not store the keys of the scene files, so animated scene files are always loaded.
+    Scene scene;
+    Camera camera;
+    Animation animation;
+    std::string error;
+    bool cached = false;
+    if (!options.cache.empty() && options.sequence > 0 && !options.scene.empty() && !EndsWith(options.scene, ".obj"))
+    {
+        std::printf("Scene cache: not used by the scene file sequences\n");
+        options.cache.clear();
+    }
+    if (!options.cache.empty())
+    {
+        const auto start = Clock::now();
+        cached = SceneCache::Load(options.cache, options.scene, raytracer, scene, camera, error);
+        if (cached)
+        {
+            std::printf("Scene cache: loaded %s in %.3f ms\n", options.cache.c_str(), Milliseconds(std::chrono::duration<double>(Clock::now() - start).count()));
+        }
+        else
+        {
+            std::printf("Scene cache: %s\n", error.c_str());
+        }
+    }
+    if (!cached)
+    {
+        std::vector<std::string> sources;
+        if (options.scene.empty())
+        {
+            Sample::Create(raytracer, scene, camera);
+        }
+        else
+        {
+            const bool loaded = EndsWith(options.scene, ".obj") ?
+                LoadObj(options.scene, raytracer, scene, camera, error, sources) :
+                SceneFile::Load(options.scene, raytracer, scene, camera, error, &sources, &animation);
+            if (!loaded)
+            {
+                std::fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+        }
+
+        if (!options.cache.empty())
+        {
+            const auto start = Clock::now();
+            if (SceneCache::Write(options.cache, options.scene, sources, raytracer, scene, camera, error))
+            {
+                std::printf("Scene cache: written %s in %.3f ms\n", options.cache.c_str(), Milliseconds(std::chrono::duration<double>(Clock::now() - start).count()));
+            }
+            else
+            {
+                std::printf("Scene cache: %s\n", error.c_str());
+            }
+        }
+    }
+
+    Framebuffer framebuffer(FramebufferFormat::RGBA8);
+    framebuffer.Resize(options.width, options.height);
+    framebuffer.SetResolveSettings(options.resolve);
+    camera.SetAspectRatio(static_cast<float>(options.width), static_cast<float>(options.height));
+
+    std::printf("Scene: %s (%zu primitives, %zu lights)\n", options.scene.empty() ? "sample" : options.scene.c_str(), scene.primitives.size(), scene.lights.size());
+    const char* const orders[] = {"scanline", "morton", "hilbert"};
+    std::printf("Resolution: %dx%d, threads: %d, tile: %d, order: %s, packets: %s\n", options.width, options.height, raytracer.ThreadCount(),
+        raytracer.Settings().tileSize, orders[static_cast<int>(raytracer.Settings().pixelOrder)], (raytracer.Settings().packetTracing && Math::Simd::Native) ? "on" : "off");
+
+    if (!options.connect.empty())
+    {
+        std::printf("Worker: connecting to %s\n", options.connect.c_str());
+        if (!Distributed::Work(options.connect, raytracer, scene, camera, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        std::printf("Worker: done\n");
+        return 0;
+    }
+
+    if (!options.listen.empty())
+    {
+        std::printf("Coordinator: listening on %s\n", options.listen.c_str());
+        Distributed::Statistics statistics;
+        if (!Distributed::Coordinate(options.listen, options.distributed, raytracer, scene, camera, framebuffer, statistics, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        if (!ImageFile::Write(options.output, ImageFile::PackRgb(framebuffer), options.width, options.height))
+        {
+            std::fprintf(stderr, "Can not write %s\n", options.output.c_str());
+            return 1;
+        }
+
+        std::printf("Distributed: %d tiles of %d pixels, %d reassigned, %d discarded\n", statistics.tiles, options.distributed.tileSize,
+            statistics.reassigned, statistics.discarded);
+        std::printf("Wall time: %.3f ms\n", Milliseconds(statistics.time));
+        for (size_t i = 0; i < statistics.workers.size(); ++i)
+        {
+            const auto& worker = statistics.workers[i];
+            std::printf("Worker %zu: %d threads, %d tiles, %.3f Mpixels/s%s\n", i + 1, worker.threads, worker.tiles,
+                worker.time > 0.0 ? static_cast<double>(worker.pixels) / worker.time / 1e6 : 0.0, worker.failed ? ", failed" : "");
+        }
+        std::printf("Write: %s\n", options.output.c_str());
+        return 0;
+    }
+
+    if (options.sequence > 0)
+    {
+        if (options.turntable)
+        {
+            AddTurntable(scene, camera, options.sequence, options.frameRate, animation);
+        }
+
+        Sequence::Settings settings;
+        settings.width = options.width;
+        settings.height = options.height;
+        settings.resolve = options.resolve;
+        settings.frameCount = options.sequence;
+        settings.frameRate = options.frameRate;
+        settings.framebufferCount = options.inFlight;
+        settings.output = options.output;
+
+        Sequence::Statistics statistics;
+        if (!Sequence::Render(raytracer, scene, camera, animation, settings, statistics, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+
+        const double frames = static_cast<double>(statistics.frames);
+        std::printf("Sequence: %d frames at %.3g fps, %d framebuffers in flight\n", statistics.frames, options.frameRate, options.inFlight);
+        std::printf("Wall time: %.3f ms per frame\n", Milliseconds(statistics.total / frames));
+        std::printf("Rays: %llu per frame (%llu shadow)\n", static_cast<unsigned long long>(statistics.timings.rays / statistics.frames),
+            static_cast<unsigned long long>(statistics.timings.shadowRays / statistics.frames));
+        std::printf("Update: %.3f ms\n", Milliseconds(statistics.update / frames));
+        std::printf("Render: %.3f ms (transform %.3f, build %.3f, trace %.3f, resolve %.3f)\n", Milliseconds(statistics.render / frames),
+            Milliseconds(statistics.timings.transform / frames), Milliseconds(statistics.timings.build / frames),
+            Milliseconds(statistics.timings.trace / frames), Milliseconds(statistics.timings.resolve / frames));
+        std::printf("Stall: %.3f ms waiting for a framebuffer\n", Milliseconds(statistics.stall / frames));
+        std::printf("Pack: %.3f ms\n", Milliseconds(statistics.pack / frames));
+        std::printf("Write: %.3f ms (%s)\n", Milliseconds(statistics.write / frames), Sequence::FramePath(options.output, 0).c_str());
+        return 0;
+    }
+
+    // Render the frames, only the first frame builds the acceleration structure.
+    RenderTimings total;
+    CacheCounters::Values cacheMisses;
+    double renderTime = 0.0;
+    for (int frame = 0; frame < options.frames; ++frame)
+    {
+        cacheCounters.Start();
+        const auto start = Clock::now();
+        if (options.progressive)
+        {
+            // Time to present each pass since the frame start.
+            raytracer.RenderProgressive(scene, camera, framebuffer, [&](const int blockSize)
+            {
+                std::printf("Pass %dx%d: %.3f ms\n", blockSize, blockSize, Milliseconds(std::chrono::duration<double>(Clock::now() - start).count()));
+                return true;
+            });
+        }
+        else
+        {
+            raytracer.Render(scene, camera, framebuffer);
+        }
+        renderTime += std::chrono::duration<double>(Clock::now() - start).count();
+        const auto counted = cacheCounters.Stop();
+        cacheMisses.l1Misses += counted.l1Misses;
+        cacheMisses.lastLevelMisses += counted.lastLevelMisses;
+
+        const auto& timings = raytracer.Timings();
+        total.transform += timings.transform;
+        total.build += timings.build;
+        total.trace += timings.trace;
+        total.resolve += timings.resolve;
+        total.rays += timings.rays;
+        total.shadowRays += timings.shadowRays;
+        total.antialiasedPixels += timings.antialiasedPixels;
+        total.antialiasingSamples += timings.antialiasingSamples;
+        total.retracedPixels += timings.retracedPixels;
+    }
+
+    // Pack and write the image of the last frame.
+    auto start = Clock::now();
+    const auto rgb = ImageFile::PackRgb(framebuffer);
+    const double packTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    if (!ImageFile::Write(options.output, rgb, options.width, options.height))
+    {
+        std::fprintf(stderr, "Can not write %s\n", options.output.c_str());
+        return 1;
+    }
+    const double writeTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+    const double frames = static_cast<double>(options.frames);
+    std::printf("Frames: %d\n", options.frames);
+    std::printf("Wall time: %.3f ms per frame\n", Milliseconds(renderTime / frames));
+    std::printf("Rays: %llu per frame (%llu shadow), %.3f Mrays/s\n", static_cast<unsigned long long>(total.rays / options.frames),
+        static_cast<unsigned long long>(total.shadowRays / options.frames),
+        renderTime > 0.0 ? static_cast<double>(total.rays) / renderTime / 1e6 : 0.0);
+    if (cacheCounters.Available())
+    {
+        std::printf("Cache misses: %llu L1d, %llu last level per frame\n", static_cast<unsigned long long>(cacheMisses.l1Misses / options.frames),
+            static_cast<unsigned long long>(cacheMisses.lastLevelMisses / options.frames));
+    }
+    else
+    {
+        std::printf("Cache misses: not available\n");
+    }
+    std::printf("Anti-aliasing: %llu pixels, %llu extra samples per frame\n", static_cast<unsigned long long>(total.antialiasedPixels / options.frames),
+        static_cast<unsigned long long>(total.antialiasingSamples / options.frames));
+    if (raytracer.Settings().incrementalRendering)
+    {
+        std::printf("Incremental: %llu retraced pixels per frame\n", static_cast<unsigned long long>(total.retracedPixels / options.frames));
+    }
+    std::printf("Transform: %.3f ms\n", Milliseconds(total.transform / frames));
+    std::printf("Build: %.3f ms\n", Milliseconds(total.build / frames));
+    std::printf("Trace: %.3f ms\n", Milliseconds(total.trace / frames));
+    std::printf("Resolve: %.3f ms\n", Milliseconds(total.resolve / frames));
+    std::printf("Pack: %.3f ms\n", Milliseconds(packTime));
+    std::printf("Write: %.3f ms (%s)\n", Milliseconds(writeTime), options.output.c_str());
+
+    // Statistics and costs of the last frame.
+    if (!options.stats.empty())
+    {
+        const std::string json = raytracer.Stats().Json() + "\n";
+        if (options.stats == "-")
+        {
+            std::fputs(json.c_str(), stdout);
+        }
+        else
+        {
+            std::ofstream file(options.stats);
+            file << json;
+            file.close();
+            if (!file)
+            {
+                std::fprintf(stderr, "Can not write %s\n", options.stats.c_str());
+                return 1;
+            }
+        }
+    }
+    if (!options.costs.empty() && !WriteCosts(options.costs, raytracer.Costs()))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "CacheCounters.h"
+
+#if defined(__linux__)
+
+#include <cstring>
+#include <initializer_list>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    // Disabled user-space counter inherited by the new threads.
+    int Open(const uint32_t type, const uint64_t config)
+    {
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = type;
+        attributes.config = config;
+        attributes.disabled = 1;
+        attributes.inherit = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+    }
+
+    uint64_t Read(const int fd)
+    {
+        uint64_t value = 0;
+        return read(fd, &value, sizeof(value)) == sizeof(value) ? value : 0;
+    }
+}
+
+CacheCounters::CacheCounters()
+{
+    l1 = Open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    lastLevel = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+}
+
+CacheCounters::~CacheCounters()
+{
+    if (l1 >= 0)
+    {
+        close(l1);
+    }
+    if (lastLevel >= 0)
+    {
+        close(lastLevel);
+    }
+}
+
+void CacheCounters::Start()
+{
+    if (!Available())
+    {
+        return;
+    }
+    for (const int fd : {l1, lastLevel})
+    {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+CacheCounters::Values CacheCounters::Stop()
+{
+    Values values;
+    if (!Available())
+    {
+        return values;
+    }
+    for (const int fd : {l1, lastLevel})
+    {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    values.l1Misses = Read(l1);
+    values.lastLevelMisses = Read(lastLevel);
+    return values;
+}
+
+#else
+
+CacheCounters::CacheCounters() {}
+CacheCounters::~CacheCounters() {}
+void CacheCounters::Start() {}
+CacheCounters::Values CacheCounters::Stop() { return Values(); }
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// Hardware cache miss counters of the batch renderer, Linux perf events only.
+// The counters follow the calling thread and the threads started after the construction,
+// so they have to be created before the rendering thread pool.
+class CacheCounters
+{
+public:
+    struct Values
+    {
+        // Level 1 data cache load misses.
+        uint64_t l1Misses = 0;
+
+        // Last level cache misses.
+        uint64_t lastLevelMisses = 0;
+    };
+
+    CacheCounters();
+    ~CacheCounters();
+
+    CacheCounters(const CacheCounters&) = delete;
+    CacheCounters& operator=(const CacheCounters&) = delete;
+
+    // The counters are not supported or not permitted.
+    bool Available() const { return l1 >= 0 && lastLevel >= 0; }
+
+    // Reset and enable the counters.
+    void Start();
+
+    // Disable the counters and return the values counted since Start().
+    Values Stop();
+
+private:
+    // Perf event file descriptors, -1 if not opened.
+    int l1 = -1;
+    int lastLevel = -1;
+};
@@ -0,0 +1,664 @@
+#include "Distributed.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <map>
+#include "Application/Socket.h"
+#include "Raytracer/Instance.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const uint32_t Magic = 0x4b575452;
+    const uint32_t Version = 2;
+
+    // Tiles assigned to a worker at the same time.
+    const size_t QueuedTiles = 2;
+
+    // Worker to the coordinator after the connection.
+    struct Hello
+    {
+        uint32_t magic;
+        uint32_t version;
+        int32_t threads;
+    };
+
+    // Coordinator to the worker after the hello.
+    struct Job
+    {
+        // Content hash of the scene, see SceneHash().
+        uint64_t scene;
+        int32_t width;
+        int32_t height;
+        int32_t antialiasingSamples;
+        float antialiasingThreshold;
+        float position[3];
+        float look[3];
+        float up[3];
+        float hfov;
+        float drawDistance;
+    };
+
+    // Coordinator to the worker, negative ids complete the job.
+    struct Tile
+    {
+        int32_t id;
+        int32_t x;
+        int32_t y;
+        int32_t width;
+        int32_t height;
+    };
+
+    // Worker to the coordinator, followed by the RGBA float colors of the tile rows.
+    struct Result
+    {
+        int32_t id;
+    };
+
+    void StoreVector(const Math::Vector& v, float* const output)
+    {
+        output[0] = v.x;
+        output[1] = v.y;
+        output[2] = v.z;
+    }
+
+    Math::Vector LoadVector(const float* const input)
+    {
+        return Math::Vector(input[0], input[1], input[2], 0.f);
+    }
+
+    double Seconds(const Clock::time_point start, const Clock::time_point end)
+    {
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    // Words are mixed with the multiplicative hash like the scene cache sources, the floats by their bits.
+    class Hash
+    {
+    public:
+        void AddWord(const uint64_t word)
+        {
+            value = (value ^ word) * 0x9e3779b97f4a7c15ull;
+            value ^= value >> 29;
+        }
+
+        void AddFloat(const float f)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            AddWord(bits);
+        }
+
+        void AddVector(const Math::Vector& v)
+        {
+            AddFloat(v.x);
+            AddFloat(v.y);
+            AddFloat(v.z);
+        }
+
+        uint64_t Value() const { return value; }
+
+    private:
+        uint64_t value = 0xcbf29ce484222325ull;
+    };
+
+    // Content hash of everything the workers render: the scene, its primitives, lights and the materials.
+    // The primitives are hashed before their transformation, the mesh geometries once per geometry.
+    uint64_t SceneHash(const Scene& scene, const std::vector<Material>& materials)
+    {
+        Hash hash;
+        hash.AddVector(scene.backgroundColor);
+        hash.AddVector(scene.ambientLight);
+
+        hash.AddWord(materials.size());
+        for (const auto& material : materials)
+        {
+            hash.AddVector(material.diffuseColor);
+            hash.AddVector(material.specularColor);
+            hash.AddFloat(material.specularExp);
+            hash.AddFloat(material.specularIntensity);
+            hash.AddWord(material.receiveShadows ? 1 : 0);
+        }
+
+        hash.AddWord(scene.lights.size());
+        for (const Light* const light : scene.lights)
+        {
+            hash.AddVector(light->position);
+            hash.AddVector(light->color);
+            hash.AddFloat(light->radius);
+            hash.AddFloat(light->intensity);
+            hash.AddFloat(light->exp);
+            hash.AddWord(light->castShadows ? 1 : 0);
+        }
+
+        // Geometries shared by the instances are identified by their order of the first use.
+        std::map<const MeshGeometry*, uint64_t> geometries;
+        hash.AddWord(scene.primitives.size());
+        for (const Primitive* const primitive : scene.primitives)
+        {
+            hash.AddWord(static_cast<uint64_t>(primitive->Type()));
+            hash.AddWord(static_cast<uint64_t>(primitive->materialId));
+            hash.AddVector(primitive->position);
+            hash.AddVector(primitive->rotation);
+            if (const auto sphere = dynamic_cast<const Sphere*>(primitive))
+            {
+                hash.AddFloat(sphere->radius);
+            }
+            else if (const auto triangle = dynamic_cast<const Triangle*>(primitive))
+            {
+                hash.AddVector(triangle->v0);
+                hash.AddVector(triangle->v1);
+                hash.AddVector(triangle->v2);
+            }
+            else if (const auto instance = dynamic_cast<const Instance*>(primitive))
+            {
+                hash.AddFloat(instance->Scale());
+                const MeshGeometry* const geometry = instance->geometry.get();
+                const auto it = geometries.find(geometry);
+                if (it != geometries.end())
+                {
+                    hash.AddWord(it->second);
+                }
+                else if (geometry != nullptr)
+                {
+                    const uint64_t index = geometries.size();
+                    geometries[geometry] = index;
+                    const auto& arrays = geometry->Data();
+                    hash.AddWord(arrays.vertexCount);
+                    for (size_t i = 0; i < arrays.vertexCount; ++i)
+                    {
+                        hash.AddFloat(arrays.x[i]);
+                        hash.AddFloat(arrays.y[i]);
+                        hash.AddFloat(arrays.z[i]);
+                    }
+                    hash.AddWord(arrays.triangleCount);
+                    for (size_t i = 0; i < 3 * arrays.triangleCount; ++i)
+                    {
+                        hash.AddWord(arrays.indices[i]);
+                    }
+                }
+            }
+        }
+        return hash.Value();
+    }
+
+    struct TileState
+    {
+        Tile tile;
+        bool done = false;
+
+        // Workers tracing the tile.
+        int workers = 0;
+    };
+
+    struct Assignment
+    {
+        int tile;
+        Clock::time_point start;
+    };
+
+    struct Worker
+    {
+        Socket socket;
+        bool greeted = false;
+        std::deque<Assignment> assigned;
+
+        // Message being received, the reads never wait, so a stalled worker does not block the others.
+        std::vector<char> message;
+        size_t received = 0;
+
+        // Job start and the last complete message, the connection before the hello.
+        Clock::time_point start;
+        Clock::time_point activity;
+
+        // Index of the worker statistics.
+        size_t index = 0;
+    };
+
+    class Coordinator
+    {
+    public:
+        Coordinator(const Distributed::Settings& settings, const Job& job, Framebuffer& framebuffer, Distributed::Statistics& statistics):
+            settings(settings),
+            job(job),
+            framebuffer(framebuffer),
+            statistics(statistics)
+        {
+            // Tiles in rows from the top.
+            const int size = std::max(settings.tileSize, 1);
+            for (int y = 0; y < job.height; y += size)
+            {
+                for (int x = 0; x < job.width; x += size)
+                {
+                    TileState state;
+                    state.tile = {static_cast<int32_t>(tiles.size()), x, y, std::min(size, job.width - x), std::min(size, job.height - y)};
+                    pending.push_back(static_cast<int>(tiles.size()));
+                    tiles.push_back(state);
+                }
+            }
+            statistics.tiles = static_cast<int>(tiles.size());
+        }
+
+        bool Run(Socket& listener)
+        {
+            Clock::time_point start;
+            bool started = false;
+            while (completed < tiles.size())
+            {
+                std::vector<const Socket*> sockets = {&listener};
+                for (const auto& worker : workers)
+                {
+                    sockets.push_back(&worker.socket);
+                }
+
+                // The timeout checks the unresponsive workers.
+                std::vector<uint8_t> readable;
+                Socket::Poll(sockets, readable, 100);
+
+                const auto now = Clock::now();
+                for (size_t i = 0; i < workers.size(); ++i)
+                {
+                    auto& worker = workers[i];
+                    bool alive = readable[i + 1] == 0 || Receive(worker);
+                    if (alive && worker.greeted && !started)
+                    {
+                        start = Clock::now();
+                        started = true;
+                    }
+
+                    // Workers sending the hello or a result slower than the timeout, even partially, are dropped.
+                    if (alive && (!worker.greeted || !worker.assigned.empty()) && Seconds(worker.activity, now) > settings.timeout)
+                    {
+                        alive = false;
+                    }
+
+                    if (!alive)
+                    {
+                        Drop(worker);
+                    }
+                }
+
+                // Tiles of the dropped workers go to the idle ones.
+                for (auto& worker : workers)
+                {
+                    if (worker.socket.Valid() && worker.greeted && !Assign(worker))
+                    {
+                        Drop(worker);
+                    }
+                }
+                workers.erase(std::remove_if(workers.begin(), workers.end(), [](const Worker& worker) { return !worker.socket.Valid(); }), workers.end());
+
+                if (readable[0] != 0)
+                {
+                    Worker worker;
+                    worker.socket = listener.Accept();
+                    if (worker.socket.Valid())
+                    {
+                        // The sends of the tiles do not wait for a stalled worker longer than the timeout.
+                        worker.socket.SetTimeout(static_cast<int>(std::min(settings.timeout * 1000.0, 1e9)));
+                        worker.activity = Clock::now();
+                        workers.push_back(std::move(worker));
+                    }
+                }
+            }
+            statistics.time = started ? Seconds(start, Clock::now()) : 0.0;
+
+            // The workers finish their queued tiles before they read the end of the job, their results are discarded.
+            // Each connection is closed after the last queued result, or when the worker is late like during the job.
+            const Tile end = {-1, 0, 0, 0, 0};
+            for (auto& worker : workers)
+            {
+                if (!worker.socket.Send(&end, sizeof(end)))
+                {
+                    worker.socket.Close();
+                }
+            }
+            const auto finish = Clock::now();
+            while (!workers.empty() && Seconds(finish, Clock::now()) < settings.timeout)
+            {
+                std::vector<const Socket*> sockets;
+                for (const auto& worker : workers)
+                {
+                    sockets.push_back(&worker.socket);
+                }
+                std::vector<uint8_t> readable;
+                Socket::Poll(sockets, readable, 100);
+                const auto now = Clock::now();
+                for (size_t i = 0; i < workers.size(); ++i)
+                {
+                    if (!workers[i].socket.Valid() || (readable[i] != 0 && !Receive(workers[i])) || workers[i].assigned.empty() ||
+                        Seconds(workers[i].activity, now) > settings.timeout)
+                    {
+                        workers[i].socket.Close();
+                    }
+                }
+                workers.erase(std::remove_if(workers.begin(), workers.end(), [](const Worker& worker) { return !worker.socket.Valid(); }), workers.end());
+            }
+            return true;
+        }
+
+    private:
+        // Read the available bytes of the worker and handle its complete messages: the hello, then the results.
+        // Returns false if the connection was closed or failed, or the message is invalid.
+        bool Receive(Worker& worker)
+        {
+            while (true)
+            {
+                const size_t size = MessageSize(worker);
+                if (worker.message.size() < size)
+                {
+                    worker.message.resize(size);
+                }
+                const int count = worker.socket.ReceiveAvailable(worker.message.data() + worker.received, size - worker.received);
+                if (count <= 0)
+                {
+                    return count == 0;
+                }
+                worker.received += static_cast<size_t>(count);
+                if (worker.received < size)
+                {
+                    continue;
+                }
+
+                if (!worker.greeted)
+                {
+                    worker.received = 0;
+                    if (!Greet(worker))
+                    {
+                        return false;
+                    }
+                }
+                else if (size == sizeof(Result))
+                {
+                    // The header selects the tile, its colors follow.
+                    if (!ValidResult(worker))
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    worker.received = 0;
+                    ReceiveResult(worker);
+                }
+            }
+        }
+
+        // Size of the received message, the result size is known after its header.
+        size_t MessageSize(const Worker& worker) const
+        {
+            if (!worker.greeted)
+            {
+                return sizeof(Hello);
+            }
+            if (worker.received < sizeof(Result))
+            {
+                return sizeof(Result);
+            }
+            const Tile& tile = tiles[ResultHeader(worker).id].tile;
+            return sizeof(Result) + static_cast<size_t>(tile.width) * tile.height * 4 * sizeof(float);
+        }
+
+        static Result ResultHeader(const Worker& worker)
+        {
+            Result result;
+            std::memcpy(&result, worker.message.data(), sizeof(result));
+            return result;
+        }
+
+        // The result must be of a tile assigned to the worker.
+        bool ValidResult(const Worker& worker) const
+        {
+            const Result result = ResultHeader(worker);
+            return std::any_of(worker.assigned.begin(), worker.assigned.end(), [&](const Assignment& a) { return a.tile == result.id; });
+        }
+
+        bool Greet(Worker& worker)
+        {
+            Hello hello;
+            std::memcpy(&hello, worker.message.data(), sizeof(hello));
+            if (hello.magic != Magic || hello.version != Version || !worker.socket.Send(&job, sizeof(job)))
+            {
+                return false;
+            }
+
+            worker.greeted = true;
+            worker.start = Clock::now();
+            worker.activity = worker.start;
+            worker.index = statistics.workers.size();
+            statistics.workers.emplace_back();
+            statistics.workers.back().threads = hello.threads;
+            return Assign(worker);
+        }
+
+        // Store the complete result of a valid tile.
+        void ReceiveResult(Worker& worker)
+        {
+            const Result result = ResultHeader(worker);
+            const auto assignment = std::find_if(worker.assigned.begin(), worker.assigned.end(), [&](const Assignment& a) { return a.tile == result.id; });
+            worker.assigned.erase(assignment);
+
+            auto& state = tiles[result.id];
+            const Tile& tile = state.tile;
+            --state.workers;
+            worker.activity = Clock::now();
+
+            auto& workerStatistics = statistics.workers[worker.index];
+            workerStatistics.time = Seconds(worker.start, worker.activity);
+            if (state.done)
+            {
+                ++statistics.discarded;
+                return;
+            }
+
+            const char* colors = worker.message.data() + sizeof(Result);
+            for (int y = tile.y; y < tile.y + tile.height; ++y)
+            {
+                for (int x = tile.x; x < tile.x + tile.width; ++x, colors += sizeof(float[4]))
+                {
+                    float color[4];
+                    std::memcpy(color, colors, sizeof(color));
+                    framebuffer.SetPixel(x, y, Math::Vector(color[0], color[1], color[2], color[3]));
+                }
+            }
+            state.done = true;
+            ++completed;
+            ++workerStatistics.tiles;
+            workerStatistics.pixels += static_cast<uint64_t>(tile.width) * static_cast<uint64_t>(tile.height);
+        }
+
+        // Fill the tile queue of the worker, returns false if the connection failed.
+        bool Assign(Worker& worker)
+        {
+            while (worker.assigned.size() < QueuedTiles)
+            {
+                int tile = -1;
+                if (!pending.empty())
+                {
+                    tile = pending.front();
+                    pending.pop_front();
+                }
+                else if (worker.assigned.empty())
+                {
+                    // Copy the longest running tile traced by a single other worker.
+                    Clock::time_point oldest = Clock::time_point::max();
+                    for (const auto& other : workers)
+                    {
+                        for (const auto& assignment : other.assigned)
+                        {
+                            const auto& state = tiles[assignment.tile];
+                            if (!state.done && state.workers == 1 && assignment.start < oldest)
+                            {
+                                oldest = assignment.start;
+                                tile = assignment.tile;
+                            }
+                        }
+                    }
+                    if (tile >= 0)
+                    {
+                        ++statistics.reassigned;
+                    }
+                }
+                if (tile < 0)
+                {
+                    return true;
+                }
+
+                // The timeout of an idle worker starts with its first tile.
+                if (worker.assigned.empty())
+                {
+                    worker.activity = Clock::now();
+                }
+                ++tiles[tile].workers;
+                worker.assigned.push_back({tile, Clock::now()});
+                if (!worker.socket.Send(&tiles[tile].tile, sizeof(Tile)))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Close the connection and return the unfinished tiles to the queue.
+        void Drop(Worker& worker)
+        {
+            for (const auto& assignment : worker.assigned)
+            {
+                auto& state = tiles[assignment.tile];
+                if (--state.workers == 0 && !state.done)
+                {
+                    pending.push_front(assignment.tile);
+                    ++statistics.reassigned;
+                }
+            }
+            worker.assigned.clear();
+            worker.socket.Close();
+            if (worker.greeted)
+            {
+                statistics.workers[worker.index].failed = true;
+            }
+        }
+
+        const Distributed::Settings& settings;
+        const Job& job;
+        Framebuffer& framebuffer;
+        Distributed::Statistics& statistics;
+
+        std::vector<TileState> tiles;
+        std::deque<int> pending;
+        size_t completed = 0;
+
+        std::vector<Worker> workers;
+    };
+}
+
+bool Distributed::Coordinate(const std::string& address, const Settings& settings, const Raytracer& raytracer, const Scene& scene,
+    const Camera& camera, Framebuffer& framebuffer, Statistics& statistics, std::string& error)
+{
+    Socket listener;
+    if (!listener.Listen(address, error))
+    {
+        return false;
+    }
+
+    Job job = {};
+    job.width = framebuffer.Width();
+    job.height = framebuffer.Height();
+    job.scene = SceneHash(scene, raytracer.Materials());
+    job.antialiasingSamples = raytracer.Settings().antialiasingSamples;
+    job.antialiasingThreshold = raytracer.Settings().antialiasingThreshold;
+    StoreVector(camera.position, job.position);
+    StoreVector(camera.Look(), job.look);
+    StoreVector(camera.Up(), job.up);
+    job.hfov = camera.HFov();
+    job.drawDistance = camera.drawDistance;
+
+    framebuffer.Clear();
+    Coordinator coordinator(settings, job, framebuffer, statistics);
+    coordinator.Run(listener);
+    framebuffer.Resolve();
+    return true;
+}
+
+bool Distributed::Work(const std::string& address, Raytracer& raytracer, const Scene& scene, Camera& camera, std::string& error)
+{
+    Socket socket;
+    if (!socket.Connect(address, error))
+    {
+        return false;
+    }
+
+    const Hello hello = {Magic, Version, raytracer.ThreadCount()};
+    Job job;
+    if (!socket.Send(&hello, sizeof(hello)) || !socket.Receive(&job, sizeof(job)))
+    {
+        error = "Connection to " + address + " failed";
+        return false;
+    }
+    if (job.scene != SceneHash(scene, raytracer.Materials()))
+    {
+        error = "The scene differs from the coordinator scene";
+        return false;
+    }
+
+    // Camera and anti-aliasing of the coordinator.
+    camera.position = LoadVector(job.position);
+    camera.SetOrientation(LoadVector(job.look), LoadVector(job.up));
+    camera.SetFov(job.hfov);
+    camera.SetAspectRatio(static_cast<float>(job.width), static_cast<float>(job.height));
+    camera.drawDistance = job.drawDistance;
+
+    auto settings = raytracer.Settings();
+    settings.antialiasingSamples = job.antialiasingSamples;
+    settings.antialiasingThreshold = job.antialiasingThreshold;
+    settings.incrementalRendering = false;
+    raytracer.SetSettings(settings);
+
+    // The anti-aliasing of the tile border pixels needs their neighbours, they are traced and discarded.
+    const int border = raytracer.Settings().antialiasingSamples >= 4 ? 1 : 0;
+
+    Framebuffer framebuffer(FramebufferFormat::RGBA8);
+    std::vector<float> colors;
+    while (true)
+    {
+        Tile tile;
+        if (!socket.Receive(&tile, sizeof(tile)))
+        {
+            error = "Connection to " + address + " lost";
+            return false;
+        }
+        if (tile.id < 0)
+        {
+            return true;
+        }
+
+        const int x0 = std::max(tile.x - border, 0);
+        const int y0 = std::max(tile.y - border, 0);
+        const int x1 = std::min(tile.x + tile.width + border, job.width);
+        const int y1 = std::min(tile.y + tile.height + border, job.height);
+        if (framebuffer.Width() != x1 - x0 || framebuffer.Height() != y1 - y0)
+        {
+            framebuffer.Resize(x1 - x0, y1 - y0);
+        }
+        raytracer.RenderRegion(scene, camera, framebuffer, job.width, job.height, x0, y0);
+
+        colors.clear();
+        for (int y = tile.y; y < tile.y + tile.height; ++y)
+        {
+            for (int x = tile.x; x < tile.x + tile.width; ++x)
+            {
+                const auto color = framebuffer.Color(x - x0, y - y0);
+                colors.insert(colors.end(), {color.x, color.y, color.z, color.w});
+            }
+        }
+
+        const Result result = {tile.id};
+        if (!socket.Send(&result, sizeof(result)) || !socket.Send(colors.data(), colors.size() * sizeof(float)))
+        {
+            error = "Connection to " + address + " lost";
+            return false;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Raytracer/Raytracer.h"
+
+// Rendering of an image split between worker processes, see Socket for the addresses.
+// The coordinator hands out the tiles of the image, the workers load the same scene, trace the tiles with
+// Raytracer::RenderRegion() and send back their pixel colors, the image is bit-identical with Render().
+// Every worker has up to two tiles assigned, so the next tile is already queued when it sends a result.
+// Tiles of a disconnected worker or of a worker without results within the timeout are assigned again.
+// The messages of the workers are read as they arrive, a partial message does not stall the coordinator.
+// Idle workers also trace copies of the tiles still in progress on the other workers, the first result is used.
+// Messages use the native byte order, the processes have to run on the same platform.
+namespace Distributed
+{
+    struct Settings
+    {
+        // Side of the square tiles handed out to the workers.
+        int tileSize = 64;
+
+        // Seconds without a result after which a worker is dropped.
+        double timeout = 60.0;
+    };
+
+    struct WorkerStatistics
+    {
+        // Rendering threads of the worker.
+        int threads = 0;
+
+        // Completed tiles and their pixels, copies completed after another worker are not counted.
+        int tiles = 0;
+        uint64_t pixels = 0;
+
+        // Seconds from the job start to the last result.
+        double time = 0.0;
+
+        // The worker disconnected or timed out before the image was complete.
+        bool failed = false;
+    };
+
+    struct Statistics
+    {
+        int tiles = 0;
+
+        // Tiles assigned again after a failure or copied to an idle worker.
+        int reassigned = 0;
+
+        // Results of the tiles completed before by another worker.
+        int discarded = 0;
+
+        // Seconds from the first connected worker to the complete image.
+        double time = 0.0;
+
+        std::vector<WorkerStatistics> workers;
+    };
+
+    // Listen on the address and render the image with the connecting workers, the framebuffer size is the image size.
+    // The anti-aliasing settings of the raytracer are passed to the workers. The scene and the raytracer materials are only used
+    // to check by their content hash that the workers load the same ones.
+    // Waits for the workers until the image is complete and resolves the framebuffer.
+    // Returns false and the error description if the address can not be used.
+    bool Coordinate(const std::string& address, const Settings&, const Raytracer&, const Scene&, const Camera&,
+        Framebuffer&, Statistics&, std::string& error);
+
+    // Connect to the coordinator and render the assigned tiles until the image is complete.
+    // Returns false and the error description if the connection fails or the scene or the materials differ from the coordinator ones.
+    bool Work(const std::string& address, Raytracer&, const Scene&, Camera&, std::string& error);
+}
@@ -0,0 +1,237 @@
+#include "ImageFile.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    // CRC-32 used by the PNG chunks.
+    uint32_t Crc32(const uint8_t* const data, const size_t size, uint32_t crc = 0)
+    {
+        static const auto table = []()
+        {
+            std::array<uint32_t, 256> table;
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                table[i] = c;
+            }
+            return table;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // Adler-32 used by the zlib stream.
+    uint32_t Adler32(const uint8_t* const data, const size_t size)
+    {
+        // The sums can not overflow in 5552 bytes, so the modulo is applied once per block.
+        uint32_t a = 1;
+        uint32_t b = 0;
+        for (size_t begin = 0; begin < size; begin += 5552)
+        {
+            const size_t end = std::min(size, begin + 5552);
+            for (size_t i = begin; i < end; ++i)
+            {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    void AppendBigEndian(std::vector<uint8_t>& out, const uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void AppendChunk(std::vector<uint8_t>& out, const char* const type, const std::vector<uint8_t>& data)
+    {
+        AppendBigEndian(out, static_cast<uint32_t>(data.size()));
+        const size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        AppendBigEndian(out, Crc32(out.data() + start, out.size() - start));
+    }
+
+    bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        return static_cast<bool>(file);
+    }
+}
+
+std::vector<uint8_t> ImageFile::PackRgb(const Framebuffer& framebuffer)
+{
+    const size_t count = static_cast<size_t>(framebuffer.Width()) * framebuffer.Height();
+    const uint8_t* const data = framebuffer.Data();
+
+    // Channel offsets of red and blue.
+    const int r = (framebuffer.format == FramebufferFormat::BGRA8) ? 2 : 0;
+    const int b = 2 - r;
+
+    std::vector<uint8_t> rgb(3 * count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        rgb[3 * i + 0] = data[4 * i + r];
+        rgb[3 * i + 1] = data[4 * i + 1];
+        rgb[3 * i + 2] = data[4 * i + b];
+    }
+    return rgb;
+}
+
+std::vector<uint8_t> ImageFile::EncodePpm(const std::vector<uint8_t>& rgb, const int width, const int height)
+{
+    const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::vector<uint8_t> ppm;
+    ppm.reserve(header.size() + rgb.size());
+    ppm.insert(ppm.end(), header.begin(), header.end());
+    ppm.insert(ppm.end(), rgb.begin(), rgb.end());
+    return ppm;
+}
+
+bool ImageFile::WritePpm(const std::string& path, const std::vector<uint8_t>& rgb, const int width, const int height)
+{
+    return WriteFile(path, EncodePpm(rgb, width, height));
+}
+
+std::vector<uint8_t> ImageFile::EncodePng(const std::vector<uint8_t>& rgb, const int width, const int height)
+{
+    // Scanlines with the filter type byte (none).
+    const size_t stride = 3 * static_cast<size_t>(width);
+    std::vector<uint8_t> raw;
+    raw.reserve((stride + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + y * stride, rgb.begin() + (y + 1) * stride);
+    }
+
+    // zlib stream of stored deflate blocks.
+    const size_t MaxBlock = 65535;
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    zlib.reserve(raw.size() + raw.size() / MaxBlock * 5 + 16);
+    size_t offset = 0;
+    do
+    {
+        const size_t size = std::min(MaxBlock, raw.size() - offset);
+        const bool last = (offset + size == raw.size());
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(size));
+        zlib.push_back(static_cast<uint8_t>(size >> 8));
+        zlib.push_back(static_cast<uint8_t>(~size));
+        zlib.push_back(static_cast<uint8_t>(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    }
+    while (offset < raw.size());
+    AppendBigEndian(zlib, Adler32(raw.data(), raw.size()));
+
+    std::vector<uint8_t> header;
+    AppendBigEndian(header, static_cast<uint32_t>(width));
+    AppendBigEndian(header, static_cast<uint32_t>(height));
+    header.push_back(8); // Bit depth.
+    header.push_back(2); // RGB.
+    header.push_back(0); // Deflate.
+    header.push_back(0); // Adaptive filtering.
+    header.push_back(0); // No interlace.
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    AppendChunk(png, "IHDR", header);
+    AppendChunk(png, "IDAT", zlib);
+    AppendChunk(png, "IEND", {});
+    return png;
+}
+
+bool ImageFile::WritePng(const std::string& path, const std::vector<uint8_t>& rgb, const int width, const int height)
+{
+    return WriteFile(path, EncodePng(rgb, width, height));
+}
+
+bool ImageFile::Write(const std::string& path, const std::vector<uint8_t>& rgb, const int width, const int height)
+{
+    const auto dot = path.rfind('.');
+    std::string extension = (dot == std::string::npos) ? std::string() : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](const char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == "png")
+    {
+        return WritePng(path, rgb, width, height);
+    }
+    return WritePpm(path, rgb, width, height);
+}
+
+std::vector<uint8_t> ImageFile::Heatmap(const std::vector<float>& values, const float maxValue)
+{
+    // Color ramp stops at the equidistant fractions of the maximum.
+    static const float stops[][3] = {
+        {0.f, 0.f, 0.f},
+        {0.f, 0.f, 1.f},
+        {0.f, 1.f, 1.f},
+        {0.f, 1.f, 0.f},
+        {1.f, 1.f, 0.f},
+        {1.f, 0.f, 0.f},
+    };
+    const int last = static_cast<int>(sizeof(stops) / sizeof(stops[0])) - 1;
+
+    std::vector<uint8_t> rgb(3 * values.size());
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        if (values[i] > maxValue)
+        {
+            rgb[3 * i + 0] = 255;
+            rgb[3 * i + 1] = 255;
+            rgb[3 * i + 2] = 255;
+            continue;
+        }
+
+        const float position = (maxValue > 0.f) ? std::max(values[i], 0.f) / maxValue * static_cast<float>(last) : 0.f;
+        const int stop = std::min(static_cast<int>(position), last - 1);
+        const float t = position - static_cast<float>(stop);
+        for (int c = 0; c < 3; ++c)
+        {
+            const float value = stops[stop][c] + (stops[stop + 1][c] - stops[stop][c]) * t;
+            rgb[3 * i + c] = static_cast<uint8_t>(value * 255.f + 0.5f);
+        }
+    }
+    return rgb;
+}
+
+bool ImageFile::WritePfm(const std::string& path, const std::vector<float>& values, const int width, const int height)
+{
+    // Negative scale marks the little-endian floats, the values are stored in the host order.
+    const uint16_t one = 1;
+    uint8_t lowByte = 0;
+    std::memcpy(&lowByte, &one, 1);
+    const std::string header = "Pf\n" + std::to_string(width) + " " + std::to_string(height) + (lowByte == 1 ? "\n-1.0\n" : "\n1.0\n");
+
+    std::vector<uint8_t> pfm(header.begin(), header.end());
+    const size_t rowSize = static_cast<size_t>(width) * sizeof(float);
+    pfm.resize(header.size() + rowSize * static_cast<size_t>(height));
+    for (int y = 0; y < height; ++y)
+    {
+        std::memcpy(pfm.data() + header.size() + rowSize * static_cast<size_t>(height - 1 - y), values.data() + static_cast<size_t>(y) * width, rowSize);
+    }
+    return WriteFile(path, pfm);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Raytracer/Framebuffer.h"
+
+// Image output of the batch renderer.
+// Images are 8-bit RGB without alpha, rows are stored from the top, except the float maps.
+namespace ImageFile
+{
+    // Convert the framebuffer to the tightly packed RGB rows.
+    std::vector<uint8_t> PackRgb(const Framebuffer& framebuffer);
+
+    // Binary PPM (P6).
+    std::vector<uint8_t> EncodePpm(const std::vector<uint8_t>& rgb, const int width, const int height);
+    bool WritePpm(const std::string& path, const std::vector<uint8_t>& rgb, const int width, const int height);
+
+    // PNG with uncompressed deflate blocks, the encoding is cheap and the file is valid for all readers.
+    std::vector<uint8_t> EncodePng(const std::vector<uint8_t>& rgb, const int width, const int height);
+    bool WritePng(const std::string& path, const std::vector<uint8_t>& rgb, const int width, const int height);
+
+    // Select the format by the path extension (.png, otherwise PPM).
+    bool Write(const std::string& path, const std::vector<uint8_t>& rgb, const int width, const int height);
+
+    // False-color RGB of the values, from black over blue, green and yellow to red at maxValue and white above it.
+    std::vector<uint8_t> Heatmap(const std::vector<float>& values, const float maxValue);
+
+    // Grayscale Portable Float Map (Pf) of the raw values, rows are stored from the bottom as the format requires.
+    bool WritePfm(const std::string& path, const std::vector<float>& values, const int width, const int height);
+}
@@ -0,0 +1,120 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    if (fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return true;
+    }
+
+    // The view keeps the mapping alive, both handles can be closed.
+    const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+    const void* const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr)
+    {
+        return false;
+    }
+
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        ::close(file);
+        return false;
+    }
+    if (status.st_size == 0)
+    {
+        ::close(file);
+        return true;
+    }
+
+    // The mapping stays valid after closing the descriptor.
+    void* const view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(view, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(status.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<char*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+#endif
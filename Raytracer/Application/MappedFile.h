@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map the file, the previous mapping is closed. Returns false if the file can not be mapped.
+    // Empty files are mapped with a null data pointer.
+    bool Open(const std::string& path);
+    void Close();
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+};
@@ -0,0 +1,714 @@
+#include "ObjFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "Application/MappedFile.h"
+#include "Raytracer/Instance.h"
+#include "Raytracer/ThreadPool.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Smaller files are split to fewer chunks.
+    const size_t MinChunkSize = 1 << 20;
+
+    // More chunks than threads, so the threads finishing early can steal the rest.
+    const int ChunksPerThread = 4;
+
+    // Exact double powers of ten of the fast float path.
+    const double Powers[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // Face vertex, the index of a negative (relative) OBJ index is counted from the chunk start.
+    struct Corner
+    {
+        int32_t index;
+        bool relative;
+    };
+
+    // Contiguous lines of the file parsed by one task.
+    struct Chunk
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+
+        // Three corners per triangle.
+        std::vector<Corner> corners;
+
+        // Material of the triangles from the given index.
+        struct Use
+        {
+            size_t triangle;
+            std::string material;
+        };
+        std::vector<Use> uses;
+
+        std::vector<std::string> libraries;
+
+        // Line count and the chunk line of the first invalid item, 0 if all lines are valid.
+        size_t lines = 0;
+        size_t errorLine = 0;
+        std::string errorItem;
+    };
+
+    bool Space(const char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char* SkipSpaces(const char* p, const char* const end)
+    {
+        while (p < end && Space(*p))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    const char* SkipToken(const char* p, const char* const end)
+    {
+        while (p < end && !Space(*p))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    // Parse the decimal number, returns the end of the number or nullptr.
+    // Up to 19 significant digits with a power of ten in the exact double range are converted directly,
+    // other numbers by strtod().
+    const char* ParseFloat(const char* p, const char* const end, float& value)
+    {
+        const char* const start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool exact = true;
+        bool any = false;
+
+        // Leading zeros are not significant, digits over the mantissa precision make the number inexact.
+        const auto digit = [&](const int d, const bool fraction)
+        {
+            any = true;
+            if (mantissa == 0 && d == 0)
+            {
+                exponent -= fraction ? 1 : 0;
+            }
+            else if (digits < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(d);
+                ++digits;
+                exponent -= fraction ? 1 : 0;
+            }
+            else
+            {
+                exponent += fraction ? 0 : 1;
+                exact = false;
+            }
+        };
+
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        {
+            digit(*p - '0', false);
+        }
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+            {
+                digit(*p - '0', true);
+            }
+        }
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            // Exponents are converted by strtod().
+            exact = false;
+            p = SkipToken(p, end);
+        }
+        if (p < end && !Space(*p))
+        {
+            return nullptr;
+        }
+        if (!any)
+        {
+            return nullptr;
+        }
+
+        if (exact && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+        {
+            double result = static_cast<double>(mantissa);
+            result = exponent < 0 ? result / Powers[-exponent] : result * Powers[exponent];
+            value = static_cast<float>(negative ? -result : result);
+            return p;
+        }
+
+        char buffer[64];
+        const size_t length = static_cast<size_t>(p - start);
+        if (length >= sizeof(buffer))
+        {
+            return nullptr;
+        }
+        std::memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        char* parsed = nullptr;
+        value = static_cast<float>(std::strtod(buffer, &parsed));
+        return parsed == buffer + length ? p : nullptr;
+    }
+
+    // Parse the decimal integer, returns the end of the number or nullptr.
+    const char* ParseInt(const char* p, const char* const end, int32_t& value)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+        if (p == end || *p < '0' || *p > '9')
+        {
+            return nullptr;
+        }
+        int64_t result = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        {
+            result = result * 10 + (*p - '0');
+            if (result > INT32_MAX)
+            {
+                return nullptr;
+            }
+        }
+        value = static_cast<int32_t>(negative ? -result : result);
+        return p;
+    }
+
+    bool Keyword(const char* const begin, const char* const end, const char* const keyword)
+    {
+        const size_t length = std::strlen(keyword);
+        return static_cast<size_t>(end - begin) == length && std::memcmp(begin, keyword, length) == 0;
+    }
+
+    // Parse the line without the leading spaces and the line break. Returns false for invalid items.
+    bool ParseLine(Chunk& chunk, const char* p, const char* const end, std::vector<Corner>& face)
+    {
+        if (p == end || *p == '#')
+        {
+            return true;
+        }
+        const char* const keywordEnd = SkipToken(p, end);
+
+        if (Keyword(p, keywordEnd, "v"))
+        {
+            // The optional w coordinate and vertex colors are ignored.
+            float v[3];
+            p = keywordEnd;
+            for (int i = 0; i < 3; ++i)
+            {
+                p = ParseFloat(SkipSpaces(p, end), end, v[i]);
+                if (p == nullptr)
+                {
+                    return false;
+                }
+            }
+            chunk.x.push_back(v[0]);
+            chunk.y.push_back(v[1]);
+            chunk.z.push_back(v[2]);
+            return true;
+        }
+
+        if (Keyword(p, keywordEnd, "f"))
+        {
+            // Texture coordinate and normal indices after the slashes are skipped.
+            face.clear();
+            p = SkipSpaces(keywordEnd, end);
+            while (p < end && *p != '#')
+            {
+                int32_t index = 0;
+                const char* const next = ParseInt(p, end, index);
+                if (next == nullptr || index == 0 || (next < end && !Space(*next) && *next != '/'))
+                {
+                    return false;
+                }
+                if (index > 0)
+                {
+                    face.push_back({index - 1, false});
+                }
+                else
+                {
+                    face.push_back({static_cast<int32_t>(chunk.x.size()) + index, true});
+                }
+                p = SkipSpaces(SkipToken(next, end), end);
+            }
+            if (face.size() < 3)
+            {
+                return false;
+            }
+
+            // Triangle fan of the polygon.
+            for (size_t i = 1; i + 1 < face.size(); ++i)
+            {
+                chunk.corners.push_back(face[0]);
+                chunk.corners.push_back(face[i]);
+                chunk.corners.push_back(face[i + 1]);
+            }
+            return true;
+        }
+
+        if (Keyword(p, keywordEnd, "usemtl"))
+        {
+            // Names can contain spaces.
+            p = SkipSpaces(keywordEnd, end);
+            const char* last = end;
+            while (last > p && Space(last[-1]))
+            {
+                --last;
+            }
+            chunk.uses.push_back({chunk.corners.size() / 3, std::string(p, last)});
+            return true;
+        }
+
+        if (Keyword(p, keywordEnd, "mtllib"))
+        {
+            for (p = SkipSpaces(keywordEnd, end); p < end; p = SkipSpaces(p, end))
+            {
+                const char* const nameEnd = SkipToken(p, end);
+                chunk.libraries.emplace_back(p, nameEnd);
+                p = nameEnd;
+            }
+            return true;
+        }
+
+        // Other items are ignored.
+        return true;
+    }
+
+    // Parse the chunk lines until the first invalid item.
+    void ParseChunk(Chunk& chunk)
+    {
+        std::vector<Corner> face;
+        const char* p = chunk.begin;
+        while (p < chunk.end)
+        {
+            const void* const lineBreak = std::memchr(p, '\n', static_cast<size_t>(chunk.end - p));
+            const char* const lineEnd = lineBreak != nullptr ? static_cast<const char*>(lineBreak) : chunk.end;
+            ++chunk.lines;
+
+            const char* const first = SkipSpaces(p, lineEnd);
+            if (!ParseLine(chunk, first, lineEnd, face))
+            {
+                chunk.errorLine = chunk.lines;
+                chunk.errorItem.assign(first, SkipToken(first, lineEnd));
+                return;
+            }
+            p = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+        }
+    }
+
+    // Parse the MTL file, the materials are added to the raytracer.
+    bool LoadMaterials(const std::string& path, Raytracer& raytracer, std::map<std::string, int>& materials, std::string& error)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            error = "Can not open " + path;
+            return false;
+        }
+
+        // Materials are added when they are complete.
+        std::string name;
+        Material material;
+        const auto add = [&]()
+        {
+            if (!name.empty())
+            {
+                materials[name] = raytracer.AddMaterial(material);
+            }
+        };
+
+        std::string text;
+        int lineNumber = 0;
+        while (std::getline(file, text))
+        {
+            ++lineNumber;
+            std::istringstream line(text);
+            std::string keyword;
+            if (!(line >> keyword) || keyword[0] == '#')
+            {
+                continue;
+            }
+
+            bool valid = true;
+            if (keyword == "newmtl")
+            {
+                add();
+                std::getline(line >> std::ws, name);
+                while (!name.empty() && Space(name.back()))
+                {
+                    name.pop_back();
+                }
+                material = Material();
+                material.diffuseColor = {0.8f, 0.8f, 0.8f, 1.f};
+                material.specularColor = {0.f, 0.f, 0.f, 1.f};
+                material.specularIntensity = 1.f;
+                valid = !name.empty();
+            }
+            else if (keyword == "Kd")
+            {
+                valid = static_cast<bool>(line >> material.diffuseColor.x >> material.diffuseColor.y >> material.diffuseColor.z);
+            }
+            else if (keyword == "Ks")
+            {
+                valid = static_cast<bool>(line >> material.specularColor.x >> material.specularColor.y >> material.specularColor.z);
+            }
+            else if (keyword == "Ns")
+            {
+                valid = static_cast<bool>(line >> material.specularExp);
+            }
+
+            if (!valid)
+            {
+                error = path + ":" + std::to_string(lineNumber) + ": invalid " + keyword;
+                return false;
+            }
+        }
+        add();
+        return true;
+    }
+
+    // Directory of the path with the trailing separator.
+    std::string Directory(const std::string& path)
+    {
+        const auto separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+    }
+
+    // Index of the first vertex with the same position for all vertices.
+    std::vector<uint32_t> MergeVertices(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z)
+    {
+        const size_t count = x.size();
+        std::vector<uint32_t> merged(count);
+
+        // Open addressing table of the vertex indices, the positions are compared bitwise.
+        size_t capacity = 16;
+        while (capacity < 2 * count)
+        {
+            capacity *= 2;
+        }
+        std::vector<uint32_t> table(capacity, UINT32_MAX);
+
+        const auto bits = [](const float value)
+        {
+            uint32_t result;
+            std::memcpy(&result, &value, sizeof(result));
+            return result;
+        };
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t bx = bits(x[i]);
+            const uint32_t by = bits(y[i]);
+            const uint32_t bz = bits(z[i]);
+            uint64_t hash = (static_cast<uint64_t>(bx) * 0x9e3779b97f4a7c15ull) ^ (static_cast<uint64_t>(by) * 0xc2b2ae3d27d4eb4full) ^ (static_cast<uint64_t>(bz) * 0x165667b19e3779f9ull);
+            hash ^= hash >> 29;
+
+            size_t slot = static_cast<size_t>(hash) & (capacity - 1);
+            while (true)
+            {
+                const uint32_t other = table[slot];
+                if (other == UINT32_MAX)
+                {
+                    table[slot] = static_cast<uint32_t>(i);
+                    merged[i] = static_cast<uint32_t>(i);
+                    break;
+                }
+                if (bits(x[other]) == bx && bits(y[other]) == by && bits(z[other]) == bz)
+                {
+                    merged[i] = other;
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+        }
+        return merged;
+    }
+
+    double Elapsed(const Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+bool ObjFile::Load(const std::string& path, Raytracer& raytracer, Model& model, Statistics& statistics, std::string& error, const int threadCount)
+{
+    model = Model();
+    statistics = Statistics();
+    auto start = Clock::now();
+
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        error = "Can not open " + path;
+        return false;
+    }
+    statistics.bytes = file.Size();
+    model.files.push_back(path);
+
+    // Chunks start after a line break, so every line is parsed by one task.
+    ThreadPool threadPool(threadCount);
+    const size_t size = file.Size();
+    const size_t maxChunks = static_cast<size_t>(threadPool.ThreadCount() * ChunksPerThread);
+    const size_t chunkCount = std::max<size_t>(std::min(size / MinChunkSize, maxChunks), 1);
+    std::vector<Chunk> chunks(chunkCount);
+    const char* const data = file.Data();
+    const char* const dataEnd = data + size;
+    const char* begin = data;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        const char* end = dataEnd;
+        if (i + 1 < chunkCount)
+        {
+            end = std::max(data + size / chunkCount * (i + 1), begin);
+            const void* const lineBreak = std::memchr(end, '\n', static_cast<size_t>(dataEnd - end));
+            end = lineBreak != nullptr ? static_cast<const char*>(lineBreak) + 1 : dataEnd;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        begin = end;
+    }
+
+    threadPool.Run(static_cast<int>(chunkCount), [&](const int i)
+    {
+        ParseChunk(chunks[i]);
+    });
+
+    // First invalid line of the file.
+    size_t lines = 0;
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.errorLine != 0)
+        {
+            error = path + ":" + std::to_string(lines + chunk.errorLine) + ": invalid " + chunk.errorItem;
+            return false;
+        }
+        lines += chunk.lines;
+    }
+
+    // Material libraries relative to the OBJ file.
+    std::map<std::string, int> materials;
+    std::vector<std::string> libraries;
+    for (const auto& chunk : chunks)
+    {
+        for (const auto& library : chunk.libraries)
+        {
+            if (std::find(libraries.begin(), libraries.end(), library) == libraries.end())
+            {
+                libraries.push_back(library);
+                model.files.push_back(Directory(path) + library);
+                if (!LoadMaterials(model.files.back(), raytracer, materials, error))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    statistics.materials = materials.size();
+    statistics.parseTime = Elapsed(start);
+    start = Clock::now();
+
+    // Positions of all chunks and the index of the first chunk vertex.
+    std::vector<size_t> offsets(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        offsets[i + 1] = offsets[i] + chunks[i].x.size();
+    }
+    const size_t vertexCount = offsets[chunkCount];
+    if (vertexCount >= UINT32_MAX)
+    {
+        error = path + ": too many vertices";
+        return false;
+    }
+    std::vector<float> x(vertexCount);
+    std::vector<float> y(vertexCount);
+    std::vector<float> z(vertexCount);
+    threadPool.Run(static_cast<int>(chunkCount), [&](const int i)
+    {
+        std::copy(chunks[i].x.begin(), chunks[i].x.end(), x.begin() + offsets[i]);
+        std::copy(chunks[i].y.begin(), chunks[i].y.end(), y.begin() + offsets[i]);
+        std::copy(chunks[i].z.begin(), chunks[i].z.end(), z.begin() + offsets[i]);
+    });
+    const auto merged = MergeVertices(x, y, z);
+
+    // Merged vertex indices of the triangles, grouped by the material in the order of the first use.
+    struct Group
+    {
+        int materialId;
+        std::vector<uint32_t> indices;
+    };
+    std::vector<Group> groups;
+    std::map<int, size_t> groupIndices;
+    int materialId = 0;
+    size_t group = SIZE_MAX;
+
+    const auto use = [&](const std::string& name)
+    {
+        const auto it = materials.find(name);
+        materialId = it != materials.end() ? it->second : 0;
+        group = SIZE_MAX;
+    };
+
+    for (size_t c = 0; c < chunkCount; ++c)
+    {
+        const Chunk& chunk = chunks[c];
+        const size_t triangleCount = chunk.corners.size() / 3;
+        size_t nextUse = 0;
+        for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            for (; nextUse < chunk.uses.size() && chunk.uses[nextUse].triangle == triangle; ++nextUse)
+            {
+                use(chunk.uses[nextUse].material);
+            }
+            if (group == SIZE_MAX)
+            {
+                const auto it = groupIndices.find(materialId);
+                if (it == groupIndices.end())
+                {
+                    group = groups.size();
+                    groupIndices[materialId] = group;
+                    groups.push_back({materialId, {}});
+                }
+                else
+                {
+                    group = it->second;
+                }
+            }
+
+            for (size_t v = 0; v < 3; ++v)
+            {
+                const Corner& corner = chunk.corners[3 * triangle + v];
+                const int64_t index = corner.index + (corner.relative ? static_cast<int64_t>(offsets[c]) : 0);
+                if (index < 0 || index >= static_cast<int64_t>(vertexCount))
+                {
+                    error = path + ": invalid vertex index";
+                    return false;
+                }
+                groups[group].indices.push_back(merged[static_cast<size_t>(index)]);
+            }
+        }
+
+        // Materials selected after the last chunk triangle apply to the next chunks.
+        for (; nextUse < chunk.uses.size(); ++nextUse)
+        {
+            use(chunk.uses[nextUse].material);
+        }
+    }
+
+    // Compact vertex arrays of the groups, then the meshes are built in parallel.
+    struct Geometry
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+    };
+    std::vector<Geometry> geometries(groups.size());
+    std::vector<uint32_t> local(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> used;
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        Geometry& geometry = geometries[g];
+        for (uint32_t& index : groups[g].indices)
+        {
+            if (local[index] == UINT32_MAX)
+            {
+                local[index] = static_cast<uint32_t>(geometry.x.size());
+                used.push_back(index);
+                geometry.x.push_back(x[index]);
+                geometry.y.push_back(y[index]);
+                geometry.z.push_back(z[index]);
+            }
+            index = local[index];
+        }
+
+        // Reset the used entries for the next group.
+        for (const uint32_t index : used)
+        {
+            local[index] = UINT32_MAX;
+        }
+        used.clear();
+        statistics.vertices += geometry.x.size();
+        statistics.triangles += groups[g].indices.size() / 3;
+    }
+
+    model.parts.resize(groups.size());
+    threadPool.Run(static_cast<int>(groups.size()), [&](const int g)
+    {
+        auto mesh = std::make_shared<MeshGeometry>();
+        mesh->Build(std::move(geometries[g].x), std::move(geometries[g].y), std::move(geometries[g].z), std::move(groups[g].indices));
+        model.parts[g].geometry = std::move(mesh);
+        model.parts[g].materialId = groups[g].materialId;
+    });
+    for (const auto& part : model.parts)
+    {
+        model.bounds.Extend(part.geometry->Bounds());
+    }
+    statistics.buildTime = Elapsed(start);
+    return true;
+}
+
+void ObjFile::AddInstances(const Model& model, Scene& scene, const Math::Vector& position, const Math::Vector& rotation, const float scale)
+{
+    for (const auto& part : model.parts)
+    {
+        auto instance = scene.arena.Make<Instance>();
+        instance->geometry = part.geometry;
+        instance->materialId = part.materialId;
+        instance->position = position;
+        instance->rotation = rotation;
+        instance->SetScale(scale);
+        scene.primitives.push_back(instance);
+    }
+}
+
+bool ObjFile::LoadScene(const std::string& path, Raytracer& raytracer, Scene& scene, Camera& camera, Model& model, Statistics& statistics,
+    std::string& error, const int threadCount)
+{
+    if (!Load(path, raytracer, model, statistics, error, threadCount))
+    {
+        return false;
+    }
+    AddInstances(model, scene, Math::Vector(), Math::Vector(), 1.f);
+    if (model.bounds.Empty())
+    {
+        return true;
+    }
+
+    const auto center = model.bounds.Center();
+    const float radius = std::max(model.bounds.Size().Length() * 0.5f, 1e-3f);
+    camera.position = center + Math::Vector::Normalized({0.6f, 0.4f, -1.f, 0.f}) * (radius * 2.f);
+    camera.LookAtTarget(center);
+
+    auto light = scene.arena.Make<Light>();
+    light->position = camera.position;
+    light->color = {1.f, 1.f, 1.f, 0.f};
+    light->radius = INFINITY;
+    light->intensity = 1.f;
+    scene.lights.push_back(light);
+    scene.ambientLight = {0.1f, 0.1f, 0.1f, 0.f};
+    return true;
+}
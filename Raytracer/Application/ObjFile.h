@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Raytracer/Camera.h"
+#include "Raytracer/MeshGeometry.h"
+#include "Raytracer/Raytracer.h"
+
+// Wavefront OBJ geometry with the MTL materials.
+// Only the vertex positions and the faces are read, polygons are split to triangle fans.
+// Texture coordinates, normals, groups, smoothing groups, lines and points are ignored.
+// The faces of each material form one mesh geometry, vertices with the same position are merged.
+// MTL materials use Kd, Ks and Ns, faces without a known material use the default material.
+namespace ObjFile
+{
+    // Faces with a single material.
+    struct Part
+    {
+        std::shared_ptr<const MeshGeometry> geometry;
+        int materialId = 0;
+    };
+
+    struct Model
+    {
+        std::vector<Part> parts;
+
+        // Object-space bounds of all parts.
+        Math::Box bounds;
+
+        // Paths of the OBJ file and the MTL files.
+        std::vector<std::string> files;
+    };
+
+    struct Statistics
+    {
+        size_t bytes = 0;
+        size_t vertices = 0;
+        size_t triangles = 0;
+        size_t materials = 0;
+
+        // Mapping and parsing of the OBJ and MTL files, merging of the vertices and the mesh builds.
+        double parseTime = 0.0;
+        double buildTime = 0.0;
+    };
+
+    // Load the model, the MTL materials are added to the raytracer.
+    // The file is memory mapped and split to chunks parsed in parallel, 0 threads use all hardware threads.
+    // Returns false and the error description if a file can not be read or parsed.
+    bool Load(const std::string& path, Raytracer& raytracer, Model& model, Statistics& statistics, std::string& error, const int threadCount = 0);
+
+    // Add an instance of every model part to the scene.
+    void AddInstances(const Model& model, Scene& scene, const Math::Vector& position, const Math::Vector& rotation, const float scale);
+
+    // Load the model as a whole scene: its instances at the origin, a camera in front of it and a light at the camera.
+    bool LoadScene(const std::string& path, Raytracer& raytracer, Scene& scene, Camera& camera, Model& model, Statistics& statistics,
+        std::string& error, const int threadCount = 0);
+}
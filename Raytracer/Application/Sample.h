@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Raytracer/Raytracer.h"
+#include "Raytracer/TriangleMesh.h"
 
 class Sample
 {
@@ -8,6 +9,12 @@ public:
     Sample();
     void Draw(Framebuffer& output);
 
+    // Draw the scene in coarse to fine passes, see Raytracer::RenderProgressive().
+    bool DrawProgressive(Framebuffer& output, const Raytracer::PassCallback& callback);
+
+    // Add the sample materials to the raytracer and create the scene and camera.
+    static void Create(Raytracer& raytracer, Scene& scene, Camera& camera);
+
 private:
     Scene scene;
     Camera camera;
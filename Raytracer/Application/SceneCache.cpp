@@ -0,0 +1,545 @@
+#include "SceneCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include "Application/MappedFile.h"
+#include "Raytracer/Instance.h"
+
+namespace
+{
+    const char Magic[8] = {'R', 'T', 'S', 'C', 'A', 'C', 'H', 'E'};
+    const uint32_t Version = 1;
+
+    // Written in the native byte order.
+    const uint32_t ByteOrder = 0x01020304;
+
+    // Alignment of the arrays, the mapping itself is page aligned.
+    const size_t Alignment = 64;
+
+    // Array of count items at the file offset.
+    struct Range
+    {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct CachedMaterial
+    {
+        float diffuseColor[4];
+        float specularColor[4];
+        float specularExp;
+        float specularIntensity;
+        uint32_t receiveShadows;
+        uint32_t padding;
+    };
+
+    struct CachedLight
+    {
+        float position[4];
+        float color[4];
+        float radius;
+        float intensity;
+        float exp;
+        uint32_t castShadows;
+    };
+
+    struct CachedCamera
+    {
+        float position[4];
+        float look[4];
+        float up[4];
+        float hfov;
+        float drawDistance;
+        uint32_t padding[2];
+    };
+
+    enum class CachedType: uint32_t
+    {
+        Sphere,
+        Plane,
+        Triangle,
+        Instance
+    };
+
+    // Material index 0 is the default material, other indices are the cached materials from 1.
+    // Spheres store the radius and instances the scale in the size.
+    struct CachedPrimitive
+    {
+        CachedType type;
+        int32_t materialId;
+        uint32_t mesh;
+        float size;
+        float position[4];
+        float rotation[4];
+        float v0[4];
+        float v1[4];
+        float v2[4];
+    };
+
+    // Vertex arrays, 3 indices per triangle and the BVH.
+    struct CachedMesh
+    {
+        Range x;
+        Range y;
+        Range z;
+        Range indices;
+        Range nodes;
+        Range items;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t nodeSize;
+        uint32_t primitiveSize;
+        uint64_t fileSize;
+
+        // Scene path and the source paths, each path is a range of characters.
+        uint64_t sourceHash;
+        Range scenePath;
+        Range sources;
+
+        Range materials;
+        Range lights;
+        Range primitives;
+        Range meshes;
+        CachedCamera camera;
+        float backgroundColor[4];
+        float ambientLight[4];
+    };
+
+    void StoreVector(const Math::Vector& v, float* const output)
+    {
+        output[0] = v.x;
+        output[1] = v.y;
+        output[2] = v.z;
+        output[3] = v.w;
+    }
+
+    Math::Vector LoadVector(const float* const input)
+    {
+        return {input[0], input[1], input[2], input[3]};
+    }
+
+    // File contents built in memory, the header is written last.
+    class Writer
+    {
+    public:
+        Writer(): data(sizeof(Header), 0) {}
+
+        template <typename T>
+        Range Append(const T* const items, const size_t count)
+        {
+            data.resize((data.size() + Alignment - 1) / Alignment * Alignment, 0);
+            const Range range{data.size(), count};
+            const char* const bytes = reinterpret_cast<const char*>(items);
+            data.insert(data.end(), bytes, bytes + count * sizeof(T));
+            return range;
+        }
+
+        Range Append(const std::string& text)
+        {
+            return Append(text.data(), text.size());
+        }
+
+        std::vector<char> data;
+    };
+
+    // Array of the mapped file, nullptr for the ranges out of the file or with an invalid alignment.
+    template <typename T>
+    const T* Array(const MappedFile& file, const Range& range)
+    {
+        const uint64_t size = file.Size();
+        if (range.offset > size || range.count > (size - range.offset) / sizeof(T) || range.offset % alignof(T) != 0)
+        {
+            return nullptr;
+        }
+        return reinterpret_cast<const T*>(file.Data() + range.offset);
+    }
+
+    bool Text(const MappedFile& file, const Range& range, std::string& text)
+    {
+        const char* const chars = Array<char>(file, range);
+        if (chars == nullptr)
+        {
+            return false;
+        }
+        text.assign(chars, static_cast<size_t>(range.count));
+        return true;
+    }
+}
+
+bool SceneCache::HashFiles(const std::vector<std::string>& paths, uint64_t& hash)
+{
+    // Words are mixed with the multiplicative hash, the sizes separate the files.
+    const uint64_t Multiplier = 0x9e3779b97f4a7c15ull;
+    uint64_t h = 0xcbf29ce484222325ull;
+    const auto mix = [&](const uint64_t word)
+    {
+        h = (h ^ word) * Multiplier;
+        h ^= h >> 29;
+    };
+
+    for (const auto& path : paths)
+    {
+        MappedFile file;
+        if (!file.Open(path))
+        {
+            return false;
+        }
+
+        const char* const data = file.Data();
+        const size_t size = file.Size();
+        mix(size);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            mix(word);
+        }
+        // Empty files have no mapped data.
+        uint64_t tail = 0;
+        if (size > i)
+        {
+            std::memcpy(&tail, data + i, size - i);
+        }
+        mix(tail);
+    }
+
+    hash = h;
+    return true;
+}
+
+bool SceneCache::Write(const std::string& path, const std::string& scenePath, const std::vector<std::string>& sources,
+    const Raytracer& raytracer, const Scene& scene, const Camera& camera, std::string& error)
+{
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.byteOrder = ByteOrder;
+    header.nodeSize = sizeof(Bvh::Node);
+    header.primitiveSize = sizeof(CachedPrimitive);
+
+    if (!HashFiles(sources, header.sourceHash))
+    {
+        error = "Can not read the scene sources";
+        return false;
+    }
+
+    Writer writer;
+    header.scenePath = writer.Append(scenePath);
+    std::vector<Range> paths;
+    for (const auto& source : sources)
+    {
+        paths.push_back(writer.Append(source));
+    }
+    header.sources = writer.Append(paths.data(), paths.size());
+
+    // The default material is not stored.
+    const auto& materials = raytracer.Materials();
+    std::vector<CachedMaterial> cachedMaterials;
+    for (size_t i = 1; i < materials.size(); ++i)
+    {
+        const Material& material = materials[i];
+        CachedMaterial cached = {};
+        StoreVector(material.diffuseColor, cached.diffuseColor);
+        StoreVector(material.specularColor, cached.specularColor);
+        cached.specularExp = material.specularExp;
+        cached.specularIntensity = material.specularIntensity;
+        cached.receiveShadows = material.receiveShadows ? 1 : 0;
+        cachedMaterials.push_back(cached);
+    }
+    header.materials = writer.Append(cachedMaterials.data(), cachedMaterials.size());
+
+    std::vector<CachedLight> lights;
+    for (const auto& light : scene.lights)
+    {
+        if (light == nullptr)
+        {
+            continue;
+        }
+        CachedLight cached = {};
+        StoreVector(light->position, cached.position);
+        StoreVector(light->color, cached.color);
+        cached.radius = light->radius;
+        cached.intensity = light->intensity;
+        cached.exp = light->exp;
+        cached.castShadows = light->castShadows ? 1 : 0;
+        lights.push_back(cached);
+    }
+    header.lights = writer.Append(lights.data(), lights.size());
+
+    // Shared geometries are stored once.
+    std::vector<CachedPrimitive> primitives;
+    std::vector<CachedMesh> meshes;
+    std::map<const MeshGeometry*, uint32_t> meshIndices;
+    for (const auto& primitive : scene.primitives)
+    {
+        if (primitive == nullptr)
+        {
+            continue;
+        }
+
+        CachedPrimitive cached = {};
+        cached.materialId = primitive->materialId;
+        StoreVector(primitive->position, cached.position);
+        StoreVector(primitive->rotation, cached.rotation);
+
+        if (const auto sphere = dynamic_cast<const Sphere*>(primitive))
+        {
+            cached.type = CachedType::Sphere;
+            cached.size = sphere->radius;
+        }
+        else if (dynamic_cast<const Plane*>(primitive) != nullptr)
+        {
+            cached.type = CachedType::Plane;
+        }
+        else if (const auto triangle = dynamic_cast<const Triangle*>(primitive))
+        {
+            cached.type = CachedType::Triangle;
+            StoreVector(triangle->v0, cached.v0);
+            StoreVector(triangle->v1, cached.v1);
+            StoreVector(triangle->v2, cached.v2);
+        }
+        else if (const auto instance = dynamic_cast<const Instance*>(primitive))
+        {
+            cached.type = CachedType::Instance;
+            cached.size = instance->Scale();
+            cached.mesh = UINT32_MAX;
+
+            const MeshGeometry* const geometry = instance->geometry.get();
+            if (geometry != nullptr)
+            {
+                const auto it = meshIndices.find(geometry);
+                if (it != meshIndices.end())
+                {
+                    cached.mesh = it->second;
+                }
+                else
+                {
+                    const auto& arrays = geometry->Data();
+                    const auto& bvh = geometry->Hierarchy();
+                    CachedMesh mesh;
+                    mesh.x = writer.Append(arrays.x, arrays.vertexCount);
+                    mesh.y = writer.Append(arrays.y, arrays.vertexCount);
+                    mesh.z = writer.Append(arrays.z, arrays.vertexCount);
+                    mesh.indices = writer.Append(arrays.indices, 3 * arrays.triangleCount);
+                    mesh.nodes = writer.Append(bvh.Nodes(), bvh.NodeCount());
+                    mesh.items = writer.Append(bvh.Items(), bvh.ItemCount());
+                    cached.mesh = static_cast<uint32_t>(meshes.size());
+                    meshIndices[geometry] = cached.mesh;
+                    meshes.push_back(mesh);
+                }
+            }
+        }
+        else
+        {
+            error = "Unsupported primitive type";
+            return false;
+        }
+        primitives.push_back(cached);
+    }
+    header.primitives = writer.Append(primitives.data(), primitives.size());
+    header.meshes = writer.Append(meshes.data(), meshes.size());
+
+    StoreVector(camera.position, header.camera.position);
+    StoreVector(camera.Look(), header.camera.look);
+    StoreVector(camera.Up(), header.camera.up);
+    header.camera.hfov = camera.HFov();
+    header.camera.drawDistance = camera.drawDistance;
+    StoreVector(scene.backgroundColor, header.backgroundColor);
+    StoreVector(scene.ambientLight, header.ambientLight);
+
+    header.fileSize = writer.data.size();
+    std::memcpy(writer.data.data(), &header, sizeof(header));
+
+    // The complete file replaces the previous cache.
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.write(writer.data.data(), static_cast<std::streamsize>(writer.data.size())))
+        {
+            error = "Can not write " + temporary;
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        error = "Can not write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool SceneCache::Load(const std::string& path, const std::string& scenePath, Raytracer& raytracer, Scene& scene, Camera& camera, std::string& error)
+{
+    // The mapping is shared by the mesh geometries.
+    auto file = std::make_shared<MappedFile>();
+    if (!file->Open(path))
+    {
+        error = "Can not open " + path;
+        return false;
+    }
+
+    const Header* const header = Array<Header>(*file, {0, 1});
+    if (header == nullptr || std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version ||
+        header->byteOrder != ByteOrder || header->nodeSize != sizeof(Bvh::Node) || header->primitiveSize != sizeof(CachedPrimitive) ||
+        header->fileSize != file->Size())
+    {
+        error = "Invalid cache " + path;
+        return false;
+    }
+
+    // The cache must be written for the same scene and sources.
+    std::string cachedScenePath;
+    const Range* const paths = Array<Range>(*file, header->sources);
+    std::vector<std::string> sources(paths != nullptr ? header->sources.count : 0);
+    bool valid = Text(*file, header->scenePath, cachedScenePath) && paths != nullptr;
+    for (size_t i = 0; valid && i < sources.size(); ++i)
+    {
+        valid = Text(*file, paths[i], sources[i]);
+    }
+    if (!valid)
+    {
+        error = "Invalid cache " + path;
+        return false;
+    }
+    uint64_t hash = 0;
+    if (cachedScenePath != scenePath || !HashFiles(sources, hash) || hash != header->sourceHash)
+    {
+        error = "Sources changed";
+        return false;
+    }
+
+    const auto* const materials = Array<CachedMaterial>(*file, header->materials);
+    const auto* const lights = Array<CachedLight>(*file, header->lights);
+    const auto* const primitives = Array<CachedPrimitive>(*file, header->primitives);
+    const auto* const meshes = Array<CachedMesh>(*file, header->meshes);
+    if (materials == nullptr || lights == nullptr || primitives == nullptr || meshes == nullptr)
+    {
+        error = "Invalid cache " + path;
+        return false;
+    }
+
+    // Geometries use the mapped arrays.
+    std::vector<std::shared_ptr<const MeshGeometry>> geometries;
+    for (size_t i = 0; i < header->meshes.count; ++i)
+    {
+        const CachedMesh& mesh = meshes[i];
+        MeshGeometry::Arrays arrays;
+        arrays.x = Array<float>(*file, mesh.x);
+        arrays.y = Array<float>(*file, mesh.y);
+        arrays.z = Array<float>(*file, mesh.z);
+        arrays.indices = Array<uint32_t>(*file, mesh.indices);
+        arrays.vertexCount = mesh.x.count;
+        arrays.triangleCount = mesh.indices.count / 3;
+        const auto* const nodes = Array<Bvh::Node>(*file, mesh.nodes);
+        const auto* const items = Array<uint32_t>(*file, mesh.items);
+        if (arrays.x == nullptr || arrays.y == nullptr || arrays.z == nullptr || arrays.indices == nullptr || nodes == nullptr || items == nullptr ||
+            mesh.y.count != mesh.x.count || mesh.z.count != mesh.x.count || mesh.indices.count % 3 != 0 ||
+            !Bvh::Valid(nodes, mesh.nodes.count, items, mesh.items.count, arrays.triangleCount))
+        {
+            error = "Invalid cache " + path;
+            return false;
+        }
+
+        // The mapped arrays are used without checks by the intersections.
+        for (size_t j = 0; j < mesh.indices.count; ++j)
+        {
+            if (arrays.indices[j] >= arrays.vertexCount)
+            {
+                error = "Invalid cache " + path;
+                return false;
+            }
+        }
+
+        auto geometry = std::make_shared<MeshGeometry>();
+        geometry->Assign(arrays, nodes, mesh.nodes.count, items, mesh.items.count, file);
+        geometries.push_back(std::move(geometry));
+    }
+
+    // The cache is valid, the materials are added with new ids.
+    std::vector<int> materialIds(header->materials.count + 1, 0);
+    for (size_t i = 0; i < header->materials.count; ++i)
+    {
+        Material material;
+        material.diffuseColor = LoadVector(materials[i].diffuseColor);
+        material.specularColor = LoadVector(materials[i].specularColor);
+        material.specularExp = materials[i].specularExp;
+        material.specularIntensity = materials[i].specularIntensity;
+        material.receiveShadows = (materials[i].receiveShadows != 0);
+        materialIds[i + 1] = raytracer.AddMaterial(material);
+    }
+    const auto materialId = [&](const int32_t id)
+    {
+        return (id >= 0 && static_cast<size_t>(id) < materialIds.size()) ? materialIds[id] : 0;
+    };
+
+    for (size_t i = 0; i < header->lights.count; ++i)
+    {
+        auto light = scene.arena.Make<Light>();
+        light->position = LoadVector(lights[i].position);
+        light->color = LoadVector(lights[i].color);
+        light->radius = lights[i].radius;
+        light->intensity = lights[i].intensity;
+        light->exp = lights[i].exp;
+        light->castShadows = (lights[i].castShadows != 0);
+        scene.lights.push_back(light);
+    }
+
+    for (size_t i = 0; i < header->primitives.count; ++i)
+    {
+        const CachedPrimitive& cached = primitives[i];
+        Primitive* primitive = nullptr;
+        switch (cached.type)
+        {
+        case CachedType::Sphere:
+        {
+            auto sphere = scene.arena.Make<Sphere>();
+            sphere->radius = cached.size;
+            primitive = sphere;
+            break;
+        }
+        case CachedType::Plane:
+            primitive = scene.arena.Make<Plane>();
+            break;
+        case CachedType::Triangle:
+        {
+            auto triangle = scene.arena.Make<Triangle>();
+            triangle->v0 = LoadVector(cached.v0);
+            triangle->v1 = LoadVector(cached.v1);
+            triangle->v2 = LoadVector(cached.v2);
+            primitive = triangle;
+            break;
+        }
+        case CachedType::Instance:
+        {
+            auto instance = scene.arena.Make<Instance>();
+            instance->SetScale(cached.size);
+            instance->geometry = cached.mesh < geometries.size() ? geometries[cached.mesh] : nullptr;
+            primitive = instance;
+            break;
+        }
+        default:
+            continue;
+        }
+        primitive->materialId = materialId(cached.materialId);
+        primitive->position = LoadVector(cached.position);
+        primitive->rotation = LoadVector(cached.rotation);
+        scene.primitives.push_back(primitive);
+    }
+
+    camera.position = LoadVector(header->camera.position);
+    camera.SetOrientation(LoadVector(header->camera.look), LoadVector(header->camera.up));
+    camera.SetFov(header->camera.hfov);
+    camera.drawDistance = header->camera.drawDistance;
+    scene.backgroundColor = LoadVector(header->backgroundColor);
+    scene.ambientLight = LoadVector(header->ambientLight);
+    return true;
+}
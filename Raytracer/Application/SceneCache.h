@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Raytracer/Raytracer.h"
+#include "Raytracer/Camera.h"
+
+// Binary cache of a loaded scene: materials, lights, camera, primitives and the mesh geometries with their BVHs.
+// The layout has no pointers, the arrays are referenced by their file offsets. Loading maps the file and
+// the meshes use the validated mapped arrays directly, only the top-level BVH over the primitives is built again.
+// The cache stores the paths of the source files and the hash of their contents, it is valid only while
+// the sources have the same hash. The format depends on the byte order and the structure layout of the build.
+namespace SceneCache
+{
+    // Hash of the file contents, returns false if a file can not be read.
+    bool HashFiles(const std::vector<std::string>& paths, uint64_t& hash);
+
+    // Write the scene loaded from the scene path and the source files, the sample scene has an empty path.
+    // Only spheres, planes, triangles and instances are supported.
+    bool Write(const std::string& path, const std::string& scenePath, const std::vector<std::string>& sources,
+        const Raytracer& raytracer, const Scene& scene, const Camera& camera, std::string& error);
+
+    // Load the cache written for the scene path, materials are added to the raytracer.
+    // Returns false and the reason if the cache can not be read or its sources changed, the scene is not changed.
+    bool Load(const std::string& path, const std::string& scenePath, Raytracer& raytracer, Scene& scene, Camera& camera, std::string& error);
+}
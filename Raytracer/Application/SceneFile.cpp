@@ -0,0 +1,287 @@
+#include "SceneFile.h"
+#include <fstream>
+#include <map>
+#include <sstream>
+#include "Application/ObjFile.h"
+
+namespace
+{
+    float Radians(const float degrees)
+    {
+        return degrees * (Math::Pi / 180.f);
+    }
+
+    // Read a point or a direction (w = 0) from the line.
+    bool ReadVector(std::istringstream& line, Math::Vector& v)
+    {
+        float x, y, z;
+        if (!(line >> x >> y >> z))
+        {
+            return false;
+        }
+        v = {x, y, z, 0.f};
+        return true;
+    }
+
+    // Read a color with opaque alpha from the line.
+    bool ReadColor(std::istringstream& line, Math::Vector& color)
+    {
+        if (!ReadVector(line, color))
+        {
+            return false;
+        }
+        color.w = 1.f;
+        return true;
+    }
+
+    // Read the optional material name, unknown names are errors.
+    bool ReadMaterial(std::istringstream& line, const std::map<std::string, int>& materials, int& materialId)
+    {
+        std::string name;
+        if (!(line >> name))
+        {
+            materialId = 0;
+            return true;
+        }
+        const auto it = materials.find(name);
+        if (it == materials.end())
+        {
+            return false;
+        }
+        materialId = it->second;
+        return true;
+    }
+}
+
+bool SceneFile::Load(const std::string& path, Raytracer& raytracer, Scene& scene, Camera& camera, std::string& error,
+    std::vector<std::string>* sources, Animation* animation)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "Can not open " + path;
+        return false;
+    }
+    if (sources != nullptr)
+    {
+        sources->push_back(path);
+    }
+
+    std::map<std::string, int> materials;
+    std::map<std::string, ObjFile::Model> models;
+
+    // Primitives [itemBegin; itemEnd) of the last primitive item and their animation track, -1 until the first key.
+    size_t itemBegin = 0;
+    size_t itemEnd = 0;
+    int track = -1;
+
+    // Times of the last keys.
+    float itemTime = -INFINITY;
+    float cameraTime = -INFINITY;
+
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text))
+    {
+        ++lineNumber;
+
+        // Remove the comment.
+        const auto comment = text.find('#');
+        if (comment != std::string::npos)
+        {
+            text.erase(comment);
+        }
+
+        std::istringstream line(text);
+        std::string keyword;
+        if (!(line >> keyword))
+        {
+            continue;
+        }
+
+        const size_t primitiveCount = scene.primitives.size();
+        bool valid = true;
+        if (keyword == "background")
+        {
+            valid = ReadColor(line, scene.backgroundColor);
+        }
+        else if (keyword == "ambient")
+        {
+            valid = ReadVector(line, scene.ambientLight);
+        }
+        else if (keyword == "camera")
+        {
+            Math::Vector target;
+            valid = ReadVector(line, camera.position) && ReadVector(line, target);
+            if (valid)
+            {
+                camera.LookAtTarget(target);
+                float hfov;
+                if (line >> hfov)
+                {
+                    camera.SetFov(Radians(hfov));
+                    line >> camera.drawDistance;
+                }
+            }
+        }
+        else if (keyword == "material")
+        {
+            std::string name;
+            Material material;
+            valid = (line >> name) &&
+                ReadColor(line, material.diffuseColor) &&
+                ReadColor(line, material.specularColor) &&
+                (line >> material.specularExp >> material.specularIntensity);
+            if (valid)
+            {
+                int receiveShadows = 1;
+                line >> receiveShadows;
+                material.receiveShadows = (receiveShadows != 0);
+                materials[name] = raytracer.AddMaterial(material);
+            }
+        }
+        else if (keyword == "light")
+        {
+            auto light = scene.arena.Make<Light>();
+            valid = ReadVector(line, light->position) &&
+                ReadVector(line, light->color) &&
+                (line >> light->radius >> light->intensity);
+            if (valid)
+            {
+                int castShadows = 1;
+                line >> light->exp >> castShadows;
+                light->castShadows = (castShadows != 0);
+                scene.lights.push_back(light);
+            }
+        }
+        else if (keyword == "sphere")
+        {
+            auto sphere = scene.arena.Make<Sphere>();
+            valid = ReadVector(line, sphere->position) &&
+                (line >> sphere->radius) &&
+                ReadMaterial(line, materials, sphere->materialId);
+            if (valid)
+            {
+                scene.primitives.push_back(sphere);
+            }
+        }
+        else if (keyword == "plane")
+        {
+            auto plane = scene.arena.Make<Plane>();
+            Math::Vector rotation;
+            valid = ReadVector(line, plane->position) &&
+                ReadVector(line, rotation) &&
+                ReadMaterial(line, materials, plane->materialId);
+            if (valid)
+            {
+                plane->rotation = {Radians(rotation.x), Radians(rotation.y), Radians(rotation.z), 0.f};
+                scene.primitives.push_back(plane);
+            }
+        }
+        else if (keyword == "triangle")
+        {
+            auto triangle = scene.arena.Make<Triangle>();
+            valid = ReadVector(line, triangle->v0) &&
+                ReadVector(line, triangle->v1) &&
+                ReadVector(line, triangle->v2) &&
+                ReadMaterial(line, materials, triangle->materialId);
+            if (valid)
+            {
+                scene.primitives.push_back(triangle);
+            }
+        }
+        else if (keyword == "obj")
+        {
+            std::string name;
+            Math::Vector position;
+            Math::Vector rotation;
+            float scale = 1.f;
+            valid = static_cast<bool>(line >> name);
+            if (valid && ReadVector(line, position) && ReadVector(line, rotation))
+            {
+                line >> scale;
+            }
+            if (valid)
+            {
+                // Paths are relative to the scene file.
+                const auto separator = path.find_last_of("/\\");
+                const std::string objPath = (separator == std::string::npos || name.find_first_of("/\\") == 0) ? name : path.substr(0, separator + 1) + name;
+                auto model = models.find(objPath);
+                if (model == models.end())
+                {
+                    ObjFile::Statistics statistics;
+                    model = models.emplace(objPath, ObjFile::Model()).first;
+                    if (!ObjFile::Load(objPath, raytracer, model->second, statistics, error))
+                    {
+                        return false;
+                    }
+                    if (sources != nullptr)
+                    {
+                        sources->insert(sources->end(), model->second.files.begin(), model->second.files.end());
+                    }
+                }
+                ObjFile::AddInstances(model->second, scene, position, {Radians(rotation.x), Radians(rotation.y), Radians(rotation.z), 0.f}, scale);
+            }
+        }
+        else if (keyword == "key")
+        {
+            Animation::PrimitiveKey key;
+            valid = itemBegin < itemEnd && (line >> key.time) && ReadVector(line, key.position) && key.time >= itemTime;
+            if (valid)
+            {
+                itemTime = key.time;
+                Math::Vector rotation;
+                key.rotation = ReadVector(line, rotation) ?
+                    Math::Vector(Radians(rotation.x), Radians(rotation.y), Radians(rotation.z), 0.f) : scene.primitives[itemBegin]->rotation;
+                if (animation != nullptr)
+                {
+                    // The loader created the primitives, so they can be moved.
+                    if (track < 0)
+                    {
+                        track = static_cast<int>(animation->tracks.size());
+                        animation->tracks.emplace_back();
+                        for (size_t i = itemBegin; i < itemEnd; ++i)
+                        {
+                            animation->tracks.back().primitives.push_back(const_cast<Primitive*>(scene.primitives[i]));
+                        }
+                    }
+                    animation->tracks[track].keys.push_back(key);
+                }
+            }
+        }
+        else if (keyword == "camerakey")
+        {
+            Animation::CameraKey key;
+            valid = (line >> key.time) && ReadVector(line, key.position) && ReadVector(line, key.target) && key.time >= cameraTime;
+            if (valid)
+            {
+                cameraTime = key.time;
+                if (animation != nullptr)
+                {
+                    animation->camera.push_back(key);
+                }
+            }
+        }
+        else
+        {
+            error = path + ":" + std::to_string(lineNumber) + ": unknown item " + keyword;
+            return false;
+        }
+
+        if (!valid)
+        {
+            error = path + ":" + std::to_string(lineNumber) + ": invalid " + keyword;
+            return false;
+        }
+
+        if (scene.primitives.size() != primitiveCount)
+        {
+            itemBegin = primitiveCount;
+            itemEnd = scene.primitives.size();
+            track = -1;
+            itemTime = -INFINITY;
+        }
+    }
+
+    return true;
+}
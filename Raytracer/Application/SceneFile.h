@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Application/Animation.h"
+#include "Raytracer/Raytracer.h"
+#include "Raytracer/Camera.h"
+
+// Text scene description, one item per line, '#' starts a comment.
+// Colors are linear RGB, angles are in degrees, materials are referenced by their names.
+// Shadow flags are 0 or 1, shadows are enabled by default.
+//
+//   background r g b
+//   ambient r g b
+//   camera x y z targetX targetY targetZ [hfov] [drawDistance]
+//   material name diffuseR diffuseG diffuseB specularR specularG specularB specularExp specularIntensity [receiveShadows]
+//   light x y z r g b radius intensity [exp] [castShadows]
+//   sphere x y z radius [material]
+//   plane x y z rotationX rotationY rotationZ [material]
+//   triangle x0 y0 z0 x1 y1 z1 x2 y2 z2 [material]
+//   obj path [x y z [rotationX rotationY rotationZ [scale]]]
+//   key time x y z [rotationX rotationY rotationZ]
+//   camerakey time x y z targetX targetY targetZ
+//
+// OBJ paths are relative to the scene file, the OBJ materials are used. Every obj item adds instances
+// of the model meshes, the model is loaded once per path.
+// Key items animate the primitives of the previous item, all instances of an obj item move together.
+// The rotation of a key defaults to the rotation of the item. Key times are in seconds and must not decrease.
+namespace SceneFile
+{
+    // Load the scene, materials are added to the raytracer.
+    // Returns false and the error description if the file can not be read or parsed.
+    // The paths of the scene file and of all files it references are added to the sources.
+    // The keys are added to the animation, they are ignored without it.
+    bool Load(const std::string& path, Raytracer& raytracer, Scene& scene, Camera& camera, std::string& error,
+        std::vector<std::string>* sources = nullptr, Animation* animation = nullptr);
+}
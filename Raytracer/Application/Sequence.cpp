@@ -0,0 +1,184 @@
+#include "Sequence.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Application/ImageFile.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double Seconds(const Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void Accumulate(RenderTimings& total, const RenderTimings& timings)
+    {
+        total.transform += timings.transform;
+        total.build += timings.build;
+        total.trace += timings.trace;
+        total.resolve += timings.resolve;
+        total.rays += timings.rays;
+        total.shadowRays += timings.shadowRays;
+        total.antialiasedPixels += timings.antialiasedPixels;
+        total.antialiasingSamples += timings.antialiasingSamples;
+        total.retracedPixels += timings.retracedPixels;
+    }
+
+    // Framebuffers passed between the rendering and the writer thread.
+    class FrameQueue
+    {
+    public:
+        struct Item
+        {
+            int frame;
+            Framebuffer* framebuffer;
+        };
+
+        void Push(const Item& item)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                items.push_back(item);
+            }
+            condition.notify_one();
+        }
+
+        // Wait for an item, returns false if the queue was closed and is empty.
+        bool Pop(Item& item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !items.empty() || closed; });
+            if (items.empty())
+            {
+                return false;
+            }
+            item = items.front();
+            items.pop_front();
+            return true;
+        }
+
+        void Close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            condition.notify_all();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Item> items;
+        bool closed = false;
+    };
+}
+
+std::string Sequence::FramePath(const std::string& output, const int frame)
+{
+    char number[16];
+    std::snprintf(number, sizeof(number), "%04d", frame);
+
+    const auto separator = output.find_last_of("/\\");
+    const auto dot = output.find_last_of('.');
+    const bool extension = dot != std::string::npos && (separator == std::string::npos || dot > separator);
+    return extension ? output.substr(0, dot) + number + output.substr(dot) : output + number;
+}
+
+bool Sequence::Render(Raytracer& raytracer, const Scene& scene, Camera& camera, const Animation& animation, const Settings& settings,
+    Statistics& statistics, std::string& error)
+{
+    const auto start = Clock::now();
+
+    std::vector<std::unique_ptr<Framebuffer>> framebuffers;
+    FrameQueue available;
+    FrameQueue written;
+    for (int i = 0; i < std::max(settings.framebufferCount, 1); ++i)
+    {
+        framebuffers.push_back(std::unique_ptr<Framebuffer>(new Framebuffer(FramebufferFormat::RGBA8)));
+        framebuffers.back()->Resize(settings.width, settings.height);
+        framebuffers.back()->SetResolveSettings(settings.resolve);
+        available.Push({-1, framebuffers.back().get()});
+    }
+
+    // The writer returns the framebuffers to the free queue, the first failed frame stops the sequence.
+    std::mutex errorMutex;
+    bool failed = false;
+    std::thread writer([&]()
+    {
+        FrameQueue::Item item;
+        while (written.Pop(item))
+        {
+            auto begin = Clock::now();
+            const auto rgb = ImageFile::PackRgb(*item.framebuffer);
+            statistics.pack += Seconds(begin);
+
+            begin = Clock::now();
+            const auto path = FramePath(settings.output, item.frame);
+            const bool success = ImageFile::Write(path, rgb, settings.width, settings.height);
+            statistics.write += Seconds(begin);
+
+            if (!success)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!failed)
+                {
+                    failed = true;
+                    error = "Can not write " + path;
+                }
+            }
+            available.Push(item);
+        }
+    });
+
+    // The incremental rendering continues from a copy of the previous frame, the writer only reads it meanwhile.
+    const Framebuffer* previous = nullptr;
+    const bool incremental = raytracer.Settings().incrementalRendering;
+
+    camera.SetAspectRatio(static_cast<float>(settings.width), static_cast<float>(settings.height));
+    for (int frame = 0; frame < settings.frameCount; ++frame)
+    {
+        auto begin = Clock::now();
+        FrameQueue::Item item;
+        available.Pop(item);
+        statistics.stall += Seconds(begin);
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (failed)
+            {
+                break;
+            }
+        }
+
+        begin = Clock::now();
+        animation.Apply(static_cast<float>(frame) / settings.frameRate, camera);
+        statistics.update += Seconds(begin);
+
+        begin = Clock::now();
+        if (incremental && previous != nullptr)
+        {
+            item.framebuffer->CopyFrom(*previous);
+        }
+        raytracer.Render(scene, camera, *item.framebuffer);
+        statistics.render += Seconds(begin);
+        previous = item.framebuffer;
+        Accumulate(statistics.timings, raytracer.Timings());
+
+        item.frame = frame;
+        written.Push(item);
+        ++statistics.frames;
+    }
+
+    written.Close();
+    writer.join();
+    statistics.total = Seconds(start);
+    return !failed;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include "Application/Animation.h"
+#include "Raytracer/Raytracer.h"
+
+// Pipelined rendering of an animation to numbered images.
+// The calling thread updates the scene and renders frame N + 1 while a writer thread packs, encodes
+// and writes frame N. Frames cycle through a fixed number of framebuffers, the rendering waits only
+// if all of them are still queued for writing.
+namespace Sequence
+{
+    struct Settings
+    {
+        int width = 1280;
+        int height = 720;
+        ResolveSettings resolve;
+
+        // Frame i shows the animation at the time i / frameRate.
+        int frameCount = 1;
+        float frameRate = 24.f;
+
+        // Framebuffers rendered or written at the same time, 1 renders and writes the frames in turn.
+        int framebufferCount = 2;
+
+        // Image path, the frame number is inserted before the extension, see FramePath().
+        std::string output = "output.ppm";
+    };
+
+    // Sums over all frames in seconds.
+    struct Statistics
+    {
+        int frames = 0;
+
+        // Whole sequence from the first update to the last written image.
+        double total = 0.0;
+
+        // Rendering thread: animation update, Raytracer::Render() and waiting for a free framebuffer.
+        double update = 0.0;
+        double render = 0.0;
+        double stall = 0.0;
+
+        // Writer thread: conversion to the RGB rows and the image encoding with the file output.
+        double pack = 0.0;
+        double write = 0.0;
+
+        // Render() timings summed over the frames.
+        RenderTimings timings;
+    };
+
+    // Output path of the frame, "frames/out.png" with frame 7 is "frames/out0007.png".
+    std::string FramePath(const std::string& output, const int frame);
+
+    // Render the frames with the animation applied to the camera and the primitives of the scene.
+    // Returns false and the error description if an image can not be written, the remaining frames are not rendered.
+    bool Render(Raytracer&, const Scene&, Camera&, const Animation&, const Settings&, Statistics&, std::string& error);
+}
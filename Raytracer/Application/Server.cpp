@@ -0,0 +1,587 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Application/ImageFile.h"
+#include "Application/ObjFile.h"
+#include "Application/Sample.h"
+#include "Application/SceneFile.h"
+#include "Application/Socket.h"
+
+// Render server keeping the scenes and their acceleration structures loaded between the jobs.
+// Clients connect to the socket and send one request line. The reply is a status line, "ok ..." or "error description",
+// followed by the data announced by the status line, and the connection is closed.
+//
+//   render scene width height png|ppm [priority P] [camera x y z targetX targetY targetZ [hfov]]
+//       Reply "ok size" followed by the encoded image. The camera defaults to the scene camera.
+//   load scene path [priority P]
+//       Load the scene file, the .obj model or "sample" under the name, a scene of the same name is replaced. Reply "ok".
+//   stats
+//       Reply "ok queue depth jobs count latency p50 ms p90 ms p99 ms max ms" over the last rendered jobs.
+//   renderstats
+//       Reply "ok" followed by the JSON render statistics of the last rendered job on the same line, see RenderStats.
+//   stop
+//       Render the queued jobs and stop the server. Reply "ok".
+//
+// Jobs are executed one at a time by the priority, higher first, and in the order of arrival.
+// The latency is the time from the received request to the sent reply.
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Longest request line and the largest image side.
+    const size_t MaxRequest = 1024;
+    const int MaxSize = 16384;
+
+    // Time for a client to send the request line, and the time limit of each wait for the reply sends.
+    const auto ClientTimeout = std::chrono::seconds(10);
+
+    // Latencies kept for the percentiles.
+    const size_t LatencyWindow = 4096;
+
+    struct Options
+    {
+        std::string listen;
+        std::vector<std::pair<std::string, std::string>> scenes;
+        RenderSettings settings;
+    };
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: raytracer-server --listen ADDRESS [options]\n"
+            "  --listen ADDRESS  Socket of the server, host:port or unix:path.\n"
+            "  --scene NAME=FILE Load the scene file, .obj model or \"sample\" at the start, can be repeated.\n"
+            "  --threads N       Rendering threads, 0 uses all hardware threads (default 0).\n"
+            "  --tile N          Tile size in pixels (default 32).\n"
+            "  --aa N            Adaptive anti-aliasing with up to N samples per edge pixel, rounded down to a\n"
+            "                    square grid of at least 2x2 (default 1, off).\n"
+        );
+    }
+
+    // Returns false for invalid arguments.
+    bool ParseOptions(const int argc, char** const argv, Options& options)
+    {
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            const std::string name = argv[i];
+            const std::string value = argv[i + 1];
+            if (name == "--listen")
+            {
+                options.listen = value;
+            }
+            else if (name == "--scene")
+            {
+                const auto separator = value.find('=');
+                if (separator == std::string::npos || separator == 0)
+                {
+                    return false;
+                }
+                options.scenes.emplace_back(value.substr(0, separator), value.substr(separator + 1));
+            }
+            else if (name == "--threads")
+            {
+                options.settings.threadCount = std::atoi(value.c_str());
+            }
+            else if (name == "--tile")
+            {
+                options.settings.tileSize = std::atoi(value.c_str());
+            }
+            else if (name == "--aa")
+            {
+                options.settings.antialiasingSamples = std::atoi(value.c_str());
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return argc % 2 == 1 && !options.listen.empty() && options.settings.threadCount >= 0;
+    }
+
+    double Milliseconds(const Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // Scene with its own raytracer, so the materials and the acceleration structure stay with the scene.
+    // The raytracers share the thread pool of the server, they render one job at a time.
+    struct LoadedScene
+    {
+        explicit LoadedScene(std::shared_ptr<ThreadPool> threadPool):
+            raytracer(std::move(threadPool))
+        {
+        }
+
+        Raytracer raytracer;
+        Scene scene;
+        Camera camera;
+    };
+
+    bool LoadScene(const std::string& path, const RenderSettings& settings, LoadedScene& loaded, std::string& error)
+    {
+        loaded.raytracer.SetSettings(settings);
+        if (path == "sample")
+        {
+            Sample::Create(loaded.raytracer, loaded.scene, loaded.camera);
+            return true;
+        }
+        if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".obj") == 0)
+        {
+            ObjFile::Model model;
+            ObjFile::Statistics statistics;
+            return ObjFile::LoadScene(path, loaded.raytracer, loaded.scene, loaded.camera, model, statistics, error, settings.threadCount);
+        }
+        return SceneFile::Load(path, loaded.raytracer, loaded.scene, loaded.camera, error);
+    }
+
+    struct Job
+    {
+        enum class Type
+        {
+            Render,
+            Load
+        };
+
+        Type type = Type::Render;
+        Socket client;
+        int priority = 0;
+        uint64_t sequence = 0;
+        Clock::time_point received;
+
+        std::string scene;
+        std::string path;
+        int width = 0;
+        int height = 0;
+        bool png = false;
+        bool camera = false;
+        Math::Vector position;
+        Math::Vector target;
+        float hfov = 0.f;
+    };
+
+    // Parse the render or load request, returns false for invalid requests.
+    bool ParseJob(std::istringstream& line, const std::string& command, Job& job)
+    {
+        if (command == "load")
+        {
+            job.type = Job::Type::Load;
+            if (!(line >> job.scene >> job.path))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            std::string format;
+            if (!(line >> job.scene >> job.width >> job.height >> format) || (format != "png" && format != "ppm") ||
+                job.width <= 0 || job.height <= 0 || job.width > MaxSize || job.height > MaxSize)
+            {
+                return false;
+            }
+            job.png = (format == "png");
+        }
+
+        std::vector<std::string> options;
+        std::string option;
+        while (line >> option)
+        {
+            options.push_back(option);
+        }
+
+        // Numbers of the options, the optional ones are read only if they are numbers.
+        size_t i = 0;
+        const auto number = [&](float& value)
+        {
+            char* end = nullptr;
+            if (i >= options.size())
+            {
+                return false;
+            }
+            value = std::strtof(options[i].c_str(), &end);
+            if (end == options[i].c_str() || *end != '\0')
+            {
+                return false;
+            }
+            ++i;
+            return true;
+        };
+
+        while (i < options.size())
+        {
+            const std::string name = options[i++];
+            float values[6];
+            if (name == "priority" && number(values[0]))
+            {
+                job.priority = static_cast<int>(values[0]);
+            }
+            else if (name == "camera" && job.type == Job::Type::Render &&
+                number(values[0]) && number(values[1]) && number(values[2]) && number(values[3]) && number(values[4]) && number(values[5]))
+            {
+                job.camera = true;
+                job.position = {values[0], values[1], values[2], 0.f};
+                job.target = {values[3], values[4], values[5], 0.f};
+                number(job.hfov);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Client sending its request line.
+    struct PendingClient
+    {
+        Socket socket;
+        std::string request;
+        Clock::time_point accepted;
+    };
+
+    // Read the available bytes of the request line, the line is complete after the '\n', a preceding '\r' is removed.
+    // Returns false if the connection was closed or the line is longer than the maximum size.
+    bool ReceiveRequest(PendingClient& client, bool& complete)
+    {
+        char buffer[256];
+        while (true)
+        {
+            const int count = client.socket.ReceiveAvailable(buffer, sizeof(buffer));
+            if (count <= 0)
+            {
+                return count == 0;
+            }
+            client.request.append(buffer, static_cast<size_t>(count));
+
+            const auto end = client.request.find('\n');
+            if (end != std::string::npos)
+            {
+                client.request.resize(end);
+                if (!client.request.empty() && client.request.back() == '\r')
+                {
+                    client.request.pop_back();
+                }
+                complete = true;
+                return client.request.size() <= MaxRequest;
+            }
+            if (client.request.size() > MaxRequest)
+            {
+                return false;
+            }
+        }
+    }
+
+    void Reply(Socket& client, const std::string& status)
+    {
+        const std::string line = status + "\n";
+        client.Send(line.data(), line.size());
+    }
+
+    class Server
+    {
+    public:
+        explicit Server(const RenderSettings& settings):
+            settings(settings),
+            threadPool(std::make_shared<ThreadPool>(settings.threadCount)),
+            framebuffer(FramebufferFormat::RGBA8)
+        {
+        }
+
+        // Load the scene before the server starts.
+        bool Load(const std::string& name, const std::string& path, std::string& error)
+        {
+            std::unique_ptr<LoadedScene> loaded(new LoadedScene(threadPool));
+            if (!LoadScene(path, settings, *loaded, error))
+            {
+                return false;
+            }
+
+            // Transform the primitives and build the acceleration structure now instead of in the first job.
+            Framebuffer warmup(FramebufferFormat::RGBA8);
+            warmup.Resize(1, 1);
+            loaded->raytracer.Render(loaded->scene, loaded->camera, warmup);
+            scenes[name] = std::move(loaded);
+            return true;
+        }
+
+        // Accept the requests until the stop request, the jobs are rendered by a separate thread.
+        // The request lines are read as they arrive, so an idle or slow client does not delay the others.
+        void Run(Socket& listener)
+        {
+            std::thread renderer([this]() { RenderLoop(); });
+            std::vector<PendingClient> clients;
+            while (!stopping)
+            {
+                std::vector<const Socket*> sockets = {&listener};
+                for (const auto& client : clients)
+                {
+                    sockets.push_back(&client.socket);
+                }
+                std::vector<uint8_t> readable;
+                Socket::Poll(sockets, readable, 100);
+
+                // Clients without the request line within the timeout are disconnected.
+                const auto now = Clock::now();
+                for (size_t i = 0; i < clients.size(); ++i)
+                {
+                    auto& client = clients[i];
+                    bool complete = false;
+                    if (readable[i + 1] != 0 && !ReceiveRequest(client, complete))
+                    {
+                        client.socket.Close();
+                    }
+                    else if (complete)
+                    {
+                        Handle(std::move(client.socket), client.request);
+                    }
+                    else if (now - client.accepted > ClientTimeout)
+                    {
+                        client.socket.Close();
+                    }
+                }
+                clients.erase(std::remove_if(clients.begin(), clients.end(), [](const PendingClient& client) { return !client.socket.Valid(); }), clients.end());
+
+                if (readable[0] != 0)
+                {
+                    PendingClient client;
+                    client.socket = listener.Accept();
+                    if (client.socket.Valid())
+                    {
+                        // The replies do not wait for a client which stopped reading.
+                        client.socket.SetTimeout(static_cast<int>(std::chrono::milliseconds(ClientTimeout).count()));
+                        client.accepted = now;
+                        clients.push_back(std::move(client));
+                    }
+                }
+            }
+            condition.notify_all();
+            renderer.join();
+        }
+
+    private:
+        void Handle(Socket client, const std::string& request)
+        {
+            std::istringstream line(request);
+            std::string command;
+            line >> command;
+
+            if (command == "stats")
+            {
+                Reply(client, Statistics());
+                return;
+            }
+            if (command == "renderstats")
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Reply(client, "ok " + renderStats);
+                return;
+            }
+            if (command == "stop")
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                Reply(client, "ok");
+                return;
+            }
+
+            std::unique_ptr<Job> job(new Job());
+            if ((command != "render" && command != "load") || !ParseJob(line, command, *job))
+            {
+                Reply(client, "error invalid request: " + request);
+                return;
+            }
+            job->client = std::move(client);
+            job->received = Clock::now();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job->sequence = sequence++;
+                queue.push_back(std::move(job));
+                std::push_heap(queue.begin(), queue.end(), Later);
+            }
+            condition.notify_one();
+        }
+
+        // Heap order, the job with the highest priority and then the lowest sequence number is at the top.
+        static bool Later(const std::unique_ptr<Job>& a, const std::unique_ptr<Job>& b)
+        {
+            return a->priority != b->priority ? a->priority < b->priority : a->sequence > b->sequence;
+        }
+
+        void RenderLoop()
+        {
+            while (true)
+            {
+                std::unique_ptr<Job> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [this]() { return !queue.empty() || stopping; });
+                    if (queue.empty())
+                    {
+                        return;
+                    }
+                    std::pop_heap(queue.begin(), queue.end(), Later);
+                    job = std::move(queue.back());
+                    queue.pop_back();
+                }
+
+                if (job->type == Job::Type::Load)
+                {
+                    std::string error;
+                    Reply(job->client, Load(job->scene, job->path, error) ? "ok" : "error " + error);
+                    continue;
+                }
+
+                const bool rendered = Render(*job);
+                const auto latency = Clock::now() - job->received;
+                if (rendered)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (latencies.size() < LatencyWindow)
+                    {
+                        latencies.push_back(latency);
+                    }
+                    else
+                    {
+                        latencies[completed % LatencyWindow] = latency;
+                    }
+                    ++completed;
+                }
+            }
+        }
+
+        // Render the job and send the image, returns false if the job failed.
+        bool Render(Job& job)
+        {
+            const auto it = scenes.find(job.scene);
+            if (it == scenes.end())
+            {
+                Reply(job.client, "error unknown scene " + job.scene);
+                return false;
+            }
+            LoadedScene& loaded = *it->second;
+
+            Camera camera = loaded.camera;
+            if (job.camera)
+            {
+                camera.position = job.position;
+                camera.LookAtTarget(job.target);
+                if (job.hfov > 0.f)
+                {
+                    camera.SetFov(job.hfov * (Math::Pi / 180.f));
+                }
+            }
+            camera.SetAspectRatio(static_cast<float>(job.width), static_cast<float>(job.height));
+
+            if (framebuffer.Width() != job.width || framebuffer.Height() != job.height)
+            {
+                framebuffer.Resize(job.width, job.height);
+            }
+            loaded.raytracer.Render(loaded.scene, camera, framebuffer);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                renderStats = loaded.raytracer.Stats().Json();
+            }
+
+            const auto rgb = ImageFile::PackRgb(framebuffer);
+            const auto image = job.png ? ImageFile::EncodePng(rgb, job.width, job.height) : ImageFile::EncodePpm(rgb, job.width, job.height);
+            Reply(job.client, "ok " + std::to_string(image.size()));
+            return job.client.Send(image.data(), image.size());
+        }
+
+        std::string Statistics()
+        {
+            std::vector<Clock::duration> sorted;
+            size_t depth;
+            uint64_t jobs;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                sorted = latencies;
+                depth = queue.size();
+                jobs = completed;
+            }
+            std::sort(sorted.begin(), sorted.end());
+
+            // Nearest-rank percentile of the window.
+            const auto percentile = [&](const double p)
+            {
+                if (sorted.empty())
+                {
+                    return 0.0;
+                }
+                const auto rank = static_cast<size_t>(p * static_cast<double>(sorted.size()) + 0.999999);
+                return Milliseconds(sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1]);
+            };
+
+            char text[256];
+            std::snprintf(text, sizeof(text), "ok queue %zu jobs %llu latency p50 %.3f p90 %.3f p99 %.3f max %.3f", depth,
+                static_cast<unsigned long long>(jobs), percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+            return text;
+        }
+
+        const RenderSettings settings;
+
+        // Thread pool of all scene raytracers.
+        const std::shared_ptr<ThreadPool> threadPool;
+
+        // Used only by the rendering thread once the server runs.
+        std::map<std::string, std::unique_ptr<LoadedScene>> scenes;
+        Framebuffer framebuffer;
+
+        // Job queue and the statistics, shared by the threads.
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::vector<std::unique_ptr<Job>> queue;
+        uint64_t sequence = 0;
+        std::atomic<bool> stopping{false};
+        std::vector<Clock::duration> latencies;
+        uint64_t completed = 0;
+        std::string renderStats = RenderStats().Json();
+    };
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Server server(options.settings);
+    std::string error;
+    for (const auto& scene : options.scenes)
+    {
+        const auto start = Clock::now();
+        if (!server.Load(scene.first, scene.second, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        std::printf("Scene %s: %s loaded in %.3f ms\n", scene.first.c_str(), scene.second.c_str(), Milliseconds(Clock::now() - start));
+    }
+
+    Socket listener;
+    if (!listener.Listen(options.listen, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::printf("Listening on %s\n", options.listen.c_str());
+    std::fflush(stdout);
+
+    server.Run(listener);
+    return 0;
+}
@@ -0,0 +1,414 @@
+#include "Socket.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char* const UnixPrefix = "unix:";
+
+#ifdef _WIN32
+    using Length = int;
+    const int SendFlags = 0;
+
+    // Winsock is initialized once for the process.
+    bool Startup()
+    {
+        static const bool started = []()
+        {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        return started;
+    }
+
+    void CloseHandle(const Socket::Handle handle)
+    {
+        closesocket(handle);
+    }
+
+    int PollHandles(pollfd* const handles, const size_t count, const int timeout)
+    {
+        return WSAPoll(handles, static_cast<ULONG>(count), timeout);
+    }
+#else
+    using Length = socklen_t;
+
+    // Writes to a closed connection fail instead of raising SIGPIPE.
+#ifdef MSG_NOSIGNAL
+    const int SendFlags = MSG_NOSIGNAL;
+#else
+    const int SendFlags = 0;
+#endif
+
+    bool Startup()
+    {
+        return true;
+    }
+
+    void CloseHandle(const Socket::Handle handle)
+    {
+        close(handle);
+    }
+
+    int PollHandles(pollfd* const handles, const size_t count, const int timeout)
+    {
+        return poll(handles, static_cast<nfds_t>(count), timeout);
+    }
+#endif
+
+    bool IsUnix(const std::string& address)
+    {
+        return address.compare(0, std::strlen(UnixPrefix), UnixPrefix) == 0;
+    }
+
+    // Split "host:port", the host may be empty.
+    bool SplitAddress(const std::string& address, std::string& host, std::string& port)
+    {
+        const auto separator = address.rfind(':');
+        if (separator == std::string::npos || separator + 1 == address.size())
+        {
+            return false;
+        }
+        host = address.substr(0, separator);
+        port = address.substr(separator + 1);
+        return true;
+    }
+}
+
+Socket::~Socket()
+{
+    Close();
+}
+
+Socket::Socket(Socket&& other) noexcept:
+    handle(other.handle),
+    path(std::move(other.path))
+{
+    other.handle = InvalidHandle();
+    other.path.clear();
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        handle = other.handle;
+        path = std::move(other.path);
+        other.handle = InvalidHandle();
+        other.path.clear();
+    }
+    return *this;
+}
+
+Socket::Handle Socket::InvalidHandle()
+{
+#ifdef _WIN32
+    return INVALID_SOCKET;
+#else
+    return -1;
+#endif
+}
+
+bool Socket::Valid() const
+{
+    return handle != InvalidHandle();
+}
+
+void Socket::Close()
+{
+    if (Valid())
+    {
+        CloseHandle(handle);
+        handle = InvalidHandle();
+    }
+#ifndef _WIN32
+    if (!path.empty())
+    {
+        unlink(path.c_str());
+        path.clear();
+    }
+#endif
+}
+
+bool Socket::Listen(const std::string& address, std::string& error)
+{
+    Close();
+    if (!Startup())
+    {
+        error = "Can not initialize the sockets";
+        return false;
+    }
+
+    if (IsUnix(address))
+    {
+#ifdef _WIN32
+        error = "UNIX domain sockets are not supported: " + address;
+        return false;
+#else
+        sockaddr_un name = {};
+        const std::string file = address.substr(std::strlen(UnixPrefix));
+        if (file.empty() || file.size() >= sizeof(name.sun_path))
+        {
+            error = "Invalid socket path: " + address;
+            return false;
+        }
+        name.sun_family = AF_UNIX;
+        std::memcpy(name.sun_path, file.c_str(), file.size());
+
+        // A stale socket file of a previous process would fail the bind.
+        unlink(file.c_str());
+        handle = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (!Valid() || bind(handle, reinterpret_cast<const sockaddr*>(&name), sizeof(name)) != 0 || listen(handle, SOMAXCONN) != 0)
+        {
+            Close();
+            error = "Can not listen on " + address;
+            return false;
+        }
+        path = file;
+        return true;
+#endif
+    }
+
+    std::string host;
+    std::string port;
+    if (!SplitAddress(address, host, port))
+    {
+        error = "Invalid address: " + address;
+        return false;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        error = "Can not resolve " + address;
+        return false;
+    }
+    for (const addrinfo* it = addresses; it != nullptr && !Valid(); it = it->ai_next)
+    {
+        handle = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (!Valid())
+        {
+            continue;
+        }
+        const int reuse = 1;
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        if (bind(handle, it->ai_addr, static_cast<Length>(it->ai_addrlen)) != 0 || listen(handle, SOMAXCONN) != 0)
+        {
+            Close();
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (!Valid())
+    {
+        error = "Can not listen on " + address;
+        return false;
+    }
+    return true;
+}
+
+bool Socket::Connect(const std::string& address, std::string& error)
+{
+    Close();
+    if (!Startup())
+    {
+        error = "Can not initialize the sockets";
+        return false;
+    }
+
+    if (IsUnix(address))
+    {
+#ifdef _WIN32
+        error = "UNIX domain sockets are not supported: " + address;
+        return false;
+#else
+        sockaddr_un name = {};
+        const std::string file = address.substr(std::strlen(UnixPrefix));
+        if (file.empty() || file.size() >= sizeof(name.sun_path))
+        {
+            error = "Invalid socket path: " + address;
+            return false;
+        }
+        name.sun_family = AF_UNIX;
+        std::memcpy(name.sun_path, file.c_str(), file.size());
+
+        handle = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (!Valid() || connect(handle, reinterpret_cast<const sockaddr*>(&name), sizeof(name)) != 0)
+        {
+            Close();
+            error = "Can not connect to " + address;
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    std::string host;
+    std::string port;
+    if (!SplitAddress(address, host, port))
+    {
+        error = "Invalid address: " + address;
+        return false;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        error = "Can not resolve " + address;
+        return false;
+    }
+    for (const addrinfo* it = addresses; it != nullptr && !Valid(); it = it->ai_next)
+    {
+        handle = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (Valid() && connect(handle, it->ai_addr, static_cast<Length>(it->ai_addrlen)) != 0)
+        {
+            Close();
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (!Valid())
+    {
+        error = "Can not connect to " + address;
+        return false;
+    }
+
+    // Messages are written whole, waiting for more data only adds latency.
+    const int noDelay = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    return true;
+}
+
+Socket Socket::Accept() const
+{
+    const Handle accepted = accept(handle, nullptr, nullptr);
+    if (accepted == InvalidHandle())
+    {
+        return Socket();
+    }
+
+    // Fails harmlessly for the UNIX domain sockets.
+    const int noDelay = 1;
+    setsockopt(accepted, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    return Socket(accepted);
+}
+
+bool Socket::Send(const void* const data, const size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    size_t sent = 0;
+    while (sent < size)
+    {
+        const auto count = send(handle, bytes + sent, static_cast<int>(std::min<size_t>(size - sent, 1 << 30)), SendFlags);
+        if (count <= 0)
+        {
+            return false;
+        }
+        sent += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool Socket::Receive(void* const data, const size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    size_t received = 0;
+    while (received < size)
+    {
+        const auto count = recv(handle, bytes + received, static_cast<int>(std::min<size_t>(size - received, 1 << 30)), 0);
+        if (count <= 0)
+        {
+            return false;
+        }
+        received += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+int Socket::ReceiveAvailable(void* const data, const size_t size)
+{
+    const int maxSize = static_cast<int>(std::min<size_t>(size, 1 << 30));
+#ifdef _WIN32
+    // Winsock has no flag for a single read without waiting, the poll tells if the read returns at once.
+    pollfd handles = {};
+    handles.fd = handle;
+    handles.events = POLLIN;
+    const int ready = PollHandles(&handles, 1, 0);
+    if (ready <= 0)
+    {
+        return ready == 0 ? 0 : -1;
+    }
+    const auto count = recv(handle, static_cast<char*>(data), maxSize, 0);
+    return count > 0 ? static_cast<int>(count) : -1;
+#else
+    const auto count = recv(handle, data, static_cast<size_t>(maxSize), MSG_DONTWAIT);
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        return 0;
+    }
+    return count > 0 ? static_cast<int>(count) : -1;
+#endif
+}
+
+bool Socket::SetTimeout(const int milliseconds)
+{
+#ifdef _WIN32
+    const DWORD timeout = static_cast<DWORD>(milliseconds);
+#else
+    timeval timeout = {};
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_usec = (milliseconds % 1000) * 1000;
+#endif
+    const char* const value = reinterpret_cast<const char*>(&timeout);
+    return setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, value, sizeof(timeout)) == 0 &&
+        setsockopt(handle, SOL_SOCKET, SO_SNDTIMEO, value, sizeof(timeout)) == 0;
+}
+
+bool Socket::Poll(const std::vector<const Socket*>& sockets, std::vector<uint8_t>& readable, const int timeout)
+{
+    std::vector<pollfd> handles(sockets.size());
+    for (size_t i = 0; i < sockets.size(); ++i)
+    {
+        handles[i].fd = sockets[i]->handle;
+        handles[i].events = POLLIN;
+    }
+
+    readable.assign(sockets.size(), 0);
+    if (PollHandles(handles.data(), handles.size(), timeout) <= 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < sockets.size(); ++i)
+    {
+        readable[i] = (handles[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+    }
+    return true;
+}
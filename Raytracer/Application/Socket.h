@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Blocking stream socket, TCP or UNIX domain. See ReceiveAvailable() and Poll() for the reads without waiting.
+// Addresses are "host:port" for TCP, an empty host listens on all interfaces, and "unix:path" for the UNIX domain sockets.
+class Socket
+{
+public:
+#ifdef _WIN32
+    using Handle = uintptr_t;
+#else
+    using Handle = int;
+#endif
+
+    Socket() = default;
+    ~Socket();
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    Socket(Socket&&) noexcept;
+    Socket& operator=(Socket&&) noexcept;
+
+    // Open a listening or a connected socket, the previous one is closed.
+    // Returns false and the error description if the address is invalid or can not be used.
+    bool Listen(const std::string& address, std::string& error);
+    bool Connect(const std::string& address, std::string& error);
+
+    // Accept a pending connection of the listening socket, returns an invalid socket on failure.
+    Socket Accept() const;
+
+    bool Valid() const;
+    void Close();
+
+    // Send or receive all the bytes. Returns false if the connection was closed or failed.
+    bool Send(const void* data, const size_t size);
+    bool Receive(void* data, const size_t size);
+
+    // Receive the bytes already available without waiting, up to the size.
+    // Returns the number of received bytes, 0 if there are none or -1 if the connection was closed or failed.
+    int ReceiveAvailable(void* data, const size_t size);
+
+    // Time limit in milliseconds of each wait in the blocking calls, 0 waits without a limit.
+    // A call exceeding the limit fails like on a lost connection.
+    bool SetTimeout(const int milliseconds);
+
+    // Wait until some of the sockets are readable, they have received data, were closed or have pending connections.
+    // The flags of the readable sockets are set. Returns false if none of them is readable within the timeout in milliseconds.
+    static bool Poll(const std::vector<const Socket*>& sockets, std::vector<uint8_t>& readable, const int timeout);
+
+private:
+    explicit Socket(const Handle handle): handle(handle) { }
+
+    Handle handle = InvalidHandle();
+
+    static Handle InvalidHandle();
+
+    // UNIX domain socket path to remove when the listening socket is closed.
+    std::string path;
+};
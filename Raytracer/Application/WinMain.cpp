@@ -5,6 +5,10 @@
 HWND CreateAppWindow(const HINSTANCE hInstance, const int nCmdShow);
 LRESULT CALLBACK WndProc(const HWND hwnd, const UINT message, const WPARAM wParam, const LPARAM lParam);
 void OnPaint(const HWND hwnd);
+void Present(const HDC hdc, const Framebuffer& framebuffer);
+
+// The window is being moved or resized by the user.
+static bool sizing = false;
 
 int CALLBACK WinMain(const HINSTANCE hInstance, const HINSTANCE hPrevInstance, const LPSTR lpCmdLine, const int nCmdShow)
 {
@@ -79,6 +83,16 @@ LRESULT CALLBACK WndProc(const HWND hwnd, const UINT message, const WPARAM wPara
         OnPaint(hwnd);
         return 0;
 
+    case WM_ENTERSIZEMOVE:
+        sizing = true;
+        return 0;
+
+    case WM_EXITSIZEMOVE:
+        // Redraw the frame in full quality if some passes were cancelled.
+        sizing = false;
+        InvalidateRect(hwnd, NULL, FALSE);
+        return 0;
+
     case WM_DESTROY:
         PostQuitMessage(0);
         return 0;
@@ -104,8 +118,25 @@ void OnPaint(const HWND hwnd)
     // Resize framebuffer.
     framebuffer.Resize(width, height);
 
-    // Draw scene to the framebuffer.
-    sample.Draw(framebuffer);
+    // Draw scene to the framebuffer, every pass is presented.
+    // While resizing the remaining passes are cancelled as soon as the user input is pending.
+    const bool completed = sample.DrawProgressive(framebuffer, [&](const int)
+    {
+        Present(hdc, framebuffer);
+        return !(sizing && HIWORD(GetQueueStatus(QS_INPUT)) != 0);
+    });
+    if (!completed)
+    {
+        InvalidateRect(hwnd, NULL, FALSE);
+    }
+
+    EndPaint(hwnd, &ps);
+}
+
+void Present(const HDC hdc, const Framebuffer& framebuffer)
+{
+    const int width = framebuffer.Width();
+    const int height = framebuffer.Height();
 
     // Create a GDI bitmap containing framebuffer data.
     const auto bitmapDC = CreateCompatibleDC(hdc);
@@ -119,6 +150,4 @@ void OnPaint(const HWND hwnd)
     SelectObject(bitmapDC, replacedObject);
     DeleteObject(bitmap);
     DeleteDC(bitmapDC);
-
-    EndPaint(hwnd, &ps);
 }
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "Math/Math.h"
+#include "Raytracer/Raytracer.h"
+
+// Microbenchmarks of the intersection, vector, matrix and shading kernels.
+// Inputs are generated from a seeded random generator, so the runs are repeatable.
+// raytracer-bench-scalar is the same benchmark built with the scalar math backend (MATH_SIMD4_FORCE_SCALAR),
+// runs of both binaries with the same options compare the SIMD kernels with the scalar reference.
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        unsigned int seed = 1;
+        size_t count = 4096;
+        double minTime = 0.25;
+        std::string filter;
+    };
+
+    // Math::Vector and Math::Matrix backend, see Math/Simd4.h.
+    const char* BackendName()
+    {
+        #if defined(MATH_SIMD4_SCALAR)
+        return "scalar";
+        #elif defined(MATH_SIMD4_SSE41)
+        return "SSE4.1";
+        #elif defined(MATH_SIMD4_SSE)
+        return "SSE2";
+        #else
+        return "NEON";
+        #endif
+    }
+
+    // Results are accumulated to the sink, so the compiler can not remove the benchmarked calls.
+    volatile float sink = 0.f;
+
+    class Random
+    {
+    public:
+        explicit Random(const unsigned int seed): generator{seed} {}
+
+        float Uniform(const float min, const float max)
+        {
+            return std::uniform_real_distribution<float>(min, max)(generator);
+        }
+
+        // Random point in the cube.
+        Math::Vector Point(const float extent)
+        {
+            return {Uniform(-extent, extent), Uniform(-extent, extent), Uniform(-extent, extent), 0.f};
+        }
+
+        // Random unit direction.
+        Math::Vector Direction()
+        {
+            Math::Vector v;
+            do
+            {
+                v = Point(1.f);
+            }
+            while (Math::Vector::Length(v) < 0.01f || Math::Vector::Length(v) > 1.f);
+            return Math::Vector::Normalized(v);
+        }
+
+    private:
+        std::mt19937 generator;
+    };
+
+    // Ray from a random point aimed near the target, so both hits and misses are measured.
+    Math::Ray AimedRay(Random& random, const Math::Vector& target, const float spread)
+    {
+        const auto origin = random.Point(10.f);
+        const auto aim = target + random.Point(spread);
+        return Math::Ray(origin, Math::Vector::Normalized(aim - origin));
+    }
+
+    // Benchmark loop. The operation returns true on hit and adds its result to the value.
+    // The inputs are iterated until the minimum time elapses.
+    template <typename Operation>
+    void Run(const Options& options, const char* const name, const bool hits, Operation operation)
+    {
+        if (!options.filter.empty() && std::strstr(name, options.filter.c_str()) == nullptr)
+        {
+            return;
+        }
+
+        float value = 0.f;
+
+        // Warm up the caches.
+        for (size_t i = 0; i < options.count; ++i)
+        {
+            operation(i, value);
+        }
+
+        uint64_t operations = 0;
+        uint64_t hitCount = 0;
+        const auto start = Clock::now();
+        double elapsed = 0.0;
+        do
+        {
+            for (size_t i = 0; i < options.count; ++i)
+            {
+                hitCount += operation(i, value) ? 1 : 0;
+            }
+            operations += options.count;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        while (elapsed < options.minTime);
+
+        sink = sink + value;
+
+        const double ns = elapsed * 1e9 / static_cast<double>(operations);
+        std::printf("%-22s %10.2f %12.2f", name, ns, static_cast<double>(operations) / elapsed / 1e6);
+        if (hits)
+        {
+            std::printf(" %9.1f%%\n", 100.0 * static_cast<double>(hitCount) / static_cast<double>(operations));
+        }
+        else
+        {
+            std::printf(" %10s\n", "-");
+        }
+    }
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: raytracer-bench [options]\n"
+            "  --seed N          Random generator seed (default 1).\n"
+            "  --count N         Number of generated inputs per benchmark (default 4096).\n"
+            "  --time SECONDS    Minimum time per benchmark (default 0.25).\n"
+            "  --filter TEXT     Run only benchmarks containing the text.\n"
+        );
+    }
+
+    bool ParseOptions(const int argc, char** const argv, Options& options)
+    {
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            const std::string name = argv[i];
+            const char* const value = argv[i + 1];
+            if (name == "--seed")
+            {
+                options.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            }
+            else if (name == "--count")
+            {
+                options.count = static_cast<size_t>(std::strtoul(value, nullptr, 10));
+            }
+            else if (name == "--time")
+            {
+                options.minTime = std::atof(value);
+            }
+            else if (name == "--filter")
+            {
+                options.filter = value;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return argc % 2 == 1 && options.count > 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Random random(options.seed);
+    const size_t count = options.count;
+
+    // Intersection inputs.
+    std::vector<Math::Ray> rays;
+    std::vector<Math::Vector> p0(count), p1(count), p2(count);
+    std::vector<Math::Vector> centers(count);
+    std::vector<float> radii(count);
+    std::vector<Math::Plane> planes(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto center = random.Point(5.f);
+        p0[i] = center + random.Point(1.f);
+        p1[i] = center + random.Point(1.f);
+        p2[i] = center + random.Point(1.f);
+        centers[i] = center;
+        radii[i] = random.Uniform(0.2f, 1.f);
+        planes[i] = Math::Plane(center, random.Direction());
+        rays.push_back(AimedRay(random, center, 1.5f));
+    }
+
+    // Vector and matrix inputs.
+    std::vector<Math::Vector> a(count), b(count);
+    std::vector<Math::Matrix> matrices;
+    matrices.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        a[i] = random.Point(100.f);
+        b[i] = random.Point(100.f);
+        matrices.push_back(Math::Matrix::Transformations(random.Point(100.f), {1.f, 1.f, 1.f, 0.f}, random.Point(Math::Pi)));
+    }
+
+    // Shading inputs.
+    Raytracer raytracer;
+    Material material;
+    material.diffuseColor = {0.9f, 0.6f, 0.2f, 1.f};
+    material.specularColor = {1.f, 1.f, 1.f, 1.f};
+    material.specularExp = 200.f;
+    material.specularIntensity = 1.f;
+    std::vector<RaycastSample> samples(count);
+    std::vector<Light> lights(count);
+    std::vector<Math::Vector> cameras(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        samples[i].position = random.Point(100.f);
+        samples[i].normal = random.Direction();
+        lights[i].position = random.Point(300.f);
+        lights[i].color = {1.f, 1.f, 1.f, 0.f};
+        lights[i].radius = random.Uniform(100.f, 600.f);
+        lights[i].intensity = 3.f;
+        lights[i].exp = 4.f;
+        cameras[i] = random.Point(300.f);
+    }
+
+    std::printf("Seed: %u, inputs: %zu, math backend: %s\n", options.seed, count, BackendName());
+    std::printf("%-22s %10s %12s %10s\n", "Benchmark", "ns/op", "Mops/s", "hit rate");
+
+    Run(options, "IntersectTriangle", true, [&](const size_t i, float& value)
+    {
+        const float t = Math::IntersectTriangle(rays[i], p0[i], p1[i], p2[i]);
+        const bool hit = (t != INFINITY);
+        value += hit ? t : 0.f;
+        return hit;
+    });
+
+    Run(options, "IntersectSphere", true, [&](const size_t i, float& value)
+    {
+        const float t = Math::IntersectSphere(rays[i], centers[i], radii[i]);
+        const bool hit = (t != INFINITY);
+        value += hit ? t : 0.f;
+        return hit;
+    });
+
+    Run(options, "IntersectPlane", true, [&](const size_t i, float& value)
+    {
+        const float t = Math::IntersectPlane(rays[i], planes[i]);
+        const bool hit = (t != INFINITY && t >= 0.f);
+        value += hit ? t : 0.f;
+        return hit;
+    });
+
+    Run(options, "Vector::Normalized", false, [&](const size_t i, float& value)
+    {
+        value += Math::Vector::Normalized(a[i]).x;
+        return true;
+    });
+
+    Run(options, "Vector::Cross", false, [&](const size_t i, float& value)
+    {
+        value += Math::Vector::Cross(a[i], b[i]).y;
+        return true;
+    });
+
+    Run(options, "Vector::Dot", false, [&](const size_t i, float& value)
+    {
+        value += a[i] * b[i];
+        return true;
+    });
+
+    Run(options, "Matrix::Transform", false, [&](const size_t i, float& value)
+    {
+        value += matrices[i].Transform(a[i]).z;
+        return true;
+    });
+
+    Run(options, "Raytracer::Shade", true, [&](const size_t i, float& value)
+    {
+        const auto color = raytracer.Shade(samples[i], cameras[i], lights[i], material);
+        const bool lit = (color.x != 0.f || color.y != 0.f || color.z != 0.f);
+        value += color.x;
+        return lit;
+    });
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include "Vector.h"
+
+namespace Math
+{
+    // Axis aligned bounding box. The w components are ignored.
+    class Box
+    {
+    public:
+        Vector min;
+        Vector max;
+
+        // Create an empty box.
+        Box();
+        Box(const Vector& min, const Vector& max);
+
+        // Create a box containing the whole space.
+        static Box Infinite();
+
+        // Union of two boxes.
+        static Box Union(const Box&, const Box&);
+
+        // Grow the box to contain the point or the box.
+        void Extend(const Vector& point);
+        void Extend(const Box& box);
+
+        // Box contains no point.
+        bool Empty() const;
+
+        // All box coordinates are finite numbers.
+        bool Finite() const;
+
+        Vector Center() const;
+        Vector Size() const;
+
+        // Surface area. Empty box has area 0.
+        float SurfaceArea() const;
+    };
+
+    inline Box::Box():
+        min{INFINITY, INFINITY, INFINITY, 0.f},
+        max{-INFINITY, -INFINITY, -INFINITY, 0.f}
+    {}
+
+    inline Box::Box(const Vector& min_, const Vector& max_):
+        min{min_},
+        max{max_}
+    {}
+
+    inline Box Box::Infinite()
+    {
+        return Box({-INFINITY, -INFINITY, -INFINITY, 0.f}, {INFINITY, INFINITY, INFINITY, 0.f});
+    }
+
+    inline Box Box::Union(const Box& a, const Box& b)
+    {
+        Box box = a;
+        box.Extend(b);
+        return box;
+    }
+
+    inline void Box::Extend(const Vector& point)
+    {
+        min.Set(std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z), 0.f);
+        max.Set(std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z), 0.f);
+    }
+
+    inline void Box::Extend(const Box& box)
+    {
+        min.Set(std::min(min.x, box.min.x), std::min(min.y, box.min.y), std::min(min.z, box.min.z), 0.f);
+        max.Set(std::max(max.x, box.max.x), std::max(max.y, box.max.y), std::max(max.z, box.max.z), 0.f);
+    }
+
+    inline bool Box::Empty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    inline bool Box::Finite() const
+    {
+        return
+            std::isfinite(min.x) && std::isfinite(min.y) && std::isfinite(min.z) &&
+            std::isfinite(max.x) && std::isfinite(max.y) && std::isfinite(max.z);
+    }
+
+    inline Vector Box::Center() const
+    {
+        return {(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f, 0.f};
+    }
+
+    inline Vector Box::Size() const
+    {
+        return {max.x - min.x, max.y - min.y, max.z - min.z, 0.f};
+    }
+
+    inline float Box::SurfaceArea() const
+    {
+        if (Empty())
+        {
+            return 0.f;
+        }
+        const Vector size = Size();
+        return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+}
@@ -18,6 +18,7 @@ namespace Math
 #include "Matrix.h"
 #include "Ray.h"
 #include "Plane.h"
+#include "Box.h"
 
 namespace Math
 {
@@ -71,7 +72,29 @@ namespace Math
         {
             return INFINITY;
         }
-        return -(plane * Math::Vector(ray.origin.x, ray.origin.y, ray.origin.z, 1.f)) / r;
+        // Dot product with the origin point (w = 1) in the order of Vector::operator*. A Vector built from the
+        // scalar origin components would be loaded right after its narrow stores, which stalls the store forwarding.
+        return -(((plane.x * ray.origin.x + plane.y * ray.origin.y) + plane.z * ray.origin.z) + plane.w) / r;
+    }
+
+    // Distance to the box entry point, 0 if the ray origin is inside the box, INFINITY if missed.
+    // The inverseDirection argument is the component-wise reciprocal of the ray direction.
+    inline float IntersectBox(const Ray& ray, const Vector& inverseDirection, const Box& box)
+    {
+        const float tx0 = (box.min.x - ray.origin.x) * inverseDirection.x;
+        const float tx1 = (box.max.x - ray.origin.x) * inverseDirection.x;
+        const float ty0 = (box.min.y - ray.origin.y) * inverseDirection.y;
+        const float ty1 = (box.max.y - ray.origin.y) * inverseDirection.y;
+        const float tz0 = (box.min.z - ray.origin.z) * inverseDirection.z;
+        const float tz1 = (box.max.z - ray.origin.z) * inverseDirection.z;
+
+        const float tmin = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.f));
+        const float tmax = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::max(tz0, tz1));
+        if (tmin > tmax)
+        {
+            return INFINITY;
+        }
+        return tmin;
     }
 
     float IntersectTriangle(const Ray& ray, const Vector& p0, const Vector& p1, const Vector& p2);
@@ -2,109 +2,89 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 
-// DirectX Math implementation helpers.
-#ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
+#include "Simd4.h"
 
-#include "Libs\DirectXMath\Inc\DirectXMath.h"
-
-inline DirectX::XMMATRIX LoadXmMatrix(const Math::Matrix& m)
-{
-    return DirectX::XMLoadFloat4x4A(reinterpret_cast<const DirectX::XMFLOAT4X4A*>(&m));
-}
-
-inline void StoreXmMatrix(const DirectX::XMMATRIX& m, Math::Matrix* const o)
-{
-    DirectX::XMStoreFloat4x4A(reinterpret_cast<DirectX::XMFLOAT4X4A*>(o), m);
-}
-
-inline DirectX::XMVECTOR LoadXmVector(const Math::Vector& v)
-{
-    return DirectX::XMLoadFloat4A(reinterpret_cast<const DirectX::XMFLOAT4A*>(&v));
-}
-
-inline Math::Vector CreateVector(const DirectX::XMVECTOR& v)
-{
-    Math::Vector result;
-    DirectX::XMStoreFloat4A(reinterpret_cast<DirectX::XMFLOAT4A*>(&result), v);
-    return result;
-}
-
-#endif // COMPILE_MATH_MATRIX_DIRECTX_MATH
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 
 namespace Math
 {
-    inline void Matrix::Transpose(const Matrix& m, Matrix* const o)
+    namespace MatrixDetail
     {
-        #ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
+        // 2x2 matrices are stored in one register as | x y |
+        //                                             | z w |.
 
-        DirectX::XMMATRIX xm = LoadXmMatrix(m);
-        xm = DirectX::XMMatrixTranspose(xm);
-        StoreXmMatrix(xm, o);
+        // a * b
+        inline Simd4::Float4 Mul2(const Simd4::Float4 a, const Simd4::Float4 b)
+        {
+            return Simd4::Add(Simd4::Mul(a, Simd4::Swizzle<0, 3, 0, 3>(b)), Simd4::Mul(Simd4::Swizzle<1, 0, 3, 2>(a), Simd4::Swizzle<2, 1, 2, 1>(b)));
+        }
 
-        #else
+        // adjugate(a) * b
+        inline Simd4::Float4 AdjugateMul2(const Simd4::Float4 a, const Simd4::Float4 b)
+        {
+            return Simd4::Sub(Simd4::Mul(Simd4::Swizzle<3, 3, 0, 0>(a), b), Simd4::Mul(Simd4::Swizzle<1, 1, 2, 2>(a), Simd4::Swizzle<2, 3, 0, 1>(b)));
+        }
 
-        o->m[0][0] = m.m[0][0]; o->m[0][1] = m.m[1][0]; o->m[0][2] = m.m[2][0]; o->m[0][3] = m.m[3][0];
-        o->m[1][0] = m.m[0][1]; o->m[1][1] = m.m[1][1]; o->m[1][2] = m.m[2][1]; o->m[1][3] = m.m[3][1];
-        o->m[2][0] = m.m[0][2]; o->m[2][1] = m.m[1][2]; o->m[2][2] = m.m[2][2]; o->m[2][3] = m.m[3][2];
-        o->m[3][0] = m.m[0][3]; o->m[3][1] = m.m[1][3]; o->m[3][2] = m.m[2][3]; o->m[3][3] = m.m[3][3];
+        // a * adjugate(b)
+        inline Simd4::Float4 MulAdjugate2(const Simd4::Float4 a, const Simd4::Float4 b)
+        {
+            return Simd4::Sub(Simd4::Mul(a, Simd4::Swizzle<3, 0, 3, 0>(b)), Simd4::Mul(Simd4::Swizzle<1, 0, 3, 2>(a), Simd4::Swizzle<2, 1, 2, 1>(b)));
+        }
+    }
 
-        #endif
+    inline void Matrix::Transpose(const Matrix& m, Matrix* const o)
+    {
+        Simd4::Float4 r0 = Simd4::Load(m.m[0]);
+        Simd4::Float4 r1 = Simd4::Load(m.m[1]);
+        Simd4::Float4 r2 = Simd4::Load(m.m[2]);
+        Simd4::Float4 r3 = Simd4::Load(m.m[3]);
+        Simd4::Transpose(r0, r1, r2, r3);
+        Simd4::Store(o->m[0], r0);
+        Simd4::Store(o->m[1], r1);
+        Simd4::Store(o->m[2], r2);
+        Simd4::Store(o->m[3], r3);
     }
 
     inline bool Matrix::Invert(const Matrix& m, Matrix& o)
     {
-        #ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
+        // Block inverse of | A B |
+        //                  | C D | with the 2x2 sub-matrices.
+        using namespace Simd4;
+        const Float4 r0 = Load(m.m[0]);
+        const Float4 r1 = Load(m.m[1]);
+        const Float4 r2 = Load(m.m[2]);
+        const Float4 r3 = Load(m.m[3]);
+        const Float4 a = Shuffle<0, 1, 0, 1>(r0, r1);
+        const Float4 b = Shuffle<2, 3, 2, 3>(r0, r1);
+        const Float4 c = Shuffle<0, 1, 0, 1>(r2, r3);
+        const Float4 d = Shuffle<2, 3, 2, 3>(r2, r3);
+
+        // Determinants of the sub-matrices (|A|, |B|, |C|, |D|).
+        const Float4 dets = Sub(
+            Mul(Shuffle<0, 2, 0, 2>(r0, r2), Shuffle<1, 3, 1, 3>(r1, r3)),
+            Mul(Shuffle<1, 3, 1, 3>(r0, r2), Shuffle<0, 2, 0, 2>(r1, r3))
+        );
+        const Float4 detA = Swizzle<0, 0, 0, 0>(dets);
+        const Float4 detB = Swizzle<1, 1, 1, 1>(dets);
+        const Float4 detC = Swizzle<2, 2, 2, 2>(dets);
+        const Float4 detD = Swizzle<3, 3, 3, 3>(dets);
 
-        DirectX::XMMATRIX xm = LoadXmMatrix(m);
-        xm = DirectX::XMMatrixInverse(nullptr, xm);
-        if (DirectX::XMMatrixIsNaN(xm))
-        {
-            return false;
-        }
-        StoreXmMatrix(xm, &o);
-        return true;
+        const Float4 adjDC = MatrixDetail::AdjugateMul2(d, c);
+        const Float4 adjAB = MatrixDetail::AdjugateMul2(a, b);
 
-        #else
+        // Adjugates of the inverse blocks, scaled by the determinant.
+        Float4 x = Sub(Mul(detD, a), MatrixDetail::Mul2(b, adjDC));
+        Float4 w = Sub(Mul(detA, d), MatrixDetail::Mul2(c, adjAB));
+        Float4 y = Sub(Mul(detB, c), MatrixDetail::MulAdjugate2(d, adjAB));
+        Float4 z = Sub(Mul(detC, b), MatrixDetail::MulAdjugate2(a, adjDC));
 
-        // Precomputationed values.
-        const float t00 = m.m[2][2] * m.m[3][3] - m.m[2][3] * m.m[3][2];
-        const float t01 = m.m[2][3] * m.m[3][0] - m.m[2][0] * m.m[3][3];
-        const float t02 = m.m[2][1] * m.m[3][2] - m.m[2][2] * m.m[3][1];
-        const float t03 = m.m[2][3] * m.m[3][1] - m.m[2][1] * m.m[3][3];
-        const float t04 = m.m[2][0] * m.m[3][1] - m.m[2][1] * m.m[3][0];
-        const float t05 = m.m[2][0] * m.m[3][2] - m.m[2][2] * m.m[3][0];
-        const float t06 = m.m[2][1] * m.m[3][3] - m.m[2][3] * m.m[3][1];
-        const float t07 = m.m[2][2] * m.m[3][0] - m.m[2][0] * m.m[3][2];
-        const float t08 = m.m[1][2] * m.m[3][3] - m.m[1][3] * m.m[3][2];
-        const float t09 = m.m[1][1] * m.m[3][2] - m.m[1][2] * m.m[3][1];
-        const float t10 = m.m[1][0] * m.m[3][1] - m.m[1][1] * m.m[3][0];
-        const float t11 = m.m[1][2] * m.m[2][3] - m.m[1][3] * m.m[2][2];
-        const float t12 = m.m[1][1] * m.m[2][2] - m.m[1][2] * m.m[2][1];
-        const float t13 = m.m[1][3] * m.m[2][0] - m.m[1][0] * m.m[2][3];
-        const float t14 = m.m[1][0] * m.m[2][1] - m.m[1][1] * m.m[2][0];
-        const float t15 = m.m[1][3] * m.m[3][0] - m.m[1][0] * m.m[3][3];
-
-        // Minors.
-        float det00 = m.m[1][1] * t00 + m.m[1][2] * t03 + m.m[1][3] * t02;
-        float det01 = m.m[1][0] * t00 + m.m[1][2] * t01 + m.m[1][3] * t05;
-        float det02 = m.m[1][0] * t06 + m.m[1][1] * t01 + m.m[1][3] * t04;
-        float det03 = m.m[1][0] * t02 + m.m[1][1] * t07 + m.m[1][2] * t04;
-        float det10 = m.m[0][1] * t00 + m.m[0][2] * t03 + m.m[0][3] * t02;
-        float det11 = m.m[0][0] * t00 + m.m[0][2] * t01 + m.m[0][3] * t05;
-        float det12 = m.m[0][0] * t06 + m.m[0][1] * t01 + m.m[0][3] * t04;
-        float det13 = m.m[0][0] * t02 + m.m[0][1] * t07 + m.m[0][2] * t04;
-        float det20 = m.m[0][1] * t08 + m.m[0][3] * t09 + m.m[0][2] * (m.m[1][3] * m.m[3][1] - m.m[1][1] * m.m[3][3]);
-        float det21 = m.m[0][0] * t08 + m.m[0][2] * t15 + m.m[0][3] * (m.m[1][0] * m.m[3][2] - m.m[1][2] * m.m[3][0]);
-        float det22 = m.m[0][1] * t15 + m.m[0][3] * t10 + m.m[0][0] * (m.m[1][1] * m.m[3][3] - m.m[1][3] * m.m[3][1]);
-        float det23 = m.m[0][0] * t09 + m.m[0][2] * t10 + m.m[0][1] * (m.m[1][2] * m.m[3][0] - m.m[1][0] * m.m[3][2]);
-        float det30 = m.m[0][1] * t11 + m.m[0][3] * t12 + m.m[0][2] * (m.m[1][3] * m.m[2][1] - m.m[1][1] * m.m[2][3]);
-        float det31 = m.m[0][0] * t11 + m.m[0][2] * t13 + m.m[0][3] * (m.m[1][0] * m.m[2][2] - m.m[1][2] * m.m[2][0]);
-        float det32 = m.m[0][1] * t13 + m.m[0][3] * t14 + m.m[0][0] * (m.m[1][1] * m.m[2][3] - m.m[1][3] * m.m[2][1]);
-        float det33 = m.m[0][0] * t12 + m.m[0][2] * t14 + m.m[0][1] * (m.m[1][2] * m.m[2][0] - m.m[1][0] * m.m[2][2]);
-
-        // The matrix determinant.
-        float det = m.m[0][0] * det00 - m.m[1][0] * det10 + m.m[2][0] * det20 - m.m[3][0] * det30;
+        // |M| = |A| |D| + |B| |C| - tr(adj(A) B adj(D) C).
+        const float trace = Sum(Mul(adjAB, Swizzle<0, 2, 1, 3>(adjDC)));
+        const float det = First(Sub(Add(Mul(detA, detD), Mul(detB, detC)), Splat(trace)));
 
         // The matrix is singular (not invertible).
         if (det == 0.0f)
@@ -112,72 +92,41 @@ namespace Math
             return false;
         }
 
-        // Set inverse entries.
-        o.m[0][0] = det00 / det;
-        o.m[0][1] = -det10 / det;
-        o.m[0][2] = det20 / det;
-        o.m[0][3] = -det30 / det;
-        o.m[1][0] = -det01 / det;
-        o.m[1][1] = det11 / det;
-        o.m[1][2] = -det21 / det;
-        o.m[1][3] = det31 / det;
-        o.m[2][0] = det02 / det;
-        o.m[2][1] = -det12 / det;
-        o.m[2][2] = det22 / det;
-        o.m[2][3] = -det32 / det;
-        o.m[3][0] = -det03 / det;
-        o.m[3][1] = det13 / det;
-        o.m[3][2] = -det23 / det;
-        o.m[3][3] = det33 / det;
-
+        // The adjugate signs of the blocks.
+        const Float4 scale = Div(Set(1.0f, -1.0f, -1.0f, 1.0f), Splat(det));
+        x = Mul(x, scale);
+        y = Mul(y, scale);
+        z = Mul(z, scale);
+        w = Mul(w, scale);
+
+        Store(o.m[0], Shuffle<3, 1, 3, 1>(x, y));
+        Store(o.m[1], Shuffle<2, 0, 2, 0>(x, y));
+        Store(o.m[2], Shuffle<3, 1, 3, 1>(z, w));
+        Store(o.m[3], Shuffle<2, 0, 2, 0>(z, w));
         return true;
-
-        #endif
     }
 
     // Matrix * column-major vector (vector transformation).
     inline Vector operator*(const Matrix& l, const Vector& r)
     {
-        #ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
-
-        DirectX::XMMATRIX xm = LoadXmMatrix(l);
-        xm = DirectX::XMMatrixTranspose(xm);
-        DirectX::XMVECTOR xv1 = LoadXmVector(r);
-        DirectX::XMVECTOR xv2 = DirectX::XMVector4Transform(xv1, xm);
-        return CreateVector(xv2);
-
-        #else
-
-        return Vector(
-            l.m[0][0] * r.x + l.m[0][1] * r.y + l.m[0][2] * r.z + l.m[0][3] * r.w,
-            l.m[1][0] * r.x + l.m[1][1] * r.y + l.m[1][2] * r.z + l.m[1][3] * r.w,
-            l.m[2][0] * r.x + l.m[2][1] * r.y + l.m[2][2] * r.z + l.m[2][3] * r.w,
-            l.m[3][0] * r.x + l.m[3][1] * r.y + l.m[3][2] * r.z + l.m[3][3] * r.w
-        );
-
-        #endif
+        // Products of the rows are transposed, so each lane sums one row from left to right.
+        const Simd4::Float4 v = Simd4::Load(&r.x);
+        Simd4::Float4 p0 = Simd4::Mul(Simd4::Load(l.m[0]), v);
+        Simd4::Float4 p1 = Simd4::Mul(Simd4::Load(l.m[1]), v);
+        Simd4::Float4 p2 = Simd4::Mul(Simd4::Load(l.m[2]), v);
+        Simd4::Float4 p3 = Simd4::Mul(Simd4::Load(l.m[3]), v);
+        Simd4::Transpose(p0, p1, p2, p3);
+        return VectorDetail::Store(Simd4::Add(Simd4::Add(Simd4::Add(p0, p1), p2), p3));
     }
 
     // Row-major vector * matrix (vector transformation).
     inline Vector operator*(const Vector& l, const Matrix& r)
     {
-        #ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
-
-        DirectX::XMMATRIX xm = LoadXmMatrix(r);
-        DirectX::XMVECTOR xv1 = LoadXmVector(l);
-        DirectX::XMVECTOR xv2 = DirectX::XMVector4Transform(xv1, xm);
-        return CreateVector(xv2);
-
-        #else
-
-        return Vector(
-            l.x * r.m[0][0] + l.y * r.m[1][0] + l.z * r.m[2][0] + l.w * r.m[3][0],
-            l.x * r.m[0][1] + l.y * r.m[1][1] + l.z * r.m[2][1] + l.w * r.m[3][1],
-            l.x * r.m[0][2] + l.y * r.m[1][2] + l.z * r.m[2][2] + l.w * r.m[3][2],
-            l.x * r.m[0][3] + l.y * r.m[1][3] + l.z * r.m[2][3] + l.w * r.m[3][3]
-        );
-
-        #endif
+        Simd4::Float4 result = Simd4::Mul(Simd4::Splat(l.x), Simd4::Load(r.m[0]));
+        result = Simd4::Add(result, Simd4::Mul(Simd4::Splat(l.y), Simd4::Load(r.m[1])));
+        result = Simd4::Add(result, Simd4::Mul(Simd4::Splat(l.z), Simd4::Load(r.m[2])));
+        result = Simd4::Add(result, Simd4::Mul(Simd4::Splat(l.w), Simd4::Load(r.m[3])));
+        return VectorDetail::Store(result);
     }
 
     inline Matrix Matrix::Identity()
@@ -212,7 +161,7 @@ namespace Math
 
     inline void Matrix::StoreColumnMajor(void* const raw)
     {
-        Transpose(*this, reinterpret_cast<Matrix* const>(raw));
+        Transpose(*this, reinterpret_cast<Matrix*>(raw));
     }
 
     inline void Matrix::StoreRowMajor(void* const raw)
@@ -223,28 +172,13 @@ namespace Math
     inline Matrix Matrix::Zero()
     {
         Matrix m;
-        memset(&m, 0, sizeof(m));
+        memset(m.m, 0, sizeof(m.m));
         return m;
     }
 
     inline void Matrix::Transpose()
     {
-        #ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
-
-        DirectX::XMMATRIX xm = LoadXmMatrix(*this);
-        xm = DirectX::XMMatrixTranspose(xm);
-        StoreXmMatrix(xm, this);
-
-        #else
-
-        std::swap(m[1][0], m[0][1]);
-        std::swap(m[2][0], m[0][2]);
-        std::swap(m[3][0], m[0][3]);
-        std::swap(m[2][1], m[1][2]);
-        std::swap(m[3][1], m[1][3]);
-        std::swap(m[3][2], m[2][3]);
-
-        #endif
+        Transpose(*this, this);
     }
 
     inline bool Matrix::operator==(const Matrix& r) const
@@ -259,31 +193,40 @@ namespace Math
 
     inline Matrix Matrix::operator*(const Matrix& r) const
     {
-        #ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
+        // The rows are accumulated from zero in the order of the scalar dot products.
+        Matrix result;
 
-        const DirectX::XMMATRIX xm = DirectX::XMMatrixMultiply(LoadXmMatrix(*this), LoadXmMatrix(r));
-        Matrix m;
-        StoreXmMatrix(xm, &m);
-        return m;
+        #if defined(__AVX__)
 
-        #else
+        // Two rows per register.
+        for (int row = 0; row < 4; row += 2)
+        {
+            __m256 sum = _mm256_setzero_ps();
+            for (int i = 0; i < 4; ++i)
+            {
+                const __m256 a = _mm256_set_m128(_mm_set1_ps(m[row + 1][i]), _mm_set1_ps(m[row][i]));
+                const __m256 b = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(r.m[i]));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(a, b));
+            }
+            // The matrix is only 16-byte aligned.
+            _mm256_storeu_ps(result.m[row], sum);
+        }
 
-        Matrix result = Matrix::Zero();
+        #else
 
         for (int row = 0; row < 4; ++row)
         {
-            for (int col = 0; col < 4; ++col)
+            Simd4::Float4 sum = Simd4::Splat(0.0f);
+            for (int i = 0; i < 4; ++i)
             {
-                for (int i = 0; i < 4; ++i)
-                {
-                    result.m[row][col] += m[row][i] * r.m[i][col];
-                }
+                sum = Simd4::Add(sum, Simd4::Mul(Simd4::Splat(m[row][i]), Simd4::Load(r.m[i])));
             }
+            Simd4::Store(result.m[row], sum);
         }
 
-        return result;
-
         #endif
+
+        return result;
     }
 
     inline void Matrix::SwapRows(const int r1, const int r2)
@@ -317,14 +260,6 @@ namespace Math
 
     inline float Matrix::Determinant() const
     {
-        #ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
-
-        const DirectX::XMMATRIX xm = LoadXmMatrix(*this);
-        const DirectX::XMVECTOR xv = DirectX::XMMatrixDeterminant(xm);
-        return DirectX::XMVectorGetX(xv);
-
-        #else
-
         const float t0 = m[2][2] * m[3][3] - m[2][3] * m[3][2];
         const float t1 = m[2][3] * m[3][1] - m[2][1] * m[3][3];
         const float t2 = m[2][1] * m[3][2] - m[2][2] * m[3][1];
@@ -354,8 +289,6 @@ namespace Math
         };
 
         return m[0][0] * det00 - m[1][0] * det10 + m[2][0] * det20 - m[3][0] * det30;
-
-        #endif
     }
 
     inline Vector Matrix::Transform(const Vector& v) const
@@ -441,8 +374,8 @@ namespace Math
 
     inline Matrix Matrix::RotationX(const float rad)
     {
-        const float sin = std::sinf(rad);
-        const float cos = std::cosf(rad);
+        const float sin = std::sin(rad);
+        const float cos = std::cos(rad);
         Matrix m;
         m.m[0][0] = 1.0f; m.m[0][1] = 0.0f; m.m[0][2] = 0.0f; m.m[0][3] = 0.0f;
         m.m[1][0] = 0.0f; m.m[1][1] = cos;  m.m[1][2] = -sin; m.m[1][3] = 0.0f;
@@ -453,8 +386,8 @@ namespace Math
 
     inline Matrix Matrix::RotationY(const float rad)
     {
-        const float sin = std::sinf(rad);
-        const float cos = std::cosf(rad);
+        const float sin = std::sin(rad);
+        const float cos = std::cos(rad);
         Matrix m;
         m.m[0][0] = cos;  m.m[0][1] = 0.0f; m.m[0][2] = sin;  m.m[0][3] = 0.0f;
         m.m[1][0] = 0.0f; m.m[1][1] = 1.0f; m.m[1][2] = 0.0f; m.m[1][3] = 0.0f;
@@ -465,8 +398,8 @@ namespace Math
 
     inline Matrix Matrix::RotationZ(const float rad)
     {
-        const float sin = std::sinf(rad);
-        const float cos = std::cosf(rad);
+        const float sin = std::sin(rad);
+        const float cos = std::cos(rad);
         Matrix m;
         m.m[0][0] = cos;  m.m[0][1] = -sin; m.m[0][2] = 0.0f; m.m[0][3] = 0.0f;
         m.m[1][0] = sin;  m.m[1][1] = cos;  m.m[1][2] = 0.0f; m.m[1][3] = 0.0f;
@@ -477,12 +410,12 @@ namespace Math
 
     inline Matrix Matrix::Rotation(const float x, const float y, const float z)
     {
-        const float sx = std::sinf(x);
-        const float cx = std::cosf(x);
-        const float sy = std::sinf(y);
-        const float cy = std::cosf(y);
-        const float sz = std::sinf(z);
-        const float cz = std::cosf(z);
+        const float sx = std::sin(x);
+        const float cx = std::cos(x);
+        const float sy = std::sin(y);
+        const float cy = std::cos(y);
+        const float sz = std::sin(z);
+        const float cz = std::cos(z);
 
         Matrix m;
         m.m[0][0] = sx * sy * sz + cy * cz;
@@ -511,18 +444,8 @@ namespace Math
 
     inline Matrix Matrix::RotationAxis(const Vector& v, const float rad)
     {
-        #ifdef COMPILE_MATH_MATRIX_DIRECTX_MATH
-
-        DirectX::XMVECTOR xv = LoadXmVector(v);
-        DirectX::XMMATRIX xm = DirectX::XMMatrixRotationNormal(xv, -rad);
-        Matrix m;
-        StoreXmMatrix(xm, &m);
-        return m;
-
-        #else
-
-        const float sin = std::sinf(rad);
-        const float cos = std::cosf(rad);
+        const float sin = std::sin(rad);
+        const float cos = std::cos(rad);
         const float ncos = 1.0f - cos;
 
         Matrix m;
@@ -543,8 +466,6 @@ namespace Math
         m.m[3][2] = 0.0f;
         m.m[3][3] = 1.0f;
         return m;
-
-        #endif
     }
     
     inline Matrix Matrix::Scale(const float x, const float y, const float z)
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cmath>
+#include "Simd4.h"
+
+// SIMD lanes used by the ray packets.
+// AVX2 uses 8 lanes, SSE2 uses 4 lanes, other targets emulate 4 lanes with scalar code.
+// All operations are IEEE single precision operations with the same rounding as the scalar code.
+
+#if defined(__AVX2__)
+    #define MATH_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MATH_SIMD_SSE
+#else
+    #define MATH_SIMD_SCALAR
+#endif
+
+#if defined(MATH_SIMD_AVX2)
+    #include <immintrin.h>
+#elif defined(MATH_SIMD_SSE)
+    #include <emmintrin.h>
+#endif
+
+namespace Math
+{
+namespace Simd
+{
+    #if defined(MATH_SIMD_AVX2)
+
+    const int Width = 8;
+    const bool Native = true;
+
+    using Float = __m256;
+
+    inline Float Splat(const float value) { return _mm256_set1_ps(value); }
+    // Unaligned loads and stores, the heap and Math types guarantee only 16-byte alignment.
+    inline Float Load(const float* const data) { return _mm256_loadu_ps(data); }
+    inline void Store(float* const data, const Float a) { _mm256_storeu_ps(data, a); }
+
+    inline Float Add(const Float a, const Float b) { return _mm256_add_ps(a, b); }
+    inline Float Sub(const Float a, const Float b) { return _mm256_sub_ps(a, b); }
+    inline Float Mul(const Float a, const Float b) { return _mm256_mul_ps(a, b); }
+    inline Float Div(const Float a, const Float b) { return _mm256_div_ps(a, b); }
+    inline Float Negate(const Float a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.f)); }
+    inline Float Sqrt(const Float a) { return _mm256_sqrt_ps(a); }
+    inline Float Min(const Float a, const Float b) { return _mm256_min_ps(a, b); }
+    inline Float Max(const Float a, const Float b) { return _mm256_max_ps(a, b); }
+
+    // Comparisons return lane masks, comparisons with NaN are false like in the scalar code.
+    inline Float Less(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    inline Float LessEqual(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    inline Float Greater(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline Float GreaterEqual(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    inline Float Equal(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    inline Float NotEqual(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+
+    inline Float And(const Float a, const Float b) { return _mm256_and_ps(a, b); }
+    inline Float Or(const Float a, const Float b) { return _mm256_or_ps(a, b); }
+    inline Float AndNot(const Float mask, const Float a) { return _mm256_andnot_ps(mask, a); }
+
+    // Lanes from a where the mask is set, otherwise from b.
+    inline Float Select(const Float mask, const Float a, const Float b) { return _mm256_blendv_ps(b, a, mask); }
+
+    // Bit i is set if the lane i of the mask is set.
+    inline int Bits(const Float mask) { return _mm256_movemask_ps(mask); }
+
+    #elif defined(MATH_SIMD_SSE)
+
+    const int Width = 4;
+    const bool Native = true;
+
+    using Float = __m128;
+
+    inline Float Splat(const float value) { return _mm_set1_ps(value); }
+    inline Float Load(const float* const data) { return _mm_load_ps(data); }
+    inline void Store(float* const data, const Float a) { _mm_store_ps(data, a); }
+
+    inline Float Add(const Float a, const Float b) { return _mm_add_ps(a, b); }
+    inline Float Sub(const Float a, const Float b) { return _mm_sub_ps(a, b); }
+    inline Float Mul(const Float a, const Float b) { return _mm_mul_ps(a, b); }
+    inline Float Div(const Float a, const Float b) { return _mm_div_ps(a, b); }
+    inline Float Negate(const Float a) { return _mm_xor_ps(a, _mm_set1_ps(-0.f)); }
+    inline Float Sqrt(const Float a) { return _mm_sqrt_ps(a); }
+    inline Float Min(const Float a, const Float b) { return _mm_min_ps(a, b); }
+    inline Float Max(const Float a, const Float b) { return _mm_max_ps(a, b); }
+
+    // Comparisons return lane masks, comparisons with NaN are false like in the scalar code.
+    inline Float Less(const Float a, const Float b) { return _mm_cmplt_ps(a, b); }
+    inline Float LessEqual(const Float a, const Float b) { return _mm_cmple_ps(a, b); }
+    inline Float Greater(const Float a, const Float b) { return _mm_cmpgt_ps(a, b); }
+    inline Float GreaterEqual(const Float a, const Float b) { return _mm_cmpge_ps(a, b); }
+    inline Float Equal(const Float a, const Float b) { return _mm_cmpeq_ps(a, b); }
+    inline Float NotEqual(const Float a, const Float b) { return _mm_cmpneq_ps(a, b); }
+
+    inline Float And(const Float a, const Float b) { return _mm_and_ps(a, b); }
+    inline Float Or(const Float a, const Float b) { return _mm_or_ps(a, b); }
+    inline Float AndNot(const Float mask, const Float a) { return _mm_andnot_ps(mask, a); }
+
+    // Lanes from a where the mask is set, otherwise from b.
+    inline Float Select(const Float mask, const Float a, const Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+    // Bit i is set if the lane i of the mask is set.
+    inline int Bits(const Float mask) { return _mm_movemask_ps(mask); }
+
+    #else
+
+    const int Width = 4;
+    const bool Native = false;
+
+    // Emulated lanes. Masks store 1.f for set lanes and 0.f otherwise.
+    struct Float
+    {
+        float v[Width];
+    };
+
+    template <typename Op>
+    inline Float Apply(const Float a, const Float b, Op op)
+    {
+        Float r;
+        for (int i = 0; i < Width; ++i)
+        {
+            r.v[i] = op(a.v[i], b.v[i]);
+        }
+        return r;
+    }
+
+    inline Float Splat(const float value) { return {{value, value, value, value}}; }
+    inline Float Load(const float* const data) { return {{data[0], data[1], data[2], data[3]}}; }
+    inline void Store(float* const data, const Float a) { for (int i = 0; i < Width; ++i) { data[i] = a.v[i]; } }
+
+    inline Float Add(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x + y; }); }
+    inline Float Sub(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x - y; }); }
+    inline Float Mul(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x * y; }); }
+    inline Float Div(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x / y; }); }
+    inline Float Negate(const Float a) { return Apply(a, a, [](float x, float) { return -x; }); }
+    inline Float Sqrt(const Float a) { return Apply(a, a, [](float x, float) { return sqrtf(x); }); }
+    inline Float Min(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    inline Float Max(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+    inline Float Less(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x < y ? 1.f : 0.f; }); }
+    inline Float LessEqual(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x <= y ? 1.f : 0.f; }); }
+    inline Float Greater(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x > y ? 1.f : 0.f; }); }
+    inline Float GreaterEqual(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x >= y ? 1.f : 0.f; }); }
+    inline Float Equal(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x == y ? 1.f : 0.f; }); }
+    inline Float NotEqual(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return x != y ? 1.f : 0.f; }); }
+
+    inline Float And(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return (x != 0.f && y != 0.f) ? 1.f : 0.f; }); }
+    inline Float Or(const Float a, const Float b) { return Apply(a, b, [](float x, float y) { return (x != 0.f || y != 0.f) ? 1.f : 0.f; }); }
+    inline Float AndNot(const Float mask, const Float a) { return Apply(mask, a, [](float x, float y) { return (x == 0.f && y != 0.f) ? 1.f : 0.f; }); }
+
+    // Lanes from a where the mask is set, otherwise from b.
+    inline Float Select(const Float mask, const Float a, const Float b)
+    {
+        Float r;
+        for (int i = 0; i < Width; ++i)
+        {
+            r.v[i] = mask.v[i] != 0.f ? a.v[i] : b.v[i];
+        }
+        return r;
+    }
+
+    // Bit i is set if the lane i of the mask is set.
+    inline int Bits(const Float mask)
+    {
+        int bits = 0;
+        for (int i = 0; i < Width; ++i)
+        {
+            bits |= (mask.v[i] != 0.f ? 1 : 0) << i;
+        }
+        return bits;
+    }
+
+    #endif
+
+    // Any lane of the mask is set.
+    inline bool Any(const Float mask) { return Bits(mask) != 0; }
+
+    // Number of the set lanes.
+    inline int Count(const Float mask)
+    {
+        int count = 0;
+        for (int bits = Bits(mask); bits != 0; bits &= bits - 1)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    // Component-wise 4D dot product summed left to right like Math::Vector::operator*.
+    inline Float Dot(const Float ax, const Float ay, const Float az, const Float aw, const Float bx, const Float by, const Float bz, const Float bw)
+    {
+        return Add(Add(Add(Mul(ax, bx), Mul(ay, by)), Mul(az, bz)), Mul(aw, bw));
+    }
+}
+}
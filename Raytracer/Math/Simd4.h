@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// 4-lane SIMD operations used by Math::Vector and Math::Matrix.
+// SSE2/SSE4.1 on x86, NEON on AArch64, scalar code on other targets or with MATH_SIMD4_FORCE_SCALAR.
+// Dot products are summed left to right, so all backends give the same results as the scalar code.
+
+#if defined(MATH_SIMD4_FORCE_SCALAR)
+    #define MATH_SIMD4_SCALAR
+#elif defined(__SSE4_1__) || defined(__AVX__)
+    #define MATH_SIMD4_SSE
+    #define MATH_SIMD4_SSE41
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MATH_SIMD4_SSE
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define MATH_SIMD4_NEON
+#else
+    #define MATH_SIMD4_SCALAR
+#endif
+
+#if defined(MATH_SIMD4_SSE41)
+    #include <smmintrin.h>
+#elif defined(MATH_SIMD4_SSE)
+    #include <emmintrin.h>
+#elif defined(MATH_SIMD4_NEON)
+    #include <arm_neon.h>
+#endif
+
+namespace Math
+{
+namespace Simd4
+{
+    #if defined(MATH_SIMD4_SSE)
+
+    using Float4 = __m128;
+
+    // Load and store 16-byte aligned data.
+    inline Float4 Load(const float* const data) { return _mm_load_ps(data); }
+    inline void Store(float* const data, const Float4 a) { _mm_store_ps(data, a); }
+
+    inline Float4 Set(const float x, const float y, const float z, const float w) { return _mm_setr_ps(x, y, z, w); }
+    inline Float4 Splat(const float value) { return _mm_set1_ps(value); }
+
+    inline Float4 Add(const Float4 a, const Float4 b) { return _mm_add_ps(a, b); }
+    inline Float4 Sub(const Float4 a, const Float4 b) { return _mm_sub_ps(a, b); }
+    inline Float4 Mul(const Float4 a, const Float4 b) { return _mm_mul_ps(a, b); }
+    inline Float4 Div(const Float4 a, const Float4 b) { return _mm_div_ps(a, b); }
+    inline Float4 Negate(const Float4 a) { return _mm_xor_ps(a, _mm_set1_ps(-0.f)); }
+
+    // Lanes (a[X], a[Y], b[Z], b[W]).
+    template <int X, int Y, int Z, int W>
+    inline Float4 Shuffle(const Float4 a, const Float4 b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X)); }
+
+    // The x lane.
+    inline float First(const Float4 a) { return _mm_cvtss_f32(a); }
+
+    // Set the w lane to +0.
+    inline Float4 ZeroW(const Float4 a)
+    {
+        #if defined(MATH_SIMD4_SSE41)
+        return _mm_blend_ps(a, _mm_setzero_ps(), 0x8);
+        #else
+        return _mm_and_ps(a, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+        #endif
+    }
+
+    // Sum of the lanes ((x + y) + z) + w.
+    inline float Sum(const Float4 a)
+    {
+        Float4 s = _mm_add_ss(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)));
+        s = _mm_add_ss(s, _mm_movehl_ps(a, a));
+        s = _mm_add_ss(s, _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)));
+        return _mm_cvtss_f32(s);
+    }
+
+    // Transpose the 4x4 matrix stored in rows.
+    inline void Transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3)
+    {
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    }
+
+    // Lanes scaled by 255, clamped to [0; 255] and truncated to bytes, the x lane is the lowest byte.
+    inline uint32_t PackUnorm8(const Float4 a)
+    {
+        const __m128 scaled = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, _mm_set1_ps(255.f)), _mm_setzero_ps()), _mm_set1_ps(255.f));
+        const __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(scaled), _mm_setzero_si128());
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+    }
+
+    #elif defined(MATH_SIMD4_NEON)
+
+    using Float4 = float32x4_t;
+
+    inline Float4 Load(const float* const data) { return vld1q_f32(data); }
+    inline void Store(float* const data, const Float4 a) { vst1q_f32(data, a); }
+
+    inline Float4 Set(const float x, const float y, const float z, const float w)
+    {
+        const float data[4] = {x, y, z, w};
+        return vld1q_f32(data);
+    }
+    inline Float4 Splat(const float value) { return vdupq_n_f32(value); }
+
+    inline Float4 Add(const Float4 a, const Float4 b) { return vaddq_f32(a, b); }
+    inline Float4 Sub(const Float4 a, const Float4 b) { return vsubq_f32(a, b); }
+    inline Float4 Mul(const Float4 a, const Float4 b) { return vmulq_f32(a, b); }
+    inline Float4 Div(const Float4 a, const Float4 b) { return vdivq_f32(a, b); }
+    inline Float4 Negate(const Float4 a) { return vnegq_f32(a); }
+
+    // Lanes (a[X], a[Y], b[Z], b[W]).
+    template <int X, int Y, int Z, int W>
+    inline Float4 Shuffle(const Float4 a, const Float4 b)
+    {
+        Float4 r = vdupq_n_f32(vgetq_lane_f32(a, X));
+        r = vsetq_lane_f32(vgetq_lane_f32(a, Y), r, 1);
+        r = vsetq_lane_f32(vgetq_lane_f32(b, Z), r, 2);
+        return vsetq_lane_f32(vgetq_lane_f32(b, W), r, 3);
+    }
+
+    // The x lane.
+    inline float First(const Float4 a) { return vgetq_lane_f32(a, 0); }
+
+    // Set the w lane to +0.
+    inline Float4 ZeroW(const Float4 a) { return vsetq_lane_f32(0.f, a, 3); }
+
+    // Sum of the lanes ((x + y) + z) + w.
+    inline float Sum(const Float4 a)
+    {
+        return ((vgetq_lane_f32(a, 0) + vgetq_lane_f32(a, 1)) + vgetq_lane_f32(a, 2)) + vgetq_lane_f32(a, 3);
+    }
+
+    // Transpose the 4x4 matrix stored in rows.
+    inline void Transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3)
+    {
+        const float32x4x2_t t01 = vtrnq_f32(r0, r1);
+        const float32x4x2_t t23 = vtrnq_f32(r2, r3);
+        r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+        r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+        r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+
+    // Lanes scaled by 255, clamped to [0; 255] and truncated to bytes, the x lane is the lowest byte.
+    inline uint32_t PackUnorm8(const Float4 a)
+    {
+        const float32x4_t scaled = vminq_f32(vmaxq_f32(vmulq_f32(a, vdupq_n_f32(255.f)), vdupq_n_f32(0.f)), vdupq_n_f32(255.f));
+        const uint16x4_t words = vmovn_u32(vcvtq_u32_f32(scaled));
+        const uint8x8_t bytes = vmovn_u16(vcombine_u16(words, words));
+        return vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+    }
+
+    #else
+
+    // Emulated lanes.
+    struct Float4
+    {
+        float v[4];
+    };
+
+    inline Float4 Load(const float* const data) { return {{data[0], data[1], data[2], data[3]}}; }
+    inline void Store(float* const data, const Float4 a) { data[0] = a.v[0]; data[1] = a.v[1]; data[2] = a.v[2]; data[3] = a.v[3]; }
+
+    inline Float4 Set(const float x, const float y, const float z, const float w) { return {{x, y, z, w}}; }
+    inline Float4 Splat(const float value) { return {{value, value, value, value}}; }
+
+    inline Float4 Add(const Float4 a, const Float4 b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+    inline Float4 Sub(const Float4 a, const Float4 b) { return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}}; }
+    inline Float4 Mul(const Float4 a, const Float4 b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; }
+    inline Float4 Div(const Float4 a, const Float4 b) { return {{a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]}}; }
+    inline Float4 Negate(const Float4 a) { return {{-a.v[0], -a.v[1], -a.v[2], -a.v[3]}}; }
+
+    // Lanes (a[X], a[Y], b[Z], b[W]).
+    template <int X, int Y, int Z, int W>
+    inline Float4 Shuffle(const Float4 a, const Float4 b) { return {{a.v[X], a.v[Y], b.v[Z], b.v[W]}}; }
+
+    // The x lane.
+    inline float First(const Float4 a) { return a.v[0]; }
+
+    // Set the w lane to +0.
+    inline Float4 ZeroW(const Float4 a) { return {{a.v[0], a.v[1], a.v[2], 0.f}}; }
+
+    // Sum of the lanes ((x + y) + z) + w.
+    inline float Sum(const Float4 a) { return ((a.v[0] + a.v[1]) + a.v[2]) + a.v[3]; }
+
+    // Transpose the 4x4 matrix stored in rows.
+    inline void Transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3)
+    {
+        const Float4 t0 = {{r0.v[0], r1.v[0], r2.v[0], r3.v[0]}};
+        const Float4 t1 = {{r0.v[1], r1.v[1], r2.v[1], r3.v[1]}};
+        const Float4 t2 = {{r0.v[2], r1.v[2], r2.v[2], r3.v[2]}};
+        const Float4 t3 = {{r0.v[3], r1.v[3], r2.v[3], r3.v[3]}};
+        r0 = t0;
+        r1 = t1;
+        r2 = t2;
+        r3 = t3;
+    }
+
+    // Lanes scaled by 255, clamped to [0; 255] and truncated to bytes, the x lane is the lowest byte.
+    inline uint32_t PackUnorm8(const Float4 a)
+    {
+        uint32_t packed = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            const float scaled = a.v[i] * 255.f;
+            const float clamped = scaled <= 0.f ? 0.f : (scaled >= 255.f ? 255.f : scaled);
+            packed |= static_cast<uint32_t>(clamped) << (8 * i);
+        }
+        return packed;
+    }
+
+    #endif
+
+    // 4D dot product summed left to right like the scalar code.
+    inline float Dot(const Float4 a, const Float4 b)
+    {
+        return Sum(Mul(a, b));
+    }
+
+    // Lanes (a[X], a[Y], a[Z], a[W]).
+    template <int X, int Y, int Z, int W>
+    inline Float4 Swizzle(const Float4 a) { return Shuffle<X, Y, Z, W>(a, a); }
+
+    // 3D cross product, the w lane is +0.
+    inline Float4 Cross(const Float4 a, const Float4 b)
+    {
+        return ZeroW(Sub(Mul(Swizzle<1, 2, 0, 3>(a), Swizzle<2, 0, 1, 3>(b)), Mul(Swizzle<2, 0, 1, 3>(a), Swizzle<1, 2, 0, 3>(b))));
+    }
+}
+}
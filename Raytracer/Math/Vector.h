@@ -112,6 +112,9 @@ namespace Math
 
         // Vector negation.
         void Invert() noexcept;
+
+        // Component access by axis index (0 - x, 1 - y, 2 - z, 3 - w).
+        float operator[](const int axis) const noexcept;
     };
 }
 
@@ -1,9 +1,25 @@
 #pragma once
 
 #include <cmath>
+#include "Simd4.h"
 
 namespace Math
 {
+    namespace VectorDetail
+    {
+        inline Simd4::Float4 Load(const Vector& v) noexcept
+        {
+            return Simd4::Load(&v.x);
+        }
+
+        inline Vector Store(const Simd4::Float4 a) noexcept
+        {
+            Vector v;
+            Simd4::Store(&v.x, a);
+            return v;
+        }
+    }
+
     inline void Vector::Set(const float x_, const float y_, const float z_, const float w_) noexcept
     {
         x = x_;
@@ -14,56 +30,56 @@ namespace Math
 
     inline float Vector::operator*(const Vector& r) const noexcept
     {
-        return (x * r.x) + (y * r.y) + (z * r.z) + (w * r.w);
+        return Simd4::Dot(VectorDetail::Load(*this), VectorDetail::Load(r));
     }
 
     inline Vector& Vector::operator+=(const Vector& r) noexcept
     {
-        Set(x + r.x, y + r.y, z + r.z, w + r.w);
+        *this = *this + r;
         return *this;
     }
 
     inline Vector Vector::operator+(const Vector& r) const noexcept
     {
-        return {x + r.x, y + r.y, z + r.z, w + r.w};
+        return VectorDetail::Store(Simd4::Add(VectorDetail::Load(*this), VectorDetail::Load(r)));
     }
 
     inline Vector& Vector::operator-=(const Vector& r) noexcept
     {
-        Set(x - r.x, y - r.y, z - r.z, w - r.w);
+        *this = *this - r;
         return *this;
     }
 
     inline Vector Vector::operator-(const Vector& r) const noexcept
     {
-        return {x - r.x, y - r.y, z - r.z, w - r.w};
+        return VectorDetail::Store(Simd4::Sub(VectorDetail::Load(*this), VectorDetail::Load(r)));
     }
 
     inline Vector& Vector::operator*=(const float value) noexcept
     {
-        Set(x * value, y * value, z * value, w * value);
+        *this = *this * value;
         return *this;
     }
 
     inline Vector Vector::operator*(const float value) const noexcept
     {
-        return {x * value, y * value, z * value, w * value};
+        return VectorDetail::Store(Simd4::Mul(VectorDetail::Load(*this), Simd4::Splat(value)));
     }
 
     inline Vector& Vector::operator/=(const float value) noexcept
     {
-        Set(x / value, y / value, z / value, w / value);
+        *this = *this / value;
         return *this;
     }
 
     inline Vector Vector::operator/(const float value) const noexcept
     {
-        return {x / value, y / value, z / value, w / value};
+        return VectorDetail::Store(Simd4::Div(VectorDetail::Load(*this), Simd4::Splat(value)));
     }
 
     inline Vector Vector::operator-() const noexcept
     {
-        return {-x, -y, -z, -w};
+        return VectorDetail::Store(Simd4::Negate(VectorDetail::Load(*this)));
     }
 
     inline bool Vector::operator==(const Vector& r) const noexcept
@@ -128,36 +144,41 @@ namespace Math
 
     inline float Vector::Length() const noexcept
     {
-        return sqrtf(x * x + y * y + z * z + w * w);
+        return sqrtf(LengthSq());
     }
 
     inline float Vector::LengthSq() const noexcept
     {
-        return x * x + y * y + z * z + w * w;
+        return *this * *this;
     }
 
     inline void Vector::SetLength(const float value) noexcept
     {
-        float l = Length();
+        const float l = Length();
         if (l != 0)
         {
-            float n = value / l;
-            Set(x * n, y * n, z * n, w * n);
+            *this *= value / l;
         }
     }
 
     inline void Vector::Normalize() noexcept
     {
-        float l = Length();
-        if (l != 0)
+        // Exact division by the length, the reciprocal square root estimates differ between the backends.
+        const float length = Length();
+        if (length != 0)
         {
-            Set(x / l, y / l, z / l, w / l);
+            *this /= length;
         }
     }
 
     inline void Vector::Invert() noexcept
     {
-        Set(-x, -y, -z, -w);
+        *this = -*this;
+    }
+
+    inline float Vector::operator[](const int axis) const noexcept
+    {
+        return (&x)[axis];
     }
 
     inline Vector Vector::Normalized(Vector&& v) noexcept
@@ -203,18 +224,13 @@ namespace Math
 
     inline Vector Vector::Cross(const Vector& l, const Vector& r) noexcept
     {
-        return {
-            l.y * r.z - l.z * r.y,
-            l.z * r.x - l.x * r.z,
-            l.x * r.y - l.y * r.x,
-            0
-        };
+        return VectorDetail::Store(Simd4::Cross(VectorDetail::Load(l), VectorDetail::Load(r)));
     }
 
     // Component-wise multiplication.
     inline Vector Vector::Mul(const Vector& l, const Vector& r) noexcept
     {
-        return {l.x * r.x, l.y * r.y, l.z * r.z, l.w * r.w};
+        return VectorDetail::Store(Simd4::Mul(VectorDetail::Load(l), VectorDetail::Load(r)));
     }
 
     inline float Vector::Length(const Vector& v) noexcept
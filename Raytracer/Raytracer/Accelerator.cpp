@@ -0,0 +1,455 @@
+#include "Accelerator.h"
+
+namespace
+{
+    // Slots of the primitives which are not in the bounded array.
+    const uint32_t Unbounded = UINT32_MAX;
+    const uint32_t Skipped = UINT32_MAX - 1;
+
+    // Rebuild the refitted BVH if its cost grows over this ratio of the build cost.
+    const float RebuildRatio = 1.5f;
+
+    // Slot of the primitive with the given bounds.
+    uint32_t Slot(const Math::Box& box, const uint32_t index)
+    {
+        // Primitive with empty bounds can not be hit.
+        if (box.Empty())
+        {
+            return Skipped;
+        }
+        return box.Finite() ? index : Unbounded;
+    }
+
+    // Virtual queries of the generic primitives, the counted ones in the instrumented traversals.
+    float GenericRaycast(const Primitive& primitive, const Math::Ray& ray, const float maxDistance, RaycastSample& output, NoCounters&)
+    {
+        return primitive.Raycast(ray, maxDistance, output);
+    }
+
+    float GenericRaycast(const Primitive& primitive, const Math::Ray& ray, const float maxDistance, RaycastSample& output, TraceCounters& counters)
+    {
+        return primitive.CountedRaycast(ray, maxDistance, output, counters);
+    }
+
+    void GenericRaycast(const Primitive& primitive, const RayPacket& packet, PacketHit& hit, NoCounters&)
+    {
+        primitive.Raycast(packet, hit);
+    }
+
+    // Lanes one by one like the default Primitive::Raycast(const RayPacket&, PacketHit&), the packet results are
+    // bit-identical with the single rays, so only the traversal of the instanced meshes is counted in addition.
+    void GenericRaycast(const Primitive& primitive, const RayPacket& packet, PacketHit& hit, TraceCounters& counters)
+    {
+        RaycastSample sample;
+        for (int lane = 0; lane < RayPacket::Size; ++lane)
+        {
+            if (hit.distance[lane] == -INFINITY)
+            {
+                continue;
+            }
+            const float t = primitive.CountedRaycast(*packet.rays[lane], hit.distance[lane], sample, counters);
+            if (t != INFINITY)
+            {
+                hit.distance[lane] = t;
+                hit.sample[lane] = sample;
+                hit.primitive[lane] = &primitive;
+            }
+        }
+    }
+
+    bool GenericOccluded(const Primitive& primitive, const Math::Ray& ray, const float maxDistance, NoCounters&)
+    {
+        return primitive.Occluded(ray, maxDistance);
+    }
+
+    bool GenericOccluded(const Primitive& primitive, const Math::Ray& ray, const float maxDistance, TraceCounters& counters)
+    {
+        return primitive.CountedOccluded(ray, maxDistance, counters);
+    }
+}
+
+void Accelerator::Build(const std::vector<const Primitive*>& scenePrimitives)
+{
+    triangles.data.clear();
+    triangles.sources.clear();
+    spheres.data.clear();
+    spheres.sources.clear();
+    planes.data.clear();
+    planes.sources.clear();
+    generic.clear();
+
+    primitives.clear();
+    references.clear();
+    slots.clear();
+    bounded.clear();
+    unbounded.clear();
+    boxes.clear();
+
+    primitives.reserve(scenePrimitives.size());
+    references.reserve(scenePrimitives.size());
+    slots.reserve(scenePrimitives.size());
+    boxes.reserve(scenePrimitives.size());
+
+    for (const auto& primitive : scenePrimitives)
+    {
+        primitives.push_back(primitive);
+        if (primitive == nullptr)
+        {
+            references.push_back(0);
+            slots.push_back(Skipped);
+            continue;
+        }
+
+        const auto box = primitive->Bounds();
+        const uint32_t slot = Slot(box, static_cast<uint32_t>(bounded.size()));
+        const Reference reference = (slot == Skipped) ? 0 : Add(*primitive);
+        references.push_back(reference);
+        slots.push_back(slot);
+
+        if (slot == Unbounded)
+        {
+            unbounded.push_back(reference);
+        }
+        else if (slot != Skipped)
+        {
+            bounded.push_back(reference);
+            boxes.push_back(box);
+        }
+    }
+
+    bvh.Build(boxes);
+    buildCost = bvh.Cost();
+}
+
+void Accelerator::Transform(const std::vector<const Primitive*>& scenePrimitives)
+{
+    changed.clear();
+    snapshots.resize(scenePrimitives.size());
+    for (size_t i = 0; i < scenePrimitives.size(); ++i)
+    {
+        const Primitive* const primitive = scenePrimitives[i];
+        Snapshot& snapshot = snapshots[i];
+        if (primitive == nullptr)
+        {
+            snapshot = Snapshot();
+            continue;
+        }
+        if (snapshot.primitive == primitive && snapshot.version == primitive->Version() &&
+            snapshot.position == primitive->position && snapshot.rotation == primitive->rotation)
+        {
+            continue;
+        }
+
+        primitive->Transform();
+        snapshot.primitive = primitive;
+        snapshot.position = primitive->position;
+        snapshot.rotation = primitive->rotation;
+        snapshot.version = primitive->Version();
+        changed.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+void Accelerator::Update(const std::vector<const Primitive*>& scenePrimitives)
+{
+    // Primitives were added, removed or reordered.
+    bool rebuild = (scenePrimitives.size() != primitives.size());
+    for (size_t i = 0; !rebuild && i < scenePrimitives.size(); ++i)
+    {
+        rebuild = (scenePrimitives[i] != primitives[i]);
+    }
+
+    changes.clear();
+    changesKnown = !rebuild;
+    if (rebuild)
+    {
+        Build(scenePrimitives);
+        return;
+    }
+
+    if (changed.empty())
+    {
+        return;
+    }
+
+    // Bounds before and after the change, unbounded primitives can change anything.
+    for (const uint32_t i : changed)
+    {
+        const auto box = primitives[i]->Bounds();
+        const uint32_t slot = slots[i];
+        if (slot == Unbounded || (!box.Empty() && !box.Finite()))
+        {
+            changesKnown = false;
+            changes.clear();
+            break;
+        }
+        changes.push_back({slot == Skipped ? Math::Box() : boxes[slot], box});
+    }
+
+    // Update the boxes of the changed primitives, a primitive changing its slot requires a rebuild.
+    for (const uint32_t i : changed)
+    {
+        const auto box = primitives[i]->Bounds();
+        const uint32_t slot = slots[i];
+        const bool wasBounded = (slot != Unbounded && slot != Skipped);
+        if (Slot(box, wasBounded ? slot : 0) != slot)
+        {
+            Build(scenePrimitives);
+            return;
+        }
+        if (wasBounded)
+        {
+            boxes[slot] = box;
+        }
+        if (slot != Skipped)
+        {
+            Store(references[i], *primitives[i]);
+        }
+    }
+
+    // A tree built over no boxes or degenerate boxes has zero cost, so the ratio can not be used.
+    // It is rebuilt only when the refitted boxes get an area, which gives the new tree a non-zero cost.
+    bvh.Refit(boxes);
+    const float cost = bvh.Cost();
+    if (buildCost > 0.f ? cost > RebuildRatio * buildCost : cost > 0.f)
+    {
+        Build(scenePrimitives);
+    }
+}
+
+Accelerator::Reference Accelerator::Add(const Primitive& primitive)
+{
+    const PrimitiveType type = primitive.Type();
+
+    // Index of the new item.
+    size_t index = 0;
+    switch (type)
+    {
+    case PrimitiveType::Triangle:
+        index = triangles.data.size();
+        triangles.data.emplace_back();
+        triangles.sources.push_back(&primitive);
+        break;
+    case PrimitiveType::Sphere:
+        index = spheres.data.size();
+        spheres.data.emplace_back();
+        spheres.sources.push_back(&primitive);
+        break;
+    case PrimitiveType::Plane:
+        index = planes.data.size();
+        planes.data.emplace_back();
+        planes.sources.push_back(&primitive);
+        break;
+    default:
+        index = generic.size();
+        generic.push_back(&primitive);
+        break;
+    }
+
+    const Reference reference = (static_cast<Reference>(type) << TypeShift) | static_cast<Reference>(index);
+    Store(reference, primitive);
+    return reference;
+}
+
+void Accelerator::Store(const Reference reference, const Primitive& primitive)
+{
+    const Reference index = reference & IndexMask;
+    switch (static_cast<PrimitiveType>(reference >> TypeShift))
+    {
+    case PrimitiveType::Triangle:
+        triangles.data[index] = static_cast<const Triangle&>(primitive).Data();
+        break;
+    case PrimitiveType::Sphere:
+        spheres.data[index] = static_cast<const Sphere&>(primitive).Data();
+        break;
+    case PrimitiveType::Plane:
+        planes.data[index] = static_cast<const Plane&>(primitive).Data();
+        break;
+    default:
+        break;
+    }
+}
+
+template <typename Counters>
+inline float Accelerator::Raycast(const Reference reference, const Math::Ray& ray, const float maxDistance, RaycastSample& output, const Primitive*& primitive, Counters& counters) const
+{
+    const Reference index = reference & IndexMask;
+
+    // Typed kernels only change the output on hit.
+    float t = INFINITY;
+    switch (static_cast<PrimitiveType>(reference >> TypeShift))
+    {
+    case PrimitiveType::Triangle:
+        counters.Test(PrimitiveType::Triangle);
+        t = triangles.data[index].Raycast(ray, maxDistance, output);
+        if (t != INFINITY)
+        {
+            primitive = triangles.sources[index];
+        }
+        break;
+    case PrimitiveType::Sphere:
+        counters.Test(PrimitiveType::Sphere);
+        t = spheres.data[index].Raycast(ray, maxDistance, output);
+        if (t != INFINITY)
+        {
+            primitive = spheres.sources[index];
+        }
+        break;
+    case PrimitiveType::Plane:
+        counters.Test(PrimitiveType::Plane);
+        t = planes.data[index].Raycast(ray, maxDistance, output);
+        if (t != INFINITY)
+        {
+            primitive = planes.sources[index];
+        }
+        break;
+    default:
+    {
+        RaycastSample sample;
+        t = GenericRaycast(*generic[index], ray, maxDistance, sample, counters);
+        if (t != INFINITY)
+        {
+            output = sample;
+            primitive = generic[index];
+        }
+        break;
+    }
+    }
+    return t;
+}
+
+template <typename Counters>
+inline void Accelerator::Raycast(const Reference reference, const RayPacket& packet, const PacketRegisters& registers, PacketHit& hit, Counters& counters) const
+{
+    const Reference index = reference & IndexMask;
+    const PrimitiveType type = static_cast<PrimitiveType>(reference >> TypeShift);
+    if (type != PrimitiveType::Generic)
+    {
+        counters.PacketTest(type);
+    }
+    switch (type)
+    {
+    case PrimitiveType::Triangle:
+        triangles.data[index].Raycast(registers, hit, triangles.sources[index]);
+        break;
+    case PrimitiveType::Sphere:
+        spheres.data[index].Raycast(registers, hit, spheres.sources[index]);
+        break;
+    case PrimitiveType::Plane:
+        planes.data[index].Raycast(registers, hit, planes.sources[index]);
+        break;
+    default:
+        GenericRaycast(*generic[index], packet, hit, counters);
+        break;
+    }
+}
+
+template <typename Counters>
+inline bool Accelerator::Occluded(const Reference reference, const Math::Ray& ray, const float maxDistance, Counters& counters) const
+{
+    const Reference index = reference & IndexMask;
+    const PrimitiveType type = static_cast<PrimitiveType>(reference >> TypeShift);
+    if (type != PrimitiveType::Generic)
+    {
+        counters.Test(type);
+    }
+    switch (type)
+    {
+    case PrimitiveType::Triangle:
+        return triangles.data[index].Occluded(ray, maxDistance);
+    case PrimitiveType::Sphere:
+        return spheres.data[index].Occluded(ray, maxDistance);
+    case PrimitiveType::Plane:
+        return planes.data[index].Occluded(ray, maxDistance);
+    default:
+        return GenericOccluded(*generic[index], ray, maxDistance, counters);
+    }
+}
+
+float Accelerator::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output, const Primitive*& primitive) const
+{
+    NoCounters counters;
+    return Raycast(ray, maxDistance, output, primitive, counters);
+}
+
+template <typename Counters>
+float Accelerator::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output, const Primitive*& primitive, Counters& counters) const
+{
+    float distance = maxDistance;
+    float result = INFINITY;
+
+    // Unbounded primitives first, their hits limit the BVH traversal.
+    for (const Reference reference : unbounded)
+    {
+        const float t = Raycast(reference, ray, distance, output, primitive, counters);
+        if (t == INFINITY)
+        {
+            continue;
+        }
+        distance = t;
+        result = t;
+    }
+
+    const float t = bvh.Raycast(ray, distance, [&](const uint32_t item, const float itemDistance)
+    {
+        return Raycast(bounded[item], ray, itemDistance, output, primitive, counters);
+    }, counters);
+
+    if (t != INFINITY)
+    {
+        result = t;
+    }
+    return result;
+}
+
+void Accelerator::Raycast(const RayPacket& packet, PacketHit& hit) const
+{
+    NoCounters counters;
+    Raycast(packet, hit, counters);
+}
+
+template <typename Counters>
+void Accelerator::Raycast(const RayPacket& packet, PacketHit& hit, Counters& counters) const
+{
+    const PacketRegisters registers(packet);
+
+    // Unbounded primitives first, their hits limit the BVH traversal.
+    for (const Reference reference : unbounded)
+    {
+        Raycast(reference, packet, registers, hit, counters);
+    }
+
+    bvh.Raycast(packet, hit.distance, [&](const uint32_t item)
+    {
+        Raycast(bounded[item], packet, registers, hit, counters);
+    }, counters);
+}
+
+bool Accelerator::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    NoCounters counters;
+    return Occluded(ray, maxDistance, counters);
+}
+
+template <typename Counters>
+bool Accelerator::Occluded(const Math::Ray& ray, const float maxDistance, Counters& counters) const
+{
+    for (const Reference reference : unbounded)
+    {
+        if (Occluded(reference, ray, maxDistance, counters))
+        {
+            return true;
+        }
+    }
+
+    return bvh.Occluded(ray, maxDistance, [&](const uint32_t item, const float itemDistance)
+    {
+        return Occluded(bounded[item], ray, itemDistance, counters);
+    }, counters);
+}
+
+template float Accelerator::Raycast(const Math::Ray&, const float, RaycastSample&, const Primitive*&, NoCounters&) const;
+template float Accelerator::Raycast(const Math::Ray&, const float, RaycastSample&, const Primitive*&, TraceCounters&) const;
+template void Accelerator::Raycast(const RayPacket&, PacketHit&, NoCounters&) const;
+template void Accelerator::Raycast(const RayPacket&, PacketHit&, TraceCounters&) const;
+template bool Accelerator::Occluded(const Math::Ray&, const float, NoCounters&) const;
+template bool Accelerator::Occluded(const Math::Ray&, const float, TraceCounters&) const;
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include "Math/Math.h"
+#include "Raytracer/Bvh.h"
+#include "Raytracer/Primitives.h"
+
+// Acceleration structure over the scene primitives.
+// Bounded primitives are stored in a BVH, unbounded primitives (planes) are always tested.
+// Triangles, spheres and planes are compiled to contiguous typed arrays intersected by inlined kernels,
+// other primitives are intersected by the virtual Raycast() calls. The scene stays the authoring format.
+class Accelerator
+{
+public:
+    // Build the structure. Primitives must be transformed before the call.
+    void Build(const std::vector<const Primitive*>& primitives);
+
+    // Transform the primitives which are new or changed since the last call of this accelerator:
+    // the position, rotation or version differs, see Primitive::Invalidate().
+    // Every accelerator keeps its own state, so the accelerators can share the scene.
+    void Transform(const std::vector<const Primitive*>& primitives);
+
+    // Update the structure after the Transform() call.
+    // The BVH is kept if no primitive changed and refitted if only some of them moved.
+    // It is rebuilt if the primitive list changed or the refitted tree became too slow.
+    void Update(const std::vector<const Primitive*>& primitives);
+
+    // Bounds of a primitive changed by the last Update() call, before and after the change.
+    // Primitives which can not be hit have empty bounds.
+    struct Change
+    {
+        Math::Box before;
+        Math::Box after;
+    };
+
+    // The changes of the last Update() call are known: the primitive list is the same
+    // and no unbounded primitive changed.
+    bool ChangesKnown() const { return changesKnown; }
+    const std::vector<Change>& Changes() const { return changes; }
+
+    // Find the closest intersection nearer than maxDistance.
+    // Returns the intersection distance or INFINITY, the hit primitive is stored to the primitive argument.
+    float Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output, const Primitive*& primitive) const;
+
+    // Find the closest intersections of the packet rays, see Primitive::Raycast(const RayPacket&, PacketHit&).
+    void Raycast(const RayPacket& packet, PacketHit& hit) const;
+
+    // Returns true if any primitive is hit nearer than maxDistance, see Primitive::Occluded().
+    // The traversal stops at the first hit.
+    bool Occluded(const Math::Ray& ray, const float maxDistance) const;
+
+    // Raycast() and Occluded() counting the visited nodes and the intersection tests,
+    // instantiated for the NoCounters and TraceCounters policies.
+    template <typename Counters>
+    float Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output, const Primitive*& primitive, Counters& counters) const;
+    template <typename Counters>
+    void Raycast(const RayPacket& packet, PacketHit& hit, Counters& counters) const;
+    template <typename Counters>
+    bool Occluded(const Math::Ray& ray, const float maxDistance, Counters& counters) const;
+
+private:
+    // Reference to the compiled primitive: the primitive type in the upper bits and the array index.
+    using Reference = uint32_t;
+    static const int TypeShift = 30;
+    static const Reference IndexMask = (1u << TypeShift) - 1;
+
+    // Compiled primitives of a single type.
+    template <typename Data>
+    struct Bucket
+    {
+        std::vector<Data> data;
+        std::vector<const Primitive*> sources;
+    };
+
+    // Copy the primitive data to a new array item.
+    Reference Add(const Primitive& primitive);
+
+    // Copy the primitive data to the referenced array item.
+    void Store(const Reference reference, const Primitive& primitive);
+
+    template <typename Counters>
+    float Raycast(const Reference reference, const Math::Ray& ray, const float maxDistance, RaycastSample& output, const Primitive*& primitive, Counters& counters) const;
+    template <typename Counters>
+    void Raycast(const Reference reference, const RayPacket& packet, const PacketRegisters& registers, PacketHit& hit, Counters& counters) const;
+    template <typename Counters>
+    bool Occluded(const Reference reference, const Math::Ray& ray, const float maxDistance, Counters& counters) const;
+
+    Bucket<TriangleData> triangles;
+    Bucket<SphereData> spheres;
+    Bucket<PlaneData> planes;
+    std::vector<const Primitive*> generic;
+
+    // Primitive list of the last build, reference of each primitive and its slot:
+    // the index in the bounded array, Unbounded or Skipped.
+    std::vector<const Primitive*> primitives;
+    std::vector<Reference> references;
+    std::vector<uint32_t> slots;
+
+    // State of a primitive at its last Transform() call of this accelerator.
+    struct Snapshot
+    {
+        const Primitive* primitive = nullptr;
+        Math::Vector position;
+        Math::Vector rotation;
+        uint32_t version = 0;
+    };
+
+    // Snapshots of the scene primitives and indices of the primitives changed by the last Transform() call.
+    std::vector<Snapshot> snapshots;
+    std::vector<uint32_t> changed;
+
+    // Bounds of the primitives changed by the last Update() call.
+    std::vector<Change> changes;
+    bool changesKnown = false;
+
+    // References of the BVH items and of the primitives tested by every ray.
+    std::vector<Reference> bounded;
+    std::vector<Reference> unbounded;
+    std::vector<Math::Box> boxes;
+    Bvh bvh;
+
+    // BVH cost after the last build.
+    float buildCost = 0.f;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+// Memory with the given power of two alignment, freed by AlignedFree().
+// The C++14 operator new guarantees only the fundamental alignment, it ignores alignas() of the over-aligned types.
+inline void* AlignedAllocate(const size_t size, const size_t alignment)
+{
+    const size_t minimum = alignment < sizeof(void*) ? sizeof(void*) : alignment;
+    #if defined(_MSC_VER)
+    void* const memory = _aligned_malloc(size, minimum);
+    #else
+    void* memory = nullptr;
+    if (posix_memalign(&memory, minimum, size) != 0)
+    {
+        memory = nullptr;
+    }
+    #endif
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+inline void AlignedFree(void* const memory)
+{
+    #if defined(_MSC_VER)
+    _aligned_free(memory);
+    #else
+    free(memory);
+    #endif
+}
+
+// Allocator of the standard containers respecting alignof(T), e.g. of the cache line aligned per-thread data.
+template <typename T>
+class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(const size_t count)
+    {
+        return static_cast<T*>(AlignedAllocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* const pointer, const size_t)
+    {
+        AlignedFree(pointer);
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
@@ -0,0 +1,289 @@
+#include "Bvh.h"
+#include <algorithm>
+
+namespace
+{
+    // Number of the centroid bins evaluated along each axis.
+    const int BinCount = 16;
+
+    // Nodes with this number of items or less are always leaves.
+    const uint32_t MinLeafSize = 2;
+
+    // Nodes with more items are always split.
+    const uint32_t MaxLeafSize = 8;
+
+    // Cost of a node traversal relative to a single item intersection.
+    const float TraversalCost = 1.f;
+
+    struct Bin
+    {
+        Math::Box box;
+        uint32_t count = 0;
+    };
+}
+
+void Bvh::Build(const std::vector<Math::Box>& boxes)
+{
+    nodes.clear();
+    items.clear();
+    assigned = false;
+
+    if (boxes.empty())
+    {
+        return;
+    }
+
+    std::vector<BuildItem> buildItems(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        buildItems[i].box = boxes[i];
+        buildItems[i].center = boxes[i].Center();
+        buildItems[i].index = static_cast<uint32_t>(i);
+    }
+
+    nodes.reserve(2 * boxes.size());
+    items.reserve(boxes.size());
+    Build(buildItems, 0, static_cast<uint32_t>(buildItems.size()), 0);
+}
+
+void Bvh::Assign(const Node* const nodes_, const size_t nodeCount, const uint32_t* const items_, const size_t itemCount)
+{
+    nodes.clear();
+    items.clear();
+    assigned = true;
+    assignedNodes = nodes_;
+    assignedItems = items_;
+    assignedNodeCount = nodeCount;
+    assignedItemCount = itemCount;
+}
+
+bool Bvh::Valid(const Node* const nodes_, const size_t nodeCount, const uint32_t* const items_, const size_t itemCount, const size_t itemLimit)
+{
+    for (size_t i = 0; i < itemCount; ++i)
+    {
+        if (items_[i] >= itemLimit)
+        {
+            return false;
+        }
+    }
+
+    // Children are after their parent, so a single pass computes the maximum depth of each node.
+    std::vector<int> depth(nodeCount, 0);
+    for (size_t i = 0; i < nodeCount; ++i)
+    {
+        const Node& node = nodes_[i];
+        if (depth[i] >= MaxDepth)
+        {
+            return false;
+        }
+        if (node.count > 0)
+        {
+            if (static_cast<uint64_t>(node.offset) + node.count > itemCount)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (i + 1 >= nodeCount || node.offset <= i + 1 || node.offset >= nodeCount)
+            {
+                return false;
+            }
+            depth[i + 1] = std::max(depth[i + 1], depth[i] + 1);
+            depth[node.offset] = std::max(depth[node.offset], depth[i] + 1);
+        }
+    }
+    return true;
+}
+
+void Bvh::Refit(const std::vector<Math::Box>& boxes)
+{
+    // Children are always stored after their parent.
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        Node& node = nodes[i];
+        if (node.count > 0)
+        {
+            node.box = Math::Box();
+            for (uint32_t item = node.offset; item < node.offset + node.count; ++item)
+            {
+                node.box.Extend(boxes[items[item]]);
+            }
+        }
+        else
+        {
+            node.box = Math::Box::Union(nodes[i + 1].box, nodes[node.offset].box);
+        }
+    }
+}
+
+float Bvh::Cost() const
+{
+    if (Empty())
+    {
+        return 0.f;
+    }
+
+    const Node* const nodeArray = Nodes();
+    const float rootArea = nodeArray[0].box.SurfaceArea();
+    if (rootArea <= 0.f)
+    {
+        return 0.f;
+    }
+
+    float cost = 0.f;
+    for (size_t i = 0; i < NodeCount(); ++i)
+    {
+        const float area = nodeArray[i].box.SurfaceArea();
+        cost += (nodeArray[i].count > 0) ? area * nodeArray[i].count : area * TraversalCost;
+    }
+    return cost / rootArea;
+}
+
+Math::Box Bvh::Bounds() const
+{
+    if (Empty())
+    {
+        return Math::Box();
+    }
+    return Nodes()[0].box;
+}
+
+void Bvh::Build(std::vector<BuildItem>& buildItems, const uint32_t begin, const uint32_t end, const int depth)
+{
+    const uint32_t count = end - begin;
+
+    // Node bounds and bounds of the item centers.
+    Math::Box box;
+    Math::Box centerBox;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        box.Extend(buildItems[i].box);
+        centerBox.Extend(buildItems[i].center);
+    }
+
+    if (count <= MinLeafSize || depth >= MaxDepth - 1)
+    {
+        CreateLeaf(buildItems, begin, end, box);
+        return;
+    }
+
+    // Find the best split plane using the binned surface area heuristic.
+    float bestCost = INFINITY;
+    int bestAxis = -1;
+    int bestBin = 0;
+
+    const Math::Vector centerSize = centerBox.Size();
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float extent = centerSize[axis];
+        if (extent <= 0.f)
+        {
+            continue;
+        }
+
+        const float scale = BinCount / extent;
+        const float offset = centerBox.min[axis];
+
+        Bin bins[BinCount];
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const int bin = std::min(static_cast<int>((buildItems[i].center[axis] - offset) * scale), BinCount - 1);
+            bins[bin].box.Extend(buildItems[i].box);
+            bins[bin].count += 1;
+        }
+
+        // Sweep from the right to get areas and counts on the right side of each plane.
+        float rightArea[BinCount];
+        uint32_t rightCount[BinCount];
+        Math::Box rightBox;
+        uint32_t rightItems = 0;
+        for (int i = BinCount - 1; i > 0; --i)
+        {
+            rightBox.Extend(bins[i].box);
+            rightItems += bins[i].count;
+            rightArea[i] = rightBox.SurfaceArea();
+            rightCount[i] = rightItems;
+        }
+
+        // Sweep from the left and evaluate the cost of the plane between bins i - 1 and i.
+        Math::Box leftBox;
+        uint32_t leftItems = 0;
+        for (int i = 1; i < BinCount; ++i)
+        {
+            leftBox.Extend(bins[i - 1].box);
+            leftItems += bins[i - 1].count;
+            if (leftItems == 0 || rightCount[i] == 0)
+            {
+                continue;
+            }
+            const float cost = leftBox.SurfaceArea() * leftItems + rightArea[i] * rightCount[i];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = i;
+            }
+        }
+    }
+
+    // Compare the split with the cost of intersecting all items in a leaf.
+    const float area = box.SurfaceArea();
+    const float leafCost = area * count;
+    const float splitCost = area * TraversalCost + bestCost;
+
+    uint32_t middle = begin + count / 2;
+
+    if (bestAxis < 0)
+    {
+        // All item centers are equal, split in the middle of the range if the node is too big.
+        if (count <= MaxLeafSize)
+        {
+            CreateLeaf(buildItems, begin, end, box);
+            return;
+        }
+    }
+    else
+    {
+        if (splitCost >= leafCost && count <= MaxLeafSize)
+        {
+            CreateLeaf(buildItems, begin, end, box);
+            return;
+        }
+
+        const float scale = BinCount / centerSize[bestAxis];
+        const float offset = centerBox.min[bestAxis];
+        const auto first = buildItems.begin() + begin;
+        const auto last = buildItems.begin() + end;
+        const auto split = std::partition(first, last, [=](const BuildItem& item)
+        {
+            return std::min(static_cast<int>((item.center[bestAxis] - offset) * scale), BinCount - 1) < bestBin;
+        });
+        middle = begin + static_cast<uint32_t>(split - first);
+    }
+
+    // Create the inner node, the first child follows the node, the second child offset is set later.
+    const uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    nodes[index].box = box;
+
+    Build(buildItems, begin, middle, depth + 1);
+    nodes[index].offset = static_cast<uint32_t>(nodes.size());
+    Build(buildItems, middle, end, depth + 1);
+}
+
+uint32_t Bvh::CreateLeaf(const std::vector<BuildItem>& buildItems, const uint32_t begin, const uint32_t end, const Math::Box& box)
+{
+    const uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    nodes[index].box = box;
+    nodes[index].offset = static_cast<uint32_t>(items.size());
+    nodes[index].count = end - begin;
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        items.push_back(buildItems[i].index);
+    }
+    return index;
+}
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Math/Math.h"
+#include "Math/Simd.h"
+#include "Raytracer/RayPacket.h"
+#include "Raytracer/TraceCounters.h"
+
+// Bounding volume hierarchy built with the surface area heuristic.
+// The hierarchy only knows the item bounding boxes, the items are intersected by the caller.
+class Bvh
+{
+public:
+    struct Node
+    {
+        Math::Box box;
+
+        // Leaf: index of the first item in the Items() array.
+        // Inner node: index of the second child, the first child directly follows the node.
+        uint32_t offset = 0;
+
+        // Number of items, 0 for inner nodes.
+        uint32_t count = 0;
+    };
+
+    // Build the hierarchy over the item boxes. Item indices refer to the boxes array.
+    void Build(const std::vector<Math::Box>& boxes);
+
+    // Use the nodes and items stored outside of the hierarchy, for example in a mapped file, instead of a build.
+    // The arrays must stay valid while the hierarchy is used.
+    void Assign(const Node* const nodes, const size_t nodeCount, const uint32_t* const items, const size_t itemCount);
+
+    // Check the arrays for Assign() from an untrusted source. The children must follow their parent inside the nodes array,
+    // the leaves must reference the items array, the items must be smaller than itemLimit and the depth must fit the traversal stack.
+    static bool Valid(const Node* const nodes, const size_t nodeCount, const uint32_t* const items, const size_t itemCount, const size_t itemLimit);
+
+    // Update the node boxes for the moved items, the tree topology is kept.
+    // The boxes array must have the same size as in the Build() call. Assigned hierarchies are not changed.
+    void Refit(const std::vector<Math::Box>& boxes);
+
+    // Estimated cost of a ray traversal relative to a single item intersection (surface area heuristic).
+    // Refitting moved items increases the cost, compare it with the cost after the build to decide a rebuild.
+    float Cost() const;
+
+    bool Empty() const { return NodeCount() == 0; }
+
+    // Bounding box of all items.
+    Math::Box Bounds() const;
+
+    // Nodes in the depth-first order, the root is the first node.
+    const Node* Nodes() const { return assigned ? assignedNodes : nodes.data(); }
+    size_t NodeCount() const { return assigned ? assignedNodeCount : nodes.size(); }
+
+    // Item indices referenced by the leaves.
+    const uint32_t* Items() const { return assigned ? assignedItems : items.data(); }
+    size_t ItemCount() const { return assigned ? assignedItemCount : items.size(); }
+
+    // Traverse the hierarchy front to back and return the closest hit distance or INFINITY.
+    // The intersect callback is called as intersect(item, maxDistance) and returns the hit
+    // distance smaller than maxDistance or INFINITY.
+    template <typename Intersect>
+    float Raycast(const Math::Ray& ray, const float maxDistance, Intersect&& intersect) const;
+
+    // Raycast() counting the visited nodes with counters.AddNodes().
+    template <typename Intersect, typename Counters>
+    float Raycast(const Math::Ray& ray, const float maxDistance, Intersect&& intersect, Counters& counters) const;
+
+    // Traverse the hierarchy until any item is hit nearer than maxDistance.
+    // The intersect callback is called as intersect(item, maxDistance) and returns true on hit.
+    template <typename Intersect>
+    bool Occluded(const Math::Ray& ray, const float maxDistance, Intersect&& intersect) const;
+
+    // Occluded() counting the visited nodes with counters.AddNodes().
+    template <typename Intersect, typename Counters>
+    bool Occluded(const Math::Ray& ray, const float maxDistance, Intersect&& intersect, Counters& counters) const;
+
+    // Traverse the hierarchy with a ray packet. A node is visited if any lane enters the node box
+    // nearer than its distance. The intersect callback is called as intersect(item) and updates
+    // the per-lane distances array, lanes with -INFINITY distance are inactive.
+    template <typename Intersect>
+    void Raycast(const RayPacket& packet, const float* const distance, Intersect&& intersect) const;
+
+    // Packet Raycast() counting the nodes visited by the packet with counters.AddNodes().
+    template <typename Intersect, typename Counters>
+    void Raycast(const RayPacket& packet, const float* const distance, Intersect&& intersect, Counters& counters) const;
+
+private:
+    // Maximum depth of the hierarchy (traversal stack size).
+    static const int MaxDepth = 64;
+
+    struct BuildItem
+    {
+        Math::Box box;
+        Math::Vector center;
+        uint32_t index;
+    };
+
+    void Build(std::vector<BuildItem>& buildItems, const uint32_t begin, const uint32_t end, const int depth);
+    uint32_t CreateLeaf(const std::vector<BuildItem>& buildItems, const uint32_t begin, const uint32_t end, const Math::Box& box);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items;
+
+    // Arrays of the Assign() call.
+    bool assigned = false;
+    const Node* assignedNodes = nullptr;
+    const uint32_t* assignedItems = nullptr;
+    size_t assignedNodeCount = 0;
+    size_t assignedItemCount = 0;
+};
+
+template <typename Intersect>
+float Bvh::Raycast(const Math::Ray& ray, const float maxDistance, Intersect&& intersect) const
+{
+    NoCounters counters;
+    return Raycast(ray, maxDistance, intersect, counters);
+}
+
+template <typename Intersect, typename Counters>
+float Bvh::Raycast(const Math::Ray& ray, const float maxDistance, Intersect&& intersect, Counters& counters) const
+{
+    if (Empty())
+    {
+        return INFINITY;
+    }
+    const Node* const nodeArray = Nodes();
+    const uint32_t* const itemArray = Items();
+
+    const Math::Vector inverseDirection(1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z, 0.f);
+
+    float distance = maxDistance;
+    float result = INFINITY;
+
+    // Stack of nodes to visit with their entry distances.
+    uint32_t stack[MaxDepth];
+    float stackDistance[MaxDepth];
+    int stackSize = 0;
+
+    uint32_t index = 0;
+    if (Math::IntersectBox(ray, inverseDirection, nodeArray[0].box) >= distance)
+    {
+        return INFINITY;
+    }
+
+    // Visited nodes are counted locally, so the counters are not written in the loop.
+    uint64_t visited = 0;
+    for (;;)
+    {
+        const Node& node = nodeArray[index];
+        ++visited;
+
+        if (node.count > 0)
+        {
+            // Leaf, intersect items.
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                const float t = intersect(itemArray[i], distance);
+                if (t < distance)
+                {
+                    distance = t;
+                    result = t;
+                }
+            }
+        }
+        else
+        {
+            // Inner node, visit the nearer child first and push the farther one.
+            uint32_t first = index + 1;
+            uint32_t second = node.offset;
+            float firstEntry = Math::IntersectBox(ray, inverseDirection, nodeArray[first].box);
+            float secondEntry = Math::IntersectBox(ray, inverseDirection, nodeArray[second].box);
+            if (secondEntry < firstEntry)
+            {
+                std::swap(first, second);
+                std::swap(firstEntry, secondEntry);
+            }
+            if (secondEntry < distance)
+            {
+                stack[stackSize] = second;
+                stackDistance[stackSize] = secondEntry;
+                ++stackSize;
+            }
+            if (firstEntry < distance)
+            {
+                index = first;
+                continue;
+            }
+        }
+
+        // Pop the next node, skip nodes behind the closest hit.
+        for (;;)
+        {
+            if (stackSize == 0)
+            {
+                counters.AddNodes(visited);
+                return result;
+            }
+            --stackSize;
+            if (stackDistance[stackSize] < distance)
+            {
+                index = stack[stackSize];
+                break;
+            }
+        }
+    }
+}
+
+template <typename Intersect>
+bool Bvh::Occluded(const Math::Ray& ray, const float maxDistance, Intersect&& intersect) const
+{
+    NoCounters counters;
+    return Occluded(ray, maxDistance, intersect, counters);
+}
+
+template <typename Intersect, typename Counters>
+bool Bvh::Occluded(const Math::Ray& ray, const float maxDistance, Intersect&& intersect, Counters& counters) const
+{
+    if (Empty())
+    {
+        return false;
+    }
+    const Node* const nodeArray = Nodes();
+    const uint32_t* const itemArray = Items();
+
+    const Math::Vector inverseDirection(1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z, 0.f);
+
+    // Stack of nodes to visit, any hit ends the traversal so the children are not ordered.
+    uint32_t stack[MaxDepth];
+    int stackSize = 0;
+
+    uint32_t index = 0;
+    if (Math::IntersectBox(ray, inverseDirection, nodeArray[0].box) >= maxDistance)
+    {
+        return false;
+    }
+
+    // Visited nodes are counted locally, so the counters are not written in the loop.
+    uint64_t visited = 0;
+    for (;;)
+    {
+        const Node& node = nodeArray[index];
+        ++visited;
+
+        if (node.count > 0)
+        {
+            // Leaf, intersect items.
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                if (intersect(itemArray[i], maxDistance))
+                {
+                    counters.AddNodes(visited);
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            // Inner node, visit the first child and push the second one.
+            const uint32_t first = index + 1;
+            const uint32_t second = node.offset;
+            const bool firstHit = Math::IntersectBox(ray, inverseDirection, nodeArray[first].box) < maxDistance;
+            const bool secondHit = Math::IntersectBox(ray, inverseDirection, nodeArray[second].box) < maxDistance;
+            if (firstHit && secondHit)
+            {
+                stack[stackSize] = second;
+                ++stackSize;
+            }
+            if (firstHit || secondHit)
+            {
+                index = firstHit ? first : second;
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+        {
+            counters.AddNodes(visited);
+            return false;
+        }
+        --stackSize;
+        index = stack[stackSize];
+    }
+}
+
+template <typename Intersect>
+void Bvh::Raycast(const RayPacket& packet, const float* const distance, Intersect&& intersect) const
+{
+    NoCounters counters;
+    Raycast(packet, distance, intersect, counters);
+}
+
+template <typename Intersect, typename Counters>
+void Bvh::Raycast(const RayPacket& packet, const float* const distance, Intersect&& intersect, Counters& counters) const
+{
+    using namespace Math::Simd;
+
+    if (Empty())
+    {
+        return;
+    }
+    const Node* const nodeArray = Nodes();
+    const uint32_t* const itemArray = Items();
+
+    const Float one = Splat(1.f);
+    const Float zero = Splat(0.f);
+    const Float ox = Load(packet.originX);
+    const Float oy = Load(packet.originY);
+    const Float oz = Load(packet.originZ);
+    const Float ix = Div(one, Load(packet.directionX));
+    const Float iy = Div(one, Load(packet.directionY));
+    const Float iz = Div(one, Load(packet.directionZ));
+
+    // Per-lane box entry distances, INFINITY if missed.
+    const auto entry = [&](const Math::Box& box)
+    {
+        const Float tx0 = Mul(Sub(Splat(box.min.x), ox), ix);
+        const Float tx1 = Mul(Sub(Splat(box.max.x), ox), ix);
+        const Float ty0 = Mul(Sub(Splat(box.min.y), oy), iy);
+        const Float ty1 = Mul(Sub(Splat(box.max.y), oy), iy);
+        const Float tz0 = Mul(Sub(Splat(box.min.z), oz), iz);
+        const Float tz1 = Mul(Sub(Splat(box.max.z), oz), iz);
+        const Float tmin = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Max(Min(tz0, tz1), zero));
+        const Float tmax = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Max(tz0, tz1));
+        return Select(Greater(tmin, tmax), Splat(INFINITY), tmin);
+    };
+
+    // Stack of nodes to visit with their lane entry distances.
+    uint32_t stack[MaxDepth];
+    Float stackEntry[MaxDepth];
+    int stackSize = 0;
+
+    uint32_t index = 0;
+    if (!Any(Less(entry(nodeArray[0].box), Load(distance))))
+    {
+        return;
+    }
+
+    // Visited nodes are counted locally, so the counters are not written in the loop.
+    uint64_t visited = 0;
+    for (;;)
+    {
+        const Node& node = nodeArray[index];
+        ++visited;
+
+        if (node.count > 0)
+        {
+            // Leaf, intersect items.
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                intersect(itemArray[i]);
+            }
+        }
+        else
+        {
+            // Inner node, visit the child with the nearer lane entry first.
+            const Float maxDistance = Load(distance);
+            uint32_t first = index + 1;
+            uint32_t second = node.offset;
+            Float firstEntry = entry(nodeArray[first].box);
+            Float secondEntry = entry(nodeArray[second].box);
+            const bool firstHit = Any(Less(firstEntry, maxDistance));
+            const bool secondHit = Any(Less(secondEntry, maxDistance));
+
+            if (firstHit && secondHit)
+            {
+                if (Count(Less(secondEntry, firstEntry)) > Count(Less(firstEntry, secondEntry)))
+                {
+                    std::swap(first, second);
+                    std::swap(firstEntry, secondEntry);
+                }
+                stack[stackSize] = second;
+                stackEntry[stackSize] = secondEntry;
+                ++stackSize;
+                index = first;
+                continue;
+            }
+            if (firstHit || secondHit)
+            {
+                index = firstHit ? first : second;
+                continue;
+            }
+        }
+
+        // Pop the next node, skip nodes behind the closest hits of all lanes.
+        for (;;)
+        {
+            if (stackSize == 0)
+            {
+                counters.AddNodes(visited);
+                return;
+            }
+            --stackSize;
+            if (Any(Less(stackEntry[stackSize], Load(distance))))
+            {
+                index = stack[stackSize];
+                break;
+            }
+        }
+    }
+}
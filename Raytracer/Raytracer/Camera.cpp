@@ -2,7 +2,7 @@
 
 inline float ComputeFov(const float fov, const float aspectRatio)
 {
-    return 2.f * std::atanf(std::tanf(fov / 2.f) / aspectRatio);
+    return 2.f * std::atan(std::tan(fov / 2.f) / aspectRatio);
 }
 
 Camera::Camera():
@@ -85,4 +85,10 @@ void Camera::LookAt(const Math::Vector& look, const Math::Vector& up)
 {
     this->look = Math::Vector::Normalized(look);
     this->up = Math::Vector::Normalized(up);
-}
\ No newline at end of file
+}
+
+void Camera::SetOrientation(const Math::Vector& look, const Math::Vector& up)
+{
+    this->look = look;
+    this->up = up;
+}
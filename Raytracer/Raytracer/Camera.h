@@ -19,6 +19,9 @@ public:
     void LookAtTarget(const Math::Vector& target);
     void LookAt(const Math::Vector& look, const Math::Vector& up);
 
+    // Restore the vectors of Look() and Up() exactly, they must be unit and orthogonal.
+    void SetOrientation(const Math::Vector& look, const Math::Vector& up);
+
     Math::Vector Look() const { return look; }
     Math::Vector Up() const { return up; }
 
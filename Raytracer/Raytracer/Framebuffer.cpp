@@ -1,4 +1,43 @@
 #include "Framebuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Entries of the sRGB table, the steps are below the 8-bit precision except close to black.
+    const int SrgbTableSize = 4096;
+
+    // sRGB transfer curve of the linear value in [0; 1].
+    float SrgbEncode(const float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+    }
+
+    // Color lanes of the first vector with the alpha lane of the second one.
+    Math::Simd4::Float4 WithAlpha(const Math::Simd4::Float4 color, const Math::Simd4::Float4 alpha)
+    {
+        using namespace Math::Simd4;
+        return Shuffle<0, 1, 0, 2>(color, Shuffle<2, 2, 3, 3>(color, alpha));
+    }
+
+    // Tone mapping of all lanes.
+    Math::Simd4::Float4 ToneMap(const Math::Simd4::Float4 c, const ToneMapping toneMapping)
+    {
+        using namespace Math::Simd4;
+        switch (toneMapping)
+        {
+        case ToneMapping::Reinhard:
+            return Div(c, Add(c, Splat(1.f)));
+
+        case ToneMapping::Aces:
+            return Div(Mul(c, Add(Mul(c, Splat(2.51f)), Splat(0.03f))), Add(Mul(c, Add(Mul(c, Splat(2.43f)), Splat(0.59f))), Splat(0.14f)));
+
+        default:
+            return c;
+        }
+    }
+}
 
 Framebuffer::Framebuffer(const FramebufferFormat format_):
     format{format_}, width{0}, height{0}
@@ -16,7 +55,10 @@ void Framebuffer::Resize(const int width, const int height)
     }
     this->width = width;
     this->height = height;
-    data.resize(width * width * 4);
+    data.resize(width * height * 4);
+    accumulation.resize(width * height);
+    sampleCounts.resize(width * height);
+    Clear();
 }
 
 void Framebuffer::SetPixel(const int x, const int y, const Math::Vector& color)
@@ -27,25 +69,121 @@ void Framebuffer::SetPixel(const int x, const int y, const Math::Vector& color)
         return;
     }
 
-    // BGRA
-    if (format == FramebufferFormat::BGRA8)
+    const int offset = x + y * width;
+    accumulation[offset] = color;
+    sampleCounts[offset] = 1.f;
+}
+
+void Framebuffer::AddSample(const int x, const int y, const Math::Vector& color)
+{
+    // Out of range arguments.
+    if (x < 0 || x >= width || y < 0 || y >= height)
     {
-        const int offset = 4 * (x + y * width);
-        data[offset + 0] = Math::Unorm(color.z); // B
-        data[offset + 1] = Math::Unorm(color.y); // G
-        data[offset + 2] = Math::Unorm(color.x); // R
-        data[offset + 3] = Math::Unorm(color.w); // A
         return;
     }
-    
-    // RGBA
-    if (format == FramebufferFormat::RGBA8)
+
+    const int offset = x + y * width;
+    accumulation[offset] += color;
+    sampleCounts[offset] += 1.f;
+}
+
+Math::Vector Framebuffer::Color(const int x, const int y) const
+{
+    // Out of range arguments.
+    if (x < 0 || x >= width || y < 0 || y >= height)
+    {
+        return Math::Vector();
+    }
+
+    // Same mean as in Resolve().
+    const int offset = x + y * width;
+    const float count = sampleCounts[offset];
+    return accumulation[offset] * (count > 0.f ? 1.f / count : 0.f);
+}
+
+void Framebuffer::Clear()
+{
+    std::fill(accumulation.begin(), accumulation.end(), Math::Vector());
+    std::fill(sampleCounts.begin(), sampleCounts.end(), 0.f);
+    frameId = 0;
+}
+
+void Framebuffer::CopyFrom(const Framebuffer& other)
+{
+    if (&other == this || other.format != format)
     {
-        const int offset = 4 * (x + y * width);
-        data[offset + 0] = Math::Unorm(color.x); // R
-        data[offset + 1] = Math::Unorm(color.y); // G
-        data[offset + 2] = Math::Unorm(color.z); // B
-        data[offset + 3] = Math::Unorm(color.w); // A
         return;
     }
-}
\ No newline at end of file
+
+    width = other.width;
+    height = other.height;
+    data = other.data;
+    accumulation = other.accumulation;
+    sampleCounts = other.sampleCounts;
+    frameId = other.frameId;
+}
+
+void Framebuffer::SetResolveSettings(const ResolveSettings& settings)
+{
+    resolveSettings = settings;
+
+    if (settings.srgb && srgbTable.empty())
+    {
+        srgbTable.resize(SrgbTableSize);
+        for (int i = 0; i < SrgbTableSize; ++i)
+        {
+            const float value = static_cast<float>(i) / static_cast<float>(SrgbTableSize - 1);
+            srgbTable[i] = static_cast<uint8_t>(SrgbEncode(value) * 255.f + 0.5f);
+        }
+    }
+}
+
+void Framebuffer::Resolve(const int y0, const int y1)
+{
+    using namespace Math::Simd4;
+
+    const int first = std::max(y0, 0);
+    const int last = std::min(y1, height);
+    const float exposure = resolveSettings.exposure;
+    const ToneMapping toneMapping = resolveSettings.toneMapping;
+    const bool srgb = resolveSettings.srgb;
+    const bool bgra = (format == FramebufferFormat::BGRA8);
+
+    for (int y = first; y < last; ++y)
+    {
+        const Math::Vector* const colors = accumulation.data() + y * width;
+        const float* const counts = sampleCounts.data() + y * width;
+        uint8_t* const row = data.data() + 4 * y * width;
+
+        for (int x = 0; x < width; ++x)
+        {
+            // Mean of the samples, pixels without samples are black.
+            const float count = counts[x];
+            const float scale = count > 0.f ? 1.f / count : 0.f;
+            const Float4 mean = Mul(Load(&colors[x].x), Splat(scale));
+
+            Float4 color = WithAlpha(ToneMap(Mul(mean, Splat(exposure)), toneMapping), mean);
+            if (bgra)
+            {
+                color = Swizzle<2, 1, 0, 3>(color);
+            }
+
+            uint32_t packed = PackUnorm8(color);
+            if (srgb)
+            {
+                // The color channels go through the table, the alpha stays linear.
+                alignas(16) float values[4];
+                Store(values, color);
+                for (int i = 0; i < 3; ++i)
+                {
+                    const float value = Math::Clamp(values[i], 0.f, 1.f);
+                    const uint32_t encoded = srgbTable[static_cast<int>(value * static_cast<float>(SrgbTableSize - 1) + 0.5f)];
+                    packed = (packed & ~(0xffu << (8 * i))) | (encoded << (8 * i));
+                }
+            }
+
+            // Byte order of the little-endian targets.
+            std::memcpy(row + 4 * x, &packed, 4);
+        }
+    }
+}
@@ -10,6 +10,31 @@ enum class FramebufferFormat
     BGRA8
 };
 
+enum class ToneMapping
+{
+    // Colors are clamped to [0; 1].
+    Clamp,
+
+    // c / (1 + c)
+    Reinhard,
+
+    // Filmic curve, Narkowicz fit of the ACES reference transform.
+    Aces
+};
+
+// Conversion of the accumulated colors to the 8-bit pixels.
+// The defaults store the clamped linear colors.
+struct ResolveSettings
+{
+    // Colors are multiplied by the exposure before the tone mapping, the alpha is not changed.
+    float exposure = 1.f;
+    ToneMapping toneMapping = ToneMapping::Clamp;
+
+    // Encode the colors with the sRGB transfer curve.
+    bool srgb = false;
+};
+
+// Float RGBA accumulation buffer with the 8-bit pixels resolved from it.
 class Framebuffer
 {
 public:
@@ -18,19 +43,60 @@ public:
     Framebuffer(const FramebufferFormat);
 
     // If arguments are invalid, does nothing.
+    // The accumulated samples are cleared.
     void Resize(const int width, const int height);
 
+    // Replace the accumulated samples of the pixel by the color.
     // Out of range pixels are ignored.
+    // Concurrent calls are safe for different pixels.
     void SetPixel(const int x, const int y, const Math::Vector& color);
 
+    // Add a sample to the pixel, the resolved color is the mean of the samples.
+    // Out of range pixels are ignored.
+    // Concurrent calls are safe for different pixels.
+    void AddSample(const int x, const int y, const Math::Vector& color);
+
+    // Mean of the pixel samples, black for the pixels without samples and out of range pixels.
+    Math::Vector Color(const int x, const int y) const;
+
+    // Remove the samples of all pixels, they are resolved to black.
+    void Clear();
+
+    // Copy the size, the samples and the resolved pixels of the framebuffer with the same format.
+    // If the formats differ, does nothing.
+    void CopyFrom(const Framebuffer&);
+
+    // Identifier of the last frame rendered by a raytracer, copies keep it. Resize() and Clear() reset it to 0.
+    // The incremental rendering updates only the framebuffer holding the previous frame.
+    uint64_t FrameId() const { return frameId; }
+    void SetFrameId(const uint64_t id) { frameId = id; }
+
+    void SetResolveSettings(const ResolveSettings&);
+    const ResolveSettings& Resolving() const { return resolveSettings; }
+
+    // Convert the accumulated colors of the rows [y0; y1) to the 8-bit pixels.
+    // Concurrent calls are safe for different rows.
+    void Resolve(const int y0, const int y1);
+    void Resolve() { Resolve(0, height); }
+
     int Width() const { return width; }
     int Height() const { return height; }
 
-    // Get raw data pointer.
-    const uint8_t* const Data() { return data.data(); }
+    // Get raw data pointer, the pixels of the last Resolve() call.
+    const uint8_t* Data() const { return data.data(); }
 
 private:
     int width;
     int height;
     std::vector<uint8_t> data;
-};
\ No newline at end of file
+
+    // Sum of the samples and their count per pixel.
+    std::vector<Math::Vector> accumulation;
+    std::vector<float> sampleCounts;
+
+    ResolveSettings resolveSettings;
+    uint64_t frameId = 0;
+
+    // Linear [0; 1] to the 8-bit sRGB value, indexed by the value scaled to the table size.
+    std::vector<uint8_t> srgbTable;
+};
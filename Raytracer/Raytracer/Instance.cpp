@@ -0,0 +1,102 @@
+#include "Instance.h"
+
+void Instance::Transform() const
+{
+    transformed = geometry;
+    worldScale = scale;
+    toWorld = Math::Matrix::Transformations(position, {scale, scale, scale, 0.f}, rotation);
+    toObject = Math::Matrix::Inverse(toWorld);
+
+    // World bounds enclose the transformed corners of the object bounds.
+    // Instances without geometry or with invalid scale can not be hit.
+    bounds = Math::Box();
+    if (transformed == nullptr || !(scale > 0.f))
+    {
+        transformed = nullptr;
+        return;
+    }
+    const auto box = transformed->Bounds();
+    if (box.Empty())
+    {
+        return;
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+        const Math::Vector corner(
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z,
+            1.f
+        );
+        bounds.Extend(toWorld.Transform(corner));
+    }
+}
+
+Math::Box Instance::Bounds() const
+{
+    return bounds;
+}
+
+Math::Ray Instance::ObjectRay(const Math::Ray& ray) const
+{
+    // The direction is normalized again, so the object distances are the world distances divided by the scale.
+    return Math::Ray(
+        toObject.Transform({ray.origin.x, ray.origin.y, ray.origin.z, 1.f}),
+        toObject.Transform({ray.direction.x, ray.direction.y, ray.direction.z, 0.f})
+    );
+}
+
+float Instance::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
+{
+    if (transformed == nullptr)
+    {
+        return INFINITY;
+    }
+
+    uint32_t triangle = 0;
+    const float objectDistance = transformed->Raycast(ObjectRay(ray), maxDistance / worldScale, triangle);
+    return WorldHit(ray, maxDistance, objectDistance, triangle, output);
+}
+
+float Instance::CountedRaycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output, TraceCounters& counters) const
+{
+    if (transformed == nullptr)
+    {
+        return INFINITY;
+    }
+
+    uint32_t triangle = 0;
+    const float objectDistance = transformed->Raycast(ObjectRay(ray), maxDistance / worldScale, triangle, counters);
+    return WorldHit(ray, maxDistance, objectDistance, triangle, output);
+}
+
+float Instance::WorldHit(const Math::Ray& ray, const float maxDistance, const float objectDistance, const uint32_t triangle, RaycastSample& output) const
+{
+    if (objectDistance == INFINITY)
+    {
+        return INFINITY;
+    }
+
+    // The scaled distance can be rounded up to the maximum.
+    const float t = objectDistance * worldScale;
+    if (t >= maxDistance)
+    {
+        return INFINITY;
+    }
+
+    // The uniform scale does not change the normal direction.
+    output.position = ray.origin + ray.direction * t;
+    output.normal = Math::Vector::Normalized(toWorld.Transform(transformed->Normal(triangle)));
+
+    return t;
+}
+
+bool Instance::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    return transformed != nullptr && transformed->Occluded(ObjectRay(ray), maxDistance / worldScale);
+}
+
+bool Instance::CountedOccluded(const Math::Ray& ray, const float maxDistance, TraceCounters& counters) const
+{
+    return transformed != nullptr && transformed->Occluded(ObjectRay(ray), maxDistance / worldScale, counters);
+}
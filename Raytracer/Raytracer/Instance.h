@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include "Math/Math.h"
+#include "Raytracer/MeshGeometry.h"
+#include "Raytracer/Primitives.h"
+
+// Placement of a shared mesh geometry: position, rotation and uniform scale.
+// The rays are transformed to the object space, so the transformation only updates the matrices
+// and the world bounds, the geometry and its BVH are never touched. Moving an instance refits
+// the scene BVH over the primitives, the top level, like moving any other primitive.
+class Instance: public Primitive
+{
+public:
+    // Shared geometry. Call Invalidate() after changing the geometry.
+    std::shared_ptr<const MeshGeometry> geometry;
+
+    // Uniform scale, setting it marks the instance as changed.
+    void SetScale(const float value) { scale = value; Invalidate(); }
+    float Scale() const { return scale; }
+
+    virtual void Transform() const override;
+    virtual Math::Box Bounds() const override;
+    virtual float Raycast(const Math::Ray&, const float, RaycastSample&) const override;
+    virtual bool Occluded(const Math::Ray&, const float) const override;
+    virtual float CountedRaycast(const Math::Ray&, const float, RaycastSample&, TraceCounters&) const override;
+    virtual bool CountedOccluded(const Math::Ray&, const float, TraceCounters&) const override;
+
+    // Object to world transformation of the last Transform() call.
+    const Math::Matrix& ToWorld() const { return toWorld; }
+
+private:
+    float scale = 1.f;
+
+    // Ray in the object space.
+    Math::Ray ObjectRay(const Math::Ray& ray) const;
+
+    // World hit distance and sample of the object-space hit, INFINITY if it is not nearer than maxDistance.
+    float WorldHit(const Math::Ray& ray, const float maxDistance, const float objectDistance, const uint32_t triangle, RaycastSample& output) const;
+
+    // Object to world and world to object transformations.
+    mutable Math::Matrix toWorld = Math::Matrix::Identity();
+    mutable Math::Matrix toObject = Math::Matrix::Identity();
+    mutable float worldScale = 1.f;
+    mutable Math::Box bounds;
+
+    // Geometry of the last Transform() call.
+    mutable std::shared_ptr<const MeshGeometry> transformed;
+};
@@ -0,0 +1,164 @@
+#include "LightGrid.h"
+#include <algorithm>
+#include "Raytracer/Raytracer.h"
+
+namespace
+{
+    // Target number of cells per light with a finite radius.
+    const int CellsPerLight = 4;
+
+    // Squared distance from the point to the box.
+    float DistanceSq(const Math::Vector& point, const Math::Vector& min, const Math::Vector& max)
+    {
+        const float dx = std::max(std::max(min.x - point.x, point.x - max.x), 0.f);
+        const float dy = std::max(std::max(min.y - point.y, point.y - max.y), 0.f);
+        const float dz = std::max(std::max(min.z - point.z, point.z - max.z), 0.f);
+        return dx * dx + dy * dy + dz * dz;
+    }
+}
+
+const int LightGrid::MaxResolution;
+
+void LightGrid::Build(const std::vector<const Light*>& lights)
+{
+    bounds = Math::Box();
+    cellStart.clear();
+    items.clear();
+    global.clear();
+
+    // Lights which can reach some point, the bounded ones define the grid bounds.
+    std::vector<uint32_t> binned;
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        const Light* const light = lights[i];
+        if (light == nullptr || !(light->radius > 0.f))
+        {
+            continue;
+        }
+        if (light->radius == INFINITY)
+        {
+            global.push_back(static_cast<uint32_t>(i));
+            binned.push_back(static_cast<uint32_t>(i));
+            continue;
+        }
+
+        const Math::Vector extent(light->radius, light->radius, light->radius, 0.f);
+        const Math::Box box(light->position - extent, light->position + extent);
+        if (box.Finite())
+        {
+            bounds.Extend(box);
+            binned.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    const size_t boundedCount = binned.size() - global.size();
+    if (boundedCount == 0)
+    {
+        resolution[0] = resolution[1] = resolution[2] = 0;
+        return;
+    }
+
+    // Cubic cells with the target count, at least one and at most MaxResolution along each axis.
+    const auto size = bounds.Size();
+    const float sizes[3] = {std::max(size.x, 1e-6f), std::max(size.y, 1e-6f), std::max(size.z, 1e-6f)};
+    const float cellCount = static_cast<float>(std::min<size_t>(CellsPerLight * boundedCount, MaxResolution * MaxResolution * MaxResolution));
+    const float cellSize = std::cbrt(sizes[0] * sizes[1] * sizes[2] / cellCount);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        resolution[axis] = std::min(std::max(static_cast<int>(std::ceil(sizes[axis] / cellSize)), 1), MaxResolution);
+        scale[axis] = static_cast<float>(resolution[axis]) / sizes[axis];
+    }
+
+    const int cells = resolution[0] * resolution[1] * resolution[2];
+    const Math::Vector cellExtent(sizes[0] / resolution[0], sizes[1] / resolution[1], sizes[2] / resolution[2], 0.f);
+
+    // Cells are slightly enlarged, so points rounded to a neighbouring cell in Lights() are covered.
+    const Math::Vector slack = cellExtent * 0.001f;
+
+    // Calls visit(cell) for all cells overlapped by the light sphere.
+    const auto forEachCell = [&](const Light& light, auto visit)
+    {
+        if (light.radius == INFINITY)
+        {
+            for (int cell = 0; cell < cells; ++cell)
+            {
+                visit(cell);
+            }
+            return;
+        }
+
+        const int x0 = CellIndex(light.position.x - light.radius, 0);
+        const int x1 = CellIndex(light.position.x + light.radius, 0);
+        const int y0 = CellIndex(light.position.y - light.radius, 1);
+        const int y1 = CellIndex(light.position.y + light.radius, 1);
+        const int z0 = CellIndex(light.position.z - light.radius, 2);
+        const int z1 = CellIndex(light.position.z + light.radius, 2);
+        const float radiusSq = light.radius * light.radius;
+
+        for (int z = z0; z <= z1; ++z)
+        {
+            for (int y = y0; y <= y1; ++y)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    const Math::Vector min(
+                        bounds.min.x + static_cast<float>(x) * cellExtent.x,
+                        bounds.min.y + static_cast<float>(y) * cellExtent.y,
+                        bounds.min.z + static_cast<float>(z) * cellExtent.z,
+                        0.f
+                    );
+                    if (DistanceSq(light.position, min - slack, min + cellExtent + slack) <= radiusSq)
+                    {
+                        visit((z * resolution[1] + y) * resolution[0] + x);
+                    }
+                }
+            }
+        }
+    };
+
+    // Count the cell items, then fill them in the light order.
+    cellStart.assign(cells + 1, 0);
+    for (const uint32_t index : binned)
+    {
+        forEachCell(*lights[index], [&](const int cell) { ++cellStart[cell + 1]; });
+    }
+    for (int cell = 0; cell < cells; ++cell)
+    {
+        cellStart[cell + 1] += cellStart[cell];
+    }
+
+    items.resize(cellStart[cells]);
+    std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+    for (const uint32_t index : binned)
+    {
+        forEachCell(*lights[index], [&](const int cell) { items[fill[cell]++] = index; });
+    }
+}
+
+int LightGrid::CellIndex(const float coordinate, const int axis) const
+{
+    const float offset = (coordinate - bounds.min[axis]) * scale[axis];
+    return std::min(std::max(static_cast<int>(offset), 0), resolution[axis] - 1);
+}
+
+LightGrid::Cell LightGrid::Lights(const Math::Vector& point) const
+{
+    Cell cell;
+
+    // Only the lights with infinite radius reach the points outside of the grid.
+    const bool inside =
+        point.x >= bounds.min.x && point.x <= bounds.max.x &&
+        point.y >= bounds.min.y && point.y <= bounds.max.y &&
+        point.z >= bounds.min.z && point.z <= bounds.max.z;
+    if (!inside || resolution[0] == 0)
+    {
+        cell.first = global.data();
+        cell.last = global.data() + global.size();
+        return cell;
+    }
+
+    const int index = (CellIndex(point.z, 2) * resolution[1] + CellIndex(point.y, 1)) * resolution[0] + CellIndex(point.x, 0);
+    cell.first = items.data() + cellStart[index];
+    cell.last = items.data() + cellStart[index + 1];
+    return cell;
+}
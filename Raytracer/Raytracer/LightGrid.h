@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Math/Math.h"
+
+struct Light;
+
+// World-space uniform grid over the light spheres given by the light position and radius.
+// Each cell lists the lights whose sphere overlaps the cell, so shading a point only visits
+// the lights which can reach it. Lights with infinite radius are listed everywhere,
+// lights with zero radius are never listed.
+class LightGrid
+{
+public:
+    // Light indices of a cell in increasing order.
+    struct Cell
+    {
+        const uint32_t* first = nullptr;
+        const uint32_t* last = nullptr;
+
+        const uint32_t* begin() const { return first; }
+        const uint32_t* end() const { return last; }
+        size_t Size() const { return static_cast<size_t>(last - first); }
+    };
+
+    // Bin the lights, indices refer to the lights array.
+    void Build(const std::vector<const Light*>& lights);
+
+    // Indices of all lights which can reach the point, a superset of the lights in range.
+    Cell Lights(const Math::Vector& point) const;
+
+private:
+    // Maximum number of cells along each axis.
+    static const int MaxResolution = 64;
+
+    // Index of the cell containing the coordinate along the axis.
+    int CellIndex(const float coordinate, const int axis) const;
+
+    Math::Box bounds;
+    int resolution[3] = {0, 0, 0};
+
+    // Number of cells per world unit along each axis.
+    float scale[3] = {0.f, 0.f, 0.f};
+
+    // Items of the cell i are items[cellStart[i]] ... items[cellStart[i + 1] - 1].
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> items;
+
+    // Lights with infinite radius, returned for the points outside of the grid.
+    std::vector<uint32_t> global;
+};
@@ -0,0 +1,213 @@
+#include "MeshGeometry.h"
+
+void MeshGeometry::Build(std::vector<float> x_, std::vector<float> y_, std::vector<float> z_, std::vector<uint32_t> indices_)
+{
+    x = std::move(x_);
+    y = std::move(y_);
+    z = std::move(z_);
+    indices = std::move(indices_);
+
+    // Vertex arrays must have the same size.
+    const size_t vertexCount = std::min(x.size(), std::min(y.size(), z.size()));
+    x.resize(vertexCount);
+    y.resize(vertexCount);
+    z.resize(vertexCount);
+
+    // Remove incomplete triangles and triangles with invalid indices.
+    indices.resize(indices.size() - indices.size() % 3);
+    size_t count = 0;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+        {
+            continue;
+        }
+        indices[count + 0] = indices[i + 0];
+        indices[count + 1] = indices[i + 1];
+        indices[count + 2] = indices[i + 2];
+        count += 3;
+    }
+    indices.resize(count);
+
+    // Build the object-space hierarchy.
+    std::vector<Math::Box> boxes(indices.size() / 3);
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        for (size_t v = 0; v < 3; ++v)
+        {
+            const uint32_t index = indices[3 * i + v];
+            boxes[i].Extend({x[index], y[index], z[index], 0.f});
+        }
+    }
+    bvh.Build(boxes);
+
+    storage.reset();
+    arrays.x = x.data();
+    arrays.y = y.data();
+    arrays.z = z.data();
+    arrays.indices = indices.data();
+    arrays.vertexCount = vertexCount;
+    arrays.triangleCount = boxes.size();
+}
+
+void MeshGeometry::Build(const std::vector<Math::Vector>& vertices, const std::vector<uint32_t>& indices_)
+{
+    std::vector<float> vx(vertices.size());
+    std::vector<float> vy(vertices.size());
+    std::vector<float> vz(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        vx[i] = vertices[i].x;
+        vy[i] = vertices[i].y;
+        vz[i] = vertices[i].z;
+    }
+    Build(std::move(vx), std::move(vy), std::move(vz), indices_);
+}
+
+void MeshGeometry::Assign(const Arrays& arrays_, const Bvh::Node* const nodes, const size_t nodeCount, const uint32_t* const items, const size_t itemCount,
+    std::shared_ptr<const void> storage_)
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    indices.clear();
+    arrays = arrays_;
+    bvh.Assign(nodes, nodeCount, items, itemCount);
+    storage = std::move(storage_);
+}
+
+float MeshGeometry::Raycast(const Math::Ray& ray, const float maxDistance, uint32_t& triangle) const
+{
+    return bvh.Raycast(ray, maxDistance, [&](const uint32_t item, const float itemDistance)
+    {
+        const float t = IntersectTriangle(ray, item, itemDistance);
+        if (t != INFINITY)
+        {
+            triangle = item;
+        }
+        return t;
+    });
+}
+
+bool MeshGeometry::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    return bvh.Occluded(ray, maxDistance, [&](const uint32_t item, const float itemDistance)
+    {
+        return IntersectTriangle(ray, item, itemDistance) != INFINITY;
+    });
+}
+
+float MeshGeometry::Raycast(const Math::Ray& ray, const float maxDistance, uint32_t& triangle, TraceCounters& counters) const
+{
+    // Triangle tests are counted locally, so the counters are not written in the traversal.
+    uint64_t tests = 0;
+    const float t = bvh.Raycast(ray, maxDistance, [&](const uint32_t item, const float itemDistance)
+    {
+        ++tests;
+        const float t = IntersectTriangle(ray, item, itemDistance);
+        if (t != INFINITY)
+        {
+            triangle = item;
+        }
+        return t;
+    }, counters);
+    counters.AddTests(PrimitiveType::Triangle, tests);
+    return t;
+}
+
+bool MeshGeometry::Occluded(const Math::Ray& ray, const float maxDistance, TraceCounters& counters) const
+{
+    uint64_t tests = 0;
+    const bool occluded = bvh.Occluded(ray, maxDistance, [&](const uint32_t item, const float itemDistance)
+    {
+        ++tests;
+        return IntersectTriangle(ray, item, itemDistance) != INFINITY;
+    }, counters);
+    counters.AddTests(PrimitiveType::Triangle, tests);
+    return occluded;
+}
+
+Math::Vector MeshGeometry::Normal(const uint32_t triangle) const
+{
+    const float* const vx = arrays.x;
+    const float* const vy = arrays.y;
+    const float* const vz = arrays.z;
+    const uint32_t* const v = &arrays.indices[3 * triangle];
+    const Math::Vector p0(vx[v[0]], vy[v[0]], vz[v[0]], 0.f);
+    const Math::Vector p1(vx[v[1]], vy[v[1]], vz[v[1]], 0.f);
+    const Math::Vector p2(vx[v[2]], vy[v[2]], vz[v[2]], 0.f);
+    return Math::Vector::Cross(p1 - p0, p2 - p0);
+}
+
+float MeshGeometry::IntersectTriangle(const Math::Ray& ray, const uint32_t item, const float maxDistance) const
+{
+    // Moller-Trumbore intersection, see Math::IntersectTriangle().
+    const float e = 0.0000001f;
+
+    const float ox = ray.origin.x;
+    const float oy = ray.origin.y;
+    const float oz = ray.origin.z;
+    const float dx = ray.direction.x;
+    const float dy = ray.direction.y;
+    const float dz = ray.direction.z;
+
+    const float* const vx = arrays.x;
+    const float* const vy = arrays.y;
+    const float* const vz = arrays.z;
+    const uint32_t* const vi = arrays.indices;
+
+    const uint32_t i0 = vi[3 * item + 0];
+    const uint32_t i1 = vi[3 * item + 1];
+    const uint32_t i2 = vi[3 * item + 2];
+
+    const float p0x = vx[i0];
+    const float p0y = vy[i0];
+    const float p0z = vz[i0];
+
+    const float e1x = vx[i1] - p0x;
+    const float e1y = vy[i1] - p0y;
+    const float e1z = vz[i1] - p0z;
+    const float e2x = vx[i2] - p0x;
+    const float e2y = vy[i2] - p0y;
+    const float e2z = vz[i2] - p0z;
+
+    // h = direction x edge2
+    const float hx = dy * e2z - dz * e2y;
+    const float hy = dz * e2x - dx * e2z;
+    const float hz = dx * e2y - dy * e2x;
+
+    // Back face (a < 0) or a ray parallel to the triangle.
+    const float a = e1x * hx + e1y * hy + e1z * hz;
+    if (a <= e)
+    {
+        return INFINITY;
+    }
+
+    const float f = 1.f / a;
+    const float sx = ox - p0x;
+    const float sy = oy - p0y;
+    const float sz = oz - p0z;
+    const float u = f * (sx * hx + sy * hy + sz * hz);
+    if (u < 0.f || u > 1.f)
+    {
+        return INFINITY;
+    }
+
+    // q = s x edge1
+    const float qx = sy * e1z - sz * e1y;
+    const float qy = sz * e1x - sx * e1z;
+    const float qz = sx * e1y - sy * e1x;
+    const float v = f * (dx * qx + dy * qy + dz * qz);
+    if (v < 0.f || u + v > 1.f)
+    {
+        return INFINITY;
+    }
+
+    const float t = f * (e2x * qx + e2y * qy + e2z * qz);
+    if (t <= e || t >= maxDistance)
+    {
+        return INFINITY;
+    }
+
+    return t;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Math/Math.h"
+#include "Raytracer/Bvh.h"
+#include "Raytracer/TraceCounters.h"
+
+// Indexed triangle geometry with an object-space BVH, the bottom level of the instanced meshes.
+// Vertices are stored in the structure-of-arrays layout. The geometry is immutable after the build,
+// so any number of instances can share it and intersect it concurrently.
+// Back faces are culled like in the Triangle primitive.
+class MeshGeometry
+{
+public:
+    MeshGeometry() = default;
+    MeshGeometry(const MeshGeometry&) = delete;
+    MeshGeometry& operator=(const MeshGeometry&) = delete;
+
+    // Set the geometry and build the BVH.
+    // The indices array contains 3 vertex indices per triangle, invalid triangles are removed.
+    void Build(std::vector<float> x, std::vector<float> y, std::vector<float> z, std::vector<uint32_t> indices);
+    void Build(const std::vector<Math::Vector>& vertices, const std::vector<uint32_t>& indices);
+
+    // Arrays of a built geometry.
+    struct Arrays
+    {
+        const float* x = nullptr;
+        const float* y = nullptr;
+        const float* z = nullptr;
+        const uint32_t* indices = nullptr;
+        size_t vertexCount = 0;
+        size_t triangleCount = 0;
+    };
+
+    // Use the arrays and the BVH stored elsewhere, for example in a mapped file, without copying them.
+    // The arrays must be a valid built geometry, the storage keeps them alive.
+    void Assign(const Arrays& arrays, const Bvh::Node* const nodes, const size_t nodeCount, const uint32_t* const items, const size_t itemCount,
+        std::shared_ptr<const void> storage);
+
+    const Arrays& Data() const { return arrays; }
+    const Bvh& Hierarchy() const { return bvh; }
+
+    size_t VertexCount() const { return arrays.vertexCount; }
+    size_t TriangleCount() const { return arrays.triangleCount; }
+
+    // Object-space bounds, empty without triangles.
+    Math::Box Bounds() const { return bvh.Empty() ? Math::Box() : bvh.Bounds(); }
+
+    // Closest triangle hit of the object-space ray, returns the distance or INFINITY.
+    float Raycast(const Math::Ray& ray, const float maxDistance, uint32_t& triangle) const;
+
+    // Returns true if any triangle is hit nearer than maxDistance.
+    bool Occluded(const Math::Ray& ray, const float maxDistance) const;
+
+    // Raycast() and Occluded() counting the visited nodes and the triangle tests.
+    float Raycast(const Math::Ray& ray, const float maxDistance, uint32_t& triangle, TraceCounters& counters) const;
+    bool Occluded(const Math::Ray& ray, const float maxDistance, TraceCounters& counters) const;
+
+    // Object-space normal of the triangle, not normalized.
+    Math::Vector Normal(const uint32_t triangle) const;
+
+private:
+    // Hit distance of the triangle nearer than maxDistance or INFINITY.
+    float IntersectTriangle(const Math::Ray& ray, const uint32_t triangle, const float maxDistance) const;
+
+    // Owned vertex positions, empty for the assigned geometry.
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    // Three vertex indices per triangle.
+    std::vector<uint32_t> indices;
+
+    // Owned or assigned arrays, and the owner of the assigned arrays.
+    Arrays arrays;
+    std::shared_ptr<const void> storage;
+
+    // Object-space hierarchy over the triangles.
+    Bvh bvh;
+};
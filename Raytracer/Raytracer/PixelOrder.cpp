@@ -0,0 +1,79 @@
+#include "PixelOrder.h"
+#include <utility>
+
+namespace
+{
+    // Even bits of the code compacted to the low 16 bits.
+    uint32_t CompactBits(uint32_t code)
+    {
+        code &= 0x55555555u;
+        code = (code | (code >> 1)) & 0x33333333u;
+        code = (code | (code >> 2)) & 0x0f0f0f0fu;
+        code = (code | (code >> 4)) & 0x00ff00ffu;
+        code = (code | (code >> 8)) & 0x0000ffffu;
+        return code;
+    }
+
+    // Point of the Hilbert curve at the distance along the curve filling the grid.
+    PixelTraversal::Point HilbertPoint(const uint32_t side, uint32_t distance)
+    {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        for (uint32_t s = 1; s < side; s *= 2)
+        {
+            const uint32_t rx = 1 & (distance / 2);
+            const uint32_t ry = 1 & (distance ^ rx);
+
+            // Rotate the quadrant.
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                std::swap(x, y);
+            }
+
+            x += s * rx;
+            y += s * ry;
+            distance /= 4;
+        }
+        return {static_cast<uint16_t>(x), static_cast<uint16_t>(y)};
+    }
+}
+
+const int PixelTraversal::MaxSide;
+
+void PixelTraversal::Build(const PixelOrder order, const int maxSide)
+{
+    grids.clear();
+    for (uint32_t side = 1; ; side *= 2)
+    {
+        std::vector<Point> grid;
+        grid.reserve(side * side);
+        for (uint32_t i = 0; i < side * side; ++i)
+        {
+            switch (order)
+            {
+            case PixelOrder::Morton:
+                grid.push_back({static_cast<uint16_t>(CompactBits(i)), static_cast<uint16_t>(CompactBits(i >> 1))});
+                break;
+
+            case PixelOrder::Hilbert:
+                grid.push_back(HilbertPoint(side, i));
+                break;
+
+            default:
+                grid.push_back({static_cast<uint16_t>(i % side), static_cast<uint16_t>(i / side)});
+                break;
+            }
+        }
+        grids.push_back(std::move(grid));
+
+        if (static_cast<int>(side) >= std::min(maxSide, MaxSide))
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Traversal order of the pixels (or ray packets) within a tile.
+enum class PixelOrder
+{
+    // Row by row.
+    Scanline,
+
+    // Z-order, recursive 2x2 blocks.
+    Morton,
+
+    // Hilbert curve, consecutive points are always neighbours.
+    Hilbert
+};
+
+// Points of square grids with power of two sides in the traversal order.
+// Areas with other dimensions use the smallest grid covering them and skip the points outside,
+// areas larger than the biggest grid are split to the grid blocks visited row by row.
+class PixelTraversal
+{
+public:
+    struct Point
+    {
+        uint16_t x;
+        uint16_t y;
+    };
+
+    // Build the grids up to the side covering maxSide points.
+    void Build(const PixelOrder, const int maxSide);
+
+    // Call visit(x, y) for all points of the width x height area in the traversal order.
+    template <typename Visit>
+    void ForEach(const int width, const int height, Visit visit) const;
+
+private:
+    // Maximum grid side, so the largest grid has 65536 points.
+    static const int MaxSide = 256;
+
+    // Grid with the side 2^i.
+    std::vector<std::vector<Point>> grids;
+};
+
+template <typename Visit>
+void PixelTraversal::ForEach(const int width, const int height, Visit visit) const
+{
+    // Smallest grid covering the area.
+    size_t index = 0;
+    while (index + 1 < grids.size() && (1 << index) < std::max(width, height))
+    {
+        ++index;
+    }
+    const int side = 1 << index;
+    const std::vector<Point>& grid = grids[index];
+
+    for (int by = 0; by < height; by += side)
+    {
+        for (int bx = 0; bx < width; bx += side)
+        {
+            for (const Point& point : grid)
+            {
+                const int x = bx + point.x;
+                const int y = by + point.y;
+                if (x < width && y < height)
+                {
+                    visit(x, y);
+                }
+            }
+        }
+    }
+}
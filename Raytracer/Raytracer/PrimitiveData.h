@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Math/Math.h"
+#include "Math/Simd.h"
+#include "Raytracer/RayPacket.h"
+
+class Primitive;
+
+// Output of the Primitive::Raycast() call.
+struct RaycastSample
+{
+    Math::Vector position;
+    Math::Vector normal;
+};
+
+// Output of the Primitive::Raycast() call for ray packets.
+struct alignas(32) PacketHit
+{
+    // Hit distances. Before the raycast they contain the maximum distances,
+    // inactive lanes are set to -INFINITY.
+    float distance[RayPacket::Size];
+
+    RaycastSample sample[RayPacket::Size];
+    const Primitive* primitive[RayPacket::Size];
+};
+
+// Packet rays loaded to the SIMD registers.
+struct PacketRegisters
+{
+    Math::Simd::Float ox, oy, oz, ow;
+    Math::Simd::Float dx, dy, dz, dw;
+
+    explicit PacketRegisters(const RayPacket& packet);
+};
+
+// Type of the world-space primitive data intersected without virtual calls, see Accelerator.
+// Generic primitives are intersected by the virtual Primitive::Raycast() calls.
+enum class PrimitiveType
+{
+    Triangle,
+    Sphere,
+    Plane,
+    Generic
+};
+
+// The data structures below hold the transformed primitives and their intersection kernels.
+// Packet kernels update the hit lanes with the source primitive, the results are bit-identical
+// with the single ray kernels. Occluded() kernels accept the same hits as Raycast() without
+// computing the sample.
+
+struct TriangleData
+{
+    Math::Vector w0, w1, w2;
+    Math::Vector normal;
+
+    // Set the vertices and precompute the normal.
+    void Set(const Math::Vector& w0, const Math::Vector& w1, const Math::Vector& w2);
+
+    Math::Box Bounds() const;
+    float Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const;
+    bool Occluded(const Math::Ray& ray, const float maxDistance) const;
+    void Raycast(const PacketRegisters& packet, PacketHit& hit, const Primitive* const source) const;
+};
+
+struct SphereData
+{
+    Math::Vector position;
+    float radius = 0.f;
+
+    Math::Box Bounds() const;
+    float Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const;
+    bool Occluded(const Math::Ray& ray, const float maxDistance) const;
+    void Raycast(const PacketRegisters& packet, PacketHit& hit, const Primitive* const source) const;
+};
+
+struct PlaneData
+{
+    Math::Plane plane;
+
+    float Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const;
+    bool Occluded(const Math::Ray& ray, const float maxDistance) const;
+    void Raycast(const PacketRegisters& packet, PacketHit& hit, const Primitive* const source) const;
+};
+
+// Include implementation file.
+#include "PrimitiveData.inl"
@@ -0,0 +1,368 @@
+#pragma once
+
+namespace PrimitiveDataDetail
+{
+    using namespace Math::Simd;
+
+    // Mask of the lanes with the maximum distance set to -INFINITY.
+    inline Float Inactive(const Float maxDistance)
+    {
+        return Equal(maxDistance, Splat(-INFINITY));
+    }
+
+    // Store the hit distance and the sample position of the hit lanes.
+    inline void StoreHits(const PacketRegisters& r, const int bits, const Float t, const Primitive* const primitive, PacketHit& hit)
+    {
+        if (bits == 0)
+        {
+            return;
+        }
+
+        alignas(32) float distance[RayPacket::Size];
+        alignas(32) float x[RayPacket::Size];
+        alignas(32) float y[RayPacket::Size];
+        alignas(32) float z[RayPacket::Size];
+        alignas(32) float w[RayPacket::Size];
+        Store(distance, t);
+        Store(x, Add(r.ox, Mul(r.dx, t)));
+        Store(y, Add(r.oy, Mul(r.dy, t)));
+        Store(z, Add(r.oz, Mul(r.dz, t)));
+        Store(w, Add(r.ow, Mul(r.dw, t)));
+
+        for (int lane = 0; lane < RayPacket::Size; ++lane)
+        {
+            if (bits & (1 << lane))
+            {
+                hit.distance[lane] = distance[lane];
+                hit.sample[lane].position.Set(x[lane], y[lane], z[lane], w[lane]);
+                hit.primitive[lane] = primitive;
+            }
+        }
+    }
+
+    // Store the same normal to the hit lanes.
+    inline void StoreNormal(const int bits, const Math::Vector& normal, PacketHit& hit)
+    {
+        for (int lane = 0; lane < RayPacket::Size; ++lane)
+        {
+            if (bits & (1 << lane))
+            {
+                hit.sample[lane].normal = normal;
+            }
+        }
+    }
+}
+
+// Packet registers.
+
+inline PacketRegisters::PacketRegisters(const RayPacket& packet):
+    ox{Math::Simd::Load(packet.originX)}, oy{Math::Simd::Load(packet.originY)}, oz{Math::Simd::Load(packet.originZ)}, ow{Math::Simd::Load(packet.originW)},
+    dx{Math::Simd::Load(packet.directionX)}, dy{Math::Simd::Load(packet.directionY)}, dz{Math::Simd::Load(packet.directionZ)}, dw{Math::Simd::Load(packet.directionW)}
+{}
+
+// Triangle.
+
+inline void TriangleData::Set(const Math::Vector& w0_, const Math::Vector& w1_, const Math::Vector& w2_)
+{
+    w0 = w0_;
+    w1 = w1_;
+    w2 = w2_;
+    normal = Math::Vector::Normal(w1 - w0, w2 - w0);
+}
+
+inline Math::Box TriangleData::Bounds() const
+{
+    Math::Box box;
+    box.Extend(w0);
+    box.Extend(w1);
+    box.Extend(w2);
+    return box;
+}
+
+inline float TriangleData::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
+{
+    // Backface culling.
+    if (ray.direction * normal >= 0.f)
+    {
+        return INFINITY;
+    }
+
+    // Intersection distance.
+    const float t = Math::IntersectTriangle(ray, w0, w1, w2);
+
+    if (t >= maxDistance)
+    {
+        return INFINITY;
+    }
+
+    // Set output values.
+    output.position = ray.origin + ray.direction * t;
+    output.normal = normal;
+
+    return t;
+}
+
+inline bool TriangleData::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    // Backface culling.
+    if (ray.direction * normal >= 0.f)
+    {
+        return false;
+    }
+
+    return Math::IntersectTriangle(ray, w0, w1, w2) < maxDistance;
+}
+
+inline void TriangleData::Raycast(const PacketRegisters& r, PacketHit& hit, const Primitive* const source) const
+{
+    using namespace Math::Simd;
+    using namespace PrimitiveDataDetail;
+
+    // Same operations in the same order as Raycast() and Math::IntersectTriangle().
+    const Float maxDistance = Load(hit.distance);
+
+    // Backface culling.
+    Float miss = Or(Inactive(maxDistance), GreaterEqual(Dot(r.dx, r.dy, r.dz, r.dw, Splat(normal.x), Splat(normal.y), Splat(normal.z), Splat(normal.w)), Splat(0.f)));
+    if (Bits(miss) == RayPacket::AllLanes)
+    {
+        return;
+    }
+
+    const Float e = Splat(0.0000001f);
+    const Float zero = Splat(0.f);
+    const Float one = Splat(1.f);
+
+    const Math::Vector edge1 = w1 - w0;
+    const Math::Vector edge2 = w2 - w0;
+    const Float e1x = Splat(edge1.x), e1y = Splat(edge1.y), e1z = Splat(edge1.z), e1w = Splat(edge1.w);
+    const Float e2x = Splat(edge2.x), e2y = Splat(edge2.y), e2z = Splat(edge2.z), e2w = Splat(edge2.w);
+
+    // h = Cross(direction, edge2)
+    const Float hx = Sub(Mul(r.dy, e2z), Mul(r.dz, e2y));
+    const Float hy = Sub(Mul(r.dz, e2x), Mul(r.dx, e2z));
+    const Float hz = Sub(Mul(r.dx, e2y), Mul(r.dy, e2x));
+
+    // s = origin - p0
+    const Float sx = Sub(r.ox, Splat(w0.x));
+    const Float sy = Sub(r.oy, Splat(w0.y));
+    const Float sz = Sub(r.oz, Splat(w0.z));
+    const Float sw = Sub(r.ow, Splat(w0.w));
+
+    // q = Cross(s, edge1)
+    const Float qx = Sub(Mul(sy, e1z), Mul(sz, e1y));
+    const Float qy = Sub(Mul(sz, e1x), Mul(sx, e1z));
+    const Float qz = Sub(Mul(sx, e1y), Mul(sy, e1x));
+
+    const Float a = Dot(e1x, e1y, e1z, e1w, hx, hy, hz, zero);
+    miss = Or(miss, And(Less(a, e), Greater(a, Sub(zero, e))));
+
+    const Float f = Div(one, a);
+    const Float u = Mul(f, Dot(sx, sy, sz, sw, hx, hy, hz, zero));
+    miss = Or(miss, Or(Less(u, zero), Greater(u, one)));
+
+    const Float v = Mul(f, Dot(r.dx, r.dy, r.dz, r.dw, qx, qy, qz, zero));
+    miss = Or(miss, Or(Less(v, zero), Greater(Add(u, v), one)));
+
+    const Float t = Mul(f, Dot(e2x, e2y, e2z, e2w, qx, qy, qz, zero));
+    miss = Or(miss, LessEqual(t, e));
+    miss = Or(miss, GreaterEqual(t, maxDistance));
+
+    const int bits = ~Bits(miss) & RayPacket::AllLanes;
+    StoreHits(r, bits, t, source, hit);
+    StoreNormal(bits, normal, hit);
+}
+
+// Sphere.
+
+inline Math::Box SphereData::Bounds() const
+{
+    const Math::Vector extent(radius, radius, radius, 0.f);
+    return Math::Box(position - extent, position + extent);
+}
+
+inline float SphereData::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
+{
+    // Intersection distance.
+    const float t = Math::IntersectSphere(ray, position, radius);
+
+    if (t >= maxDistance)
+    {
+        return INFINITY;
+    }
+
+    const auto point = ray.origin + ray.direction * t;
+    const auto normal = Math::Vector::Normalized(point - position);
+
+    // Backface culling.
+    if (ray.direction * normal >= 0.f)
+    {
+        return INFINITY;
+    }
+
+    // Set output values.
+    output.position = point;
+    output.normal = normal;
+
+    return t;
+}
+
+inline bool SphereData::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    const float t = Math::IntersectSphere(ray, position, radius);
+
+    if (t >= maxDistance)
+    {
+        return false;
+    }
+
+    // Backface culling, the sign does not depend on the normal length.
+    return ray.direction * (ray.origin + ray.direction * t - position) < 0.f;
+}
+
+inline void SphereData::Raycast(const PacketRegisters& r, PacketHit& hit, const Primitive* const source) const
+{
+    using namespace Math::Simd;
+    using namespace PrimitiveDataDetail;
+
+    // Same operations in the same order as Raycast() and Math::IntersectSphere().
+    const Float maxDistance = Load(hit.distance);
+    const Float zero = Splat(0.f);
+
+    const Float radius2 = Splat(radius * radius);
+    const Float px = Splat(position.x), py = Splat(position.y), pz = Splat(position.z), pw = Splat(position.w);
+
+    // L = position - origin
+    const Float lx = Sub(px, r.ox);
+    const Float ly = Sub(py, r.oy);
+    const Float lz = Sub(pz, r.oz);
+    const Float lw = Sub(pw, r.ow);
+
+    const Float tca = Dot(lx, ly, lz, lw, r.dx, r.dy, r.dz, r.dw);
+    Float miss = Or(Inactive(maxDistance), Less(tca, zero));
+    if (Bits(miss) == RayPacket::AllLanes)
+    {
+        return;
+    }
+
+    const Float d2 = Sub(Dot(lx, ly, lz, lw, lx, ly, lz, lw), Mul(tca, tca));
+    miss = Or(miss, Greater(d2, radius2));
+
+    const Float thc = Sqrt(Sub(radius2, d2));
+    Float t0 = Sub(tca, thc);
+    Float t1 = Add(tca, thc);
+
+    const Float swap = Greater(t0, t1);
+    const Float t = Select(swap, t1, t0);
+    t1 = Select(swap, t0, t1);
+    t0 = t;
+
+    // If t0 is negative, use t1 instead.
+    t0 = Select(Less(t0, zero), t1, t0);
+    miss = Or(miss, Less(t0, zero));
+    miss = Or(miss, GreaterEqual(t0, maxDistance));
+
+    // Normal and backface culling.
+    const Float nx = Sub(Add(r.ox, Mul(r.dx, t0)), px);
+    const Float ny = Sub(Add(r.oy, Mul(r.dy, t0)), py);
+    const Float nz = Sub(Add(r.oz, Mul(r.dz, t0)), pz);
+    const Float nw = Sub(Add(r.ow, Mul(r.dw, t0)), pw);
+    // Math::Vector::Normalize() divides by the length unless it is zero.
+    const Float length = Sqrt(Dot(nx, ny, nz, nw, nx, ny, nz, nw));
+    const Float nonZero = NotEqual(length, zero);
+    const Float normalX = Select(nonZero, Div(nx, length), nx);
+    const Float normalY = Select(nonZero, Div(ny, length), ny);
+    const Float normalZ = Select(nonZero, Div(nz, length), nz);
+    const Float normalW = Select(nonZero, Div(nw, length), nw);
+    miss = Or(miss, GreaterEqual(Dot(r.dx, r.dy, r.dz, r.dw, normalX, normalY, normalZ, normalW), zero));
+
+    const int bits = ~Bits(miss) & RayPacket::AllLanes;
+    StoreHits(r, bits, t0, source, hit);
+    if (bits == 0)
+    {
+        return;
+    }
+
+    alignas(32) float x[RayPacket::Size];
+    alignas(32) float y[RayPacket::Size];
+    alignas(32) float z[RayPacket::Size];
+    alignas(32) float w[RayPacket::Size];
+    Store(x, normalX);
+    Store(y, normalY);
+    Store(z, normalZ);
+    Store(w, normalW);
+    for (int lane = 0; lane < RayPacket::Size; ++lane)
+    {
+        if (bits & (1 << lane))
+        {
+            hit.sample[lane].normal.Set(x[lane], y[lane], z[lane], w[lane]);
+        }
+    }
+}
+
+// Plane.
+
+inline float PlaneData::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
+{
+    const auto normal = plane.Normal();
+
+    // Backface culling.
+    if (ray.direction * normal >= 0.f)
+    {
+        return INFINITY;
+    }
+
+    // Intersection distance, ray origins behind the plane give negative distances.
+    const float t = Math::IntersectPlane(ray, plane);
+
+    if (t < 0.f || t >= maxDistance)
+    {
+        return INFINITY;
+    }
+
+    // Set output values.
+    output.position = ray.origin + ray.direction * t;
+    output.normal = normal;
+
+    return t;
+}
+
+inline bool PlaneData::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    // Backface culling.
+    if (ray.direction * plane.Normal() >= 0.f)
+    {
+        return false;
+    }
+
+    const float t = Math::IntersectPlane(ray, plane);
+    return t >= 0.f && t < maxDistance;
+}
+
+inline void PlaneData::Raycast(const PacketRegisters& r, PacketHit& hit, const Primitive* const source) const
+{
+    using namespace Math::Simd;
+    using namespace PrimitiveDataDetail;
+
+    // Same operations in the same order as Raycast() and Math::IntersectPlane().
+    const Float maxDistance = Load(hit.distance);
+    const Float zero = Splat(0.f);
+
+    const Float px = Splat(plane.x), py = Splat(plane.y), pz = Splat(plane.z), pw = Splat(plane.w);
+
+    // Backface culling.
+    Float miss = Or(Inactive(maxDistance), GreaterEqual(Dot(r.dx, r.dy, r.dz, r.dw, px, py, pz, zero), zero));
+    if (Bits(miss) == RayPacket::AllLanes)
+    {
+        return;
+    }
+
+    const Float d = Dot(px, py, pz, pw, r.dx, r.dy, r.dz, r.dw);
+    miss = Or(miss, Equal(d, zero));
+
+    const Float t = Div(Negate(Dot(px, py, pz, pw, r.ox, r.oy, r.oz, Splat(1.f))), d);
+    miss = Or(miss, Or(Less(t, zero), GreaterEqual(t, maxDistance)));
+
+    const int bits = ~Bits(miss) & RayPacket::AllLanes;
+    StoreHits(r, bits, t, source, hit);
+    StoreNormal(bits, plane.Normal(), hit);
+}
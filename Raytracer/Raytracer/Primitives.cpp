@@ -1,68 +1,99 @@
 #include "Primitives.h"
 #include "Math/Math.h"
 
+// Primitive.
+
+void Primitive::Raycast(const RayPacket& packet, PacketHit& hit) const
+{
+    RaycastSample sample;
+    for (int lane = 0; lane < RayPacket::Size; ++lane)
+    {
+        if (hit.distance[lane] == -INFINITY)
+        {
+            continue;
+        }
+        const float t = Raycast(*packet.rays[lane], hit.distance[lane], sample);
+        if (t != INFINITY)
+        {
+            hit.distance[lane] = t;
+            hit.sample[lane] = sample;
+            hit.primitive[lane] = this;
+        }
+    }
+}
+
+bool Primitive::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    RaycastSample sample;
+    return Raycast(ray, maxDistance, sample) != INFINITY;
+}
+
+float Primitive::CountedRaycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output, TraceCounters& counters) const
+{
+    counters.Test(Type());
+    return Raycast(ray, maxDistance, output);
+}
+
+bool Primitive::CountedOccluded(const Math::Ray& ray, const float maxDistance, TraceCounters& counters) const
+{
+    counters.Test(Type());
+    return Occluded(ray, maxDistance);
+}
+
 // Triangle.
 
 void Triangle::Transform() const
 {
     const auto transformations = Math::Matrix::Transformations(position, {1.f, 1.f, 1.f, 0.f}, rotation);
-    w0 = transformations.Transform(v0);
-    w1 = transformations.Transform(v1);
-    w2 = transformations.Transform(v2);
+    data.Set(transformations.Transform(v0), transformations.Transform(v1), transformations.Transform(v2));
 }
 
-float Triangle::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
+Math::Box Triangle::Bounds() const
 {
-    // Normal vector.
-    const auto normal = Math::Vector::Normal(w1 - w0, w2 - w0);
-
-    // Backface culling.
-    if (ray.direction * normal >= 0.f)
-    {
-        return INFINITY;
-    }
-
-    // Intersection distance.
-    const float t = Math::IntersectTriangle(ray, w0, w1, w2);
+    return data.Bounds();
+}
 
-    if (t >= maxDistance)
-    {
-        return INFINITY;
-    }
+float Triangle::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
+{
+    return data.Raycast(ray, maxDistance, output);
+}
 
-    // Set output values.
-    output.position = ray.origin + ray.direction * t;
-    output.normal = normal;
+void Triangle::Raycast(const RayPacket& packet, PacketHit& hit) const
+{
+    data.Raycast(PacketRegisters(packet), hit, this);
+}
 
-    return t;
+bool Triangle::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    return data.Occluded(ray, maxDistance);
 }
 
 // Sphere.
 
-float Sphere::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
+void Sphere::Transform() const
 {
-    // Intersection distance.
-    const float t = Math::IntersectSphere(ray, position, radius);
-
-    if (t >= maxDistance)
-    {
-        return INFINITY;
-    }
+    data.position = position;
+    data.radius = radius;
+}
 
-    const auto point = ray.origin + ray.direction * t;
-    const auto normal = Math::Vector::Normalized(point - position);
+Math::Box Sphere::Bounds() const
+{
+    return data.Bounds();
+}
 
-    // Backface culling.
-    if (ray.direction * normal >= 0.f)
-    {
-        return INFINITY;
-    }
+float Sphere::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
+{
+    return data.Raycast(ray, maxDistance, output);
+}
 
-    // Set output values.
-    output.position = point;
-    output.normal = normal;
+void Sphere::Raycast(const RayPacket& packet, PacketHit& hit) const
+{
+    data.Raycast(PacketRegisters(packet), hit, this);
+}
 
-    return t;
+bool Sphere::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    return data.Occluded(ray, maxDistance);
 }
 
 // Plane.
@@ -71,31 +102,20 @@ void Plane::Transform() const
 {
     const auto transformations = Math::Matrix::Rotation(rotation);
     const auto normal = transformations.Transform({0.f, 1.f, 0.f, 0.f});
-    p = Math::Plane(position, normal);
+    data.plane = Math::Plane(position, normal);
 }
 
 float Plane::Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const
 {
-    //const Math::Plane plane(position, normal);
-    const auto normal = p.Normal();
-
-    // Backface culling.
-    if (ray.direction * normal >= 0.f)
-    {
-        return INFINITY;
-    }
-
-    // Intersection distance.
-    const float t = Math::IntersectPlane(ray, p);
-
-    if (t >= maxDistance)
-    {
-        return INFINITY;
-    }
+    return data.Raycast(ray, maxDistance, output);
+}
 
-    // Set output values.
-    output.position = ray.origin + ray.direction * t;
-    output.normal = normal;
+void Plane::Raycast(const RayPacket& packet, PacketHit& hit) const
+{
+    data.Raycast(PacketRegisters(packet), hit, this);
+}
 
-    return t;
+bool Plane::Occluded(const Math::Ray& ray, const float maxDistance) const
+{
+    return data.Occluded(ray, maxDistance);
 }
\ No newline at end of file
@@ -1,13 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include "Math/Math.h"
-
-// Output of the Primitive::Raycast() call.
-struct RaycastSample
-{
-    Math::Vector position;
-    Math::Vector normal;
-};
+#include "Raytracer/PrimitiveData.h"
+#include "Raytracer/RayPacket.h"
+#include "Raytracer/TraceCounters.h"
 
 // Interface for all renderable primitives.
 class Primitive
@@ -22,7 +19,39 @@ public:
     // Apply precomputations before the rendering.
     virtual void Transform() const { };
 
+    // Mark the primitive as changed. Call it after changing other properties
+    // than the position and rotation (vertices, radius, geometry).
+    // The accelerators transform the primitive again if its position, rotation or version changed.
+    void Invalidate() const { ++version; }
+    uint32_t Version() const { return version; }
+
+    // World-space bounding box, valid after the Transform() call.
+    // Unbounded primitives return Math::Box::Infinite().
+    virtual Math::Box Bounds() const { return Math::Box::Infinite(); }
+
     virtual float Raycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output) const = 0;
+
+    // Any-hit query for the shadow rays. Returns true if Raycast() would hit the primitive
+    // nearer than maxDistance, the sample is not computed.
+    // Default implementation calls Raycast() with a temporary sample.
+    virtual bool Occluded(const Math::Ray& ray, const float maxDistance) const;
+
+    // Raycast all packet rays. Lanes with a hit nearer than the hit distance are updated.
+    // The result is bit-identical with the single ray Raycast() call.
+    // Default implementation calls Raycast() for each lane.
+    virtual void Raycast(const RayPacket& packet, PacketHit& hit) const;
+
+    // Raycast() and Occluded() of the instrumented rendering, counting the work of the query.
+    // Default implementations count one intersection test of the Type().
+    virtual float CountedRaycast(const Math::Ray& ray, const float maxDistance, RaycastSample& output, TraceCounters& counters) const;
+    virtual bool CountedOccluded(const Math::Ray& ray, const float maxDistance, TraceCounters& counters) const;
+
+    // Type of the data returned by Data() of the derived class, generic primitives have no data.
+    virtual PrimitiveType Type() const { return PrimitiveType::Generic; }
+
+private:
+    // Number of the Invalidate() calls.
+    mutable uint32_t version = 0;
 };
 
 class Triangle: public Primitive
@@ -31,11 +60,17 @@ public:
     Math::Vector v0, v1, v2;
 
     virtual void Transform() const override;
+    virtual Math::Box Bounds() const override;
     virtual float Raycast(const Math::Ray&, const float, RaycastSample&) const override;
+    virtual void Raycast(const RayPacket&, PacketHit&) const override;
+    virtual bool Occluded(const Math::Ray&, const float) const override;
+    virtual PrimitiveType Type() const override { return PrimitiveType::Triangle; }
 
-private:
     // Transformed vertices.
-    mutable Math::Vector w0, w1, w2;
+    const TriangleData& Data() const { return data; }
+
+private:
+    mutable TriangleData data;
 };
 
 class Sphere: public Primitive
@@ -43,7 +78,18 @@ class Sphere: public Primitive
 public:
     float radius = 0.f;
 
+    virtual void Transform() const override;
+    virtual Math::Box Bounds() const override;
     virtual float Raycast(const Math::Ray&, const float, RaycastSample&) const override;
+    virtual void Raycast(const RayPacket&, PacketHit&) const override;
+    virtual bool Occluded(const Math::Ray&, const float) const override;
+    virtual PrimitiveType Type() const override { return PrimitiveType::Sphere; }
+
+    // Position and radius of the last transformation.
+    const SphereData& Data() const { return data; }
+
+private:
+    mutable SphereData data;
 };
 
 class Plane: public Primitive
@@ -51,7 +97,13 @@ class Plane: public Primitive
 public:
     virtual void Transform() const override;
     virtual float Raycast(const Math::Ray&, const float, RaycastSample&) const override;
+    virtual void Raycast(const RayPacket&, PacketHit&) const override;
+    virtual bool Occluded(const Math::Ray&, const float) const override;
+    virtual PrimitiveType Type() const override { return PrimitiveType::Plane; }
+
+    // Transformed plane.
+    const PlaneData& Data() const { return data; }
 
 private:
-    mutable Math::Plane p;
+    mutable PlaneData data;
 };
\ No newline at end of file
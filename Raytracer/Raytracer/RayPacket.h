@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Math/Math.h"
+#include "Math/Simd.h"
+
+// Coherent rays in the structure-of-arrays layout, one ray per SIMD lane.
+struct alignas(32) RayPacket
+{
+    static const int Size = Math::Simd::Width;
+
+    // Bit mask with all lanes set.
+    static const int AllLanes = (1 << Size) - 1;
+
+    // Primary ray packets cover blocks of Width x Height pixels.
+    static const int Width = Size / 2;
+    static const int Height = 2;
+
+    float originX[Size];
+    float originY[Size];
+    float originZ[Size];
+    float originW[Size];
+    float directionX[Size];
+    float directionY[Size];
+    float directionZ[Size];
+    float directionW[Size];
+
+    // Source rays used by the scalar fallback.
+    const Math::Ray* rays[Size];
+
+    // Store the ray to the lane. The ray must outlive the packet.
+    void Set(const int lane, const Math::Ray& ray)
+    {
+        originX[lane] = ray.origin.x;
+        originY[lane] = ray.origin.y;
+        originZ[lane] = ray.origin.z;
+        originW[lane] = ray.origin.w;
+        directionX[lane] = ray.direction.x;
+        directionY[lane] = ray.direction.y;
+        directionZ[lane] = ray.direction.z;
+        directionW[lane] = ray.direction.w;
+        rays[lane] = &ray;
+    }
+};
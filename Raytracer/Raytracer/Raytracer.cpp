@@ -1,125 +1,1090 @@
 #include "Raytracer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define RAYTRACER_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RAYTRACER_RDTSC
+#endif
 
-Raytracer::Raytracer()
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Identifiers of the rendered frames, unique over all raytracers.
+    std::atomic<uint64_t> lastFrameId(0);
+
+    // Seconds elapsed since the start.
+    double Elapsed(const Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Time stamp counter of the instrumented pixels, nanoseconds where it is not available.
+    uint64_t Cycles()
+    {
+#ifdef RAYTRACER_RDTSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    // Pseudo-random number in [0; 1) hashed from the pixel and the sample index,
+    // so the anti-aliasing does not depend on the thread count.
+    float Jitter(const int x, const int y, const int index)
+    {
+        uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(y) * 0xd8163841u ^ static_cast<uint32_t>(index) * 0xcb1ab31fu;
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return static_cast<float>(h >> 8) * (1.f / 16777216.f);
+    }
+
+    bool SameLight(const Light& a, const Light& b)
+    {
+        return a.position == b.position && a.color == b.color && a.radius == b.radius &&
+            a.intensity == b.intensity && a.exp == b.exp && a.castShadows == b.castShadows;
+    }
+}
+
+void PixelCosts::Reset(const int width, const int height)
+{
+    this->width = width;
+    this->height = height;
+    const size_t size = static_cast<size_t>(width) * static_cast<size_t>(height);
+    tests.assign(size, 0.f);
+    nodes.assign(size, 0.f);
+    lights.assign(size, 0.f);
+    cycles.assign(size, 0.f);
+}
+
+void PixelCosts::Add(const size_t index, const TraceCounters& counters, const uint64_t elapsed)
+{
+    tests[index] += static_cast<float>(counters.Tests());
+    nodes[index] += static_cast<float>(counters.nodes);
+    lights[index] += static_cast<float>(counters.lights);
+    cycles[index] += static_cast<float>(elapsed);
+}
+
+Raytracer::Raytracer():
+    Raytracer(nullptr)
+{
+}
+
+Raytracer::Raytracer(std::shared_ptr<ThreadPool> threadPool):
+    threadPool(std::move(threadPool)),
+    sharedThreadPool(this->threadPool != nullptr)
 {
     // Create default material.
-    auto material = std::make_shared<Material>();
-    material->diffuseColor = {0.9f, 0.9f, 0.9f, 0.0f};
-    material->specularColor = {1.0f, 1.0f, 1.0f, 0.0f};
-    material->specularExp = 0.f;
-    material->specularIntensity = 0.f;
+    Material material;
+    material.diffuseColor = {0.9f, 0.9f, 0.9f, 0.0f};
+    material.specularColor = {1.0f, 1.0f, 1.0f, 0.0f};
+    material.specularExp = 0.f;
+    material.specularIntensity = 0.f;
     AddMaterial(material);
+
+    // Start the own thread pool.
+    SetSettings(RenderSettings());
 }
 
-int Raytracer::AddMaterial(const std::shared_ptr<const Material> material)
+int Raytracer::AddMaterial(const Material& material)
 {
     materials.push_back(material);
+    frame.valid = false;
     return static_cast<int>(materials.size() - 1);
 }
 
-void Raytracer::Render(const Scene& scene, const Camera& camera, Framebuffer& framebuffer) const
+void Raytracer::SetSettings(const RenderSettings& settings)
+{
+    const bool restart = !sharedThreadPool && (threadPool == nullptr || settings.threadCount != this->settings.threadCount);
+    this->settings = settings;
+    this->settings.tileSize = std::max(settings.tileSize, 1);
+    // Any anti-aliasing uses at least the 2x2 grid, see RenderSettings::antialiasingSamples.
+    this->settings.antialiasingSamples = settings.antialiasingSamples > 1 ? std::max(settings.antialiasingSamples, 4) : 1;
+    traversal.Build(settings.pixelOrder, this->settings.tileSize);
+    frame.valid = false;
+
+    if (restart)
+    {
+        threadPool.reset();
+        threadPool = std::make_shared<ThreadPool>(settings.threadCount);
+    }
+}
+
+void Raytracer::Render(const Scene& scene, const Camera& camera, Framebuffer& framebuffer)
+{
+    // Invalid framebuffer dimensions.
+    if (framebuffer.Width() == 0 || framebuffer.Height() == 0)
+    {
+        return;
+    }
+
+    const auto start = Clock::now();
+    timings = RenderTimings();
+    Prepare(scene, framebuffer);
+    if (settings.costInstrumentation)
+    {
+        // Every pixel is traced to get its full cost.
+        costs.Reset(framebuffer.Width(), framebuffer.Height());
+        RenderPass(scene, camera, framebuffer, {1, false, KeepPixels() ? pixels.data() : nullptr, nullptr, &costs});
+        Antialias(scene, camera, framebuffer, nullptr, &costs);
+        Resolve(framebuffer);
+    }
+    else if (Incremental(scene, camera, framebuffer))
+    {
+        RenderIncremental(scene, camera, framebuffer);
+
+        // The pixels of the other bands are valid only with the same resolve settings.
+        const auto& resolving = framebuffer.Resolving();
+        Resolve(framebuffer, resolving.exposure == frame.resolving.exposure && resolving.toneMapping == frame.resolving.toneMapping &&
+            resolving.srgb == frame.resolving.srgb);
+    }
+    else
+    {
+        RenderPass(scene, camera, framebuffer, {1, false, KeepPixels() ? pixels.data() : nullptr});
+        Antialias(scene, camera, framebuffer);
+        Resolve(framebuffer);
+    }
+    StoreFrame(scene, camera, framebuffer);
+    CollectStats(start);
+}
+
+bool Raytracer::RenderProgressive(const Scene& scene, const Camera& camera, Framebuffer& framebuffer, const PassCallback& callback)
+{
+    // Invalid framebuffer dimensions.
+    if (framebuffer.Width() == 0 || framebuffer.Height() == 0)
+    {
+        return true;
+    }
+
+    const auto start = Clock::now();
+    timings = RenderTimings();
+    Prepare(scene, framebuffer);
+    frame.valid = false;
+
+    for (int blockSize = 8; blockSize >= 1; blockSize /= 2)
+    {
+        RenderPass(scene, camera, framebuffer, {blockSize, blockSize != 8, KeepPixels() ? pixels.data() : nullptr});
+        if (blockSize == 1)
+        {
+            Antialias(scene, camera, framebuffer);
+        }
+        Resolve(framebuffer);
+        if (callback && !callback(blockSize) && blockSize > 1)
+        {
+            CollectStats(start);
+            return false;
+        }
+    }
+    StoreFrame(scene, camera, framebuffer);
+    CollectStats(start);
+    return true;
+}
+
+void Raytracer::RenderRegion(const Scene& scene, const Camera& camera, Framebuffer& framebuffer, const int fullWidth, const int fullHeight, const int x, const int y)
+{
+    // Invalid framebuffer dimensions.
+    if (framebuffer.Width() == 0 || framebuffer.Height() == 0)
+    {
+        return;
+    }
+
+    const auto start = Clock::now();
+    timings = RenderTimings();
+    Prepare(scene, framebuffer);
+    frame.valid = false;
+
+    region.x = x;
+    region.y = y;
+    region.width = fullWidth;
+    region.height = fullHeight;
+    RenderPass(scene, camera, framebuffer, {1, false, KeepPixels() ? pixels.data() : nullptr});
+    Antialias(scene, camera, framebuffer);
+    region = Region();
+
+    Resolve(framebuffer);
+    CollectStats(start);
+}
+
+void Raytracer::Prepare(const Scene& scene, const Framebuffer& framebuffer)
+{
+    // Pixel samples for the anti-aliasing and the incremental rendering.
+    if (KeepPixels())
+    {
+        pixels.resize(static_cast<size_t>(framebuffer.Width()) * static_cast<size_t>(framebuffer.Height()));
+    }
+    threadCounters.assign(static_cast<size_t>(ThreadCount()), ThreadCounters());
+
+    // Apply transformations of the changed primitives.
+    auto start = Clock::now();
+    accelerator.Transform(scene.primitives);
+    timings.transform += Elapsed(start);
+
+    // Update the acceleration structure over the transformed primitives and bin the lights.
+    start = Clock::now();
+    accelerator.Update(scene.primitives);
+    lightGrid.Build(scene.lights);
+    timings.build += Elapsed(start);
+}
+
+void Raytracer::CollectStats(const Clock::time_point start)
+{
+    stats = RenderStats();
+#if RAYTRACER_STATS
+    TraceCounters counters;
+    for (const auto& thread : threadCounters)
+    {
+        counters += thread.counters;
+    }
+    stats.SetCounters(counters);
+#endif
+    stats.transform = timings.transform;
+    stats.build = timings.build;
+    stats.trace = timings.trace;
+    stats.resolve = timings.resolve;
+    stats.total = Elapsed(start);
+}
+
+void Raytracer::RenderPass(const Scene& scene, const Camera& camera, Framebuffer& framebuffer, const Pass& pass)
 {
     const int width = framebuffer.Width();
     const int height = framebuffer.Height();
+    const Projection projection = FramebufferProjection(camera, framebuffer);
 
-    // Invalid framebuffer dimensions.
-    if (width == 0 || height == 0)
+    // Split the framebuffer into tiles, every tile is rendered by a single thread.
+    const int tileSize = settings.tileSize;
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+
+    std::atomic<uint64_t> shadowRays(0);
+
+    const auto start = Clock::now();
+    threadPool->Run(tilesX * tilesY, [&](const int tile)
+    {
+        const int x0 = (tile % tilesX) * tileSize;
+        const int y0 = (tile / tilesX) * tileSize;
+        const int x1 = std::min(x0 + tileSize, width);
+        const int y1 = std::min(y0 + tileSize, height);
+        if (pass.mask != nullptr && maskedTiles[tile] == 0)
+        {
+            return;
+        }
+        StatisticsCounters counters;
+        shadowRays += RenderTile(scene, accelerator, projection, camera.drawDistance, framebuffer, pass, x0, y0, x1, y1, counters);
+        threadCounters[ThreadPool::ThreadIndex()].counters += counters;
+    });
+
+    // Masked pixels are counted by RenderIncremental().
+    timings.trace += Elapsed(start);
+    timings.shadowRays += shadowRays;
+    timings.rays += (pass.mask != nullptr ? 0 : pass.PixelCount(width, height)) + shadowRays;
+}
+
+Raytracer::Projection Raytracer::FramebufferProjection(const Camera& camera, const Framebuffer& framebuffer) const
+{
+    if (region.width == 0 || region.height == 0)
+    {
+        return Projection(camera, framebuffer.Width(), framebuffer.Height());
+    }
+    return Projection(camera, region.width, region.height, region.x, region.y);
+}
+
+bool Raytracer::KeepPixels() const
+{
+    return AntialiasingGrid() > 1 || settings.incrementalRendering;
+}
+
+bool Raytracer::Incremental(const Scene& scene, const Camera& camera, const Framebuffer& framebuffer) const
+{
+    if (!settings.incrementalRendering || !frame.valid || !accelerator.ChangesKnown())
+    {
+        return false;
+    }
+
+    // The framebuffer does not hold the last frame or the projection changed.
+    const int width = framebuffer.Width();
+    const int height = framebuffer.Height();
+    if (framebuffer.FrameId() != frame.id || frame.width != width || frame.height != height ||
+        !(frame.projection == Projection(camera, width, height)) || frame.drawDistance != camera.drawDistance)
+    {
+        return false;
+    }
+
+    // Lighting changes.
+    if (frame.backgroundColor != scene.backgroundColor || frame.ambientLight != scene.ambientLight || frame.lights.size() != scene.lights.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < scene.lights.size(); ++i)
+    {
+        if (!SameLight(scene.lights[i] != nullptr ? *scene.lights[i] : Light(), frame.lights[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Raytracer::RenderIncremental(const Scene& scene, const Camera& camera, Framebuffer& framebuffer)
+{
+    const int width = framebuffer.Width();
+    const int height = framebuffer.Height();
+    const Projection projection(camera, width, height);
+
+    // Shadow rays from the points in range of the light can pass the bounding sphere of a changed primitive.
+    struct ShadowCone
+    {
+        Math::Vector light;
+        Math::Vector axis;
+        float distance;
+        float radius;
+        float maxDistance;
+
+        // The segment from the point to the light passes the sphere enlarged by the margin.
+        // Segments from the points within the margin of the point can pass the sphere.
+        // Distances and the cone angle are compared squared.
+        bool Shadows(const Math::Vector& point, const float margin) const
+        {
+            const auto toPoint = point - light;
+            const float pointDistanceSq = toPoint * toPoint;
+            const float enlarged = radius + margin;
+            const float range = maxDistance + margin;
+            if (!(pointDistanceSq < range * range))
+            {
+                return false;
+            }
+
+            // The light inside of the sphere can be shadowed in all directions.
+            const float gap = distance - enlarged;
+            if (gap <= 0.f)
+            {
+                return true;
+            }
+
+            // Points nearer than the sphere and outside of the cone around the sphere.
+            const float cos = toPoint * axis;
+            const float sin = enlarged / distance;
+            return pointDistanceSq > gap * gap && cos >= 0.f && cos * cos >= pointDistanceSq * (1.f - sin * sin);
+        }
+    };
+
+    // Old and new footprints and shadow cones of the changed primitives.
+    std::vector<Projection::Rect> footprints;
+    std::vector<ShadowCone> cones;
+    for (const auto& change : accelerator.Changes())
+    {
+        for (const Math::Box* const box : {&change.before, &change.after})
+        {
+            if (box->Empty())
+            {
+                continue;
+            }
+            footprints.push_back(projection.Footprint(*box));
+
+            const auto center = box->Center();
+            const float radius = box->Size().Length() * 0.5f * 1.001f + settings.shadowBias;
+            for (const auto& light : scene.lights)
+            {
+                if (light == nullptr || !light->castShadows || !(light->radius > 0.f))
+                {
+                    continue;
+                }
+
+                const auto toCenter = center - light->position;
+                const float distance = toCenter.Length();
+                if (distance - radius >= light->radius)
+                {
+                    continue;
+                }
+
+                ShadowCone cone;
+                cone.light = light->position;
+                cone.axis = distance > 0.f ? toCenter / distance : Math::Vector();
+                cone.distance = distance;
+                cone.radius = radius;
+                cone.maxDistance = light->radius + settings.shadowBias;
+                cones.push_back(cone);
+            }
+        }
+    }
+
+    // Mark the pixels in the footprints and the pixels whose shadow rays can pass the changed primitives.
+    const int tileSize = settings.tileSize;
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    mask.assign(static_cast<size_t>(width) * static_cast<size_t>(height), 0);
+    maskedTiles.assign(tilesX * tilesY, 0);
+    std::atomic<uint64_t> retracedPixels(0);
+
+    const auto start = Clock::now();
+    threadPool->Run(tilesX * tilesY, [&](const int tile)
+    {
+        const int x0 = (tile % tilesX) * tileSize;
+        const int y0 = (tile / tilesX) * tileSize;
+        const int x1 = std::min(x0 + tileSize, width);
+        const int y1 = std::min(y0 + tileSize, height);
+        uint64_t count = 0;
+
+        // Footprints overlapping the tile.
+        std::vector<Projection::Rect> tileFootprints;
+        for (const auto& rect : footprints)
+        {
+            if (rect.x0 < x1 && rect.x1 > x0 && rect.y0 < y1 && rect.y1 > y0)
+            {
+                tileFootprints.push_back(rect);
+            }
+        }
+
+        // Cones passing the sphere around all shadow spheres of the tile.
+        std::vector<const ShadowCone*> tileCones;
+        if (!cones.empty())
+        {
+            Math::Box bounds;
+            float margin = 0.f;
+            for (int y = y0; y < y1; ++y)
+            {
+                for (int x = x0; x < x1; ++x)
+                {
+                    const PixelSample& pixel = pixels[static_cast<size_t>(y) * width + x];
+                    if (pixel.shadowRadius >= 0.f)
+                    {
+                        bounds.Extend(pixel.shadowOrigin);
+                        margin = std::max(margin, pixel.shadowRadius);
+                    }
+                }
+            }
+            if (!bounds.Empty())
+            {
+                margin += bounds.Size().Length() * 0.5f * 1.001f;
+                for (const auto& cone : cones)
+                {
+                    if (cone.Shadows(bounds.Center(), margin))
+                    {
+                        tileCones.push_back(&cone);
+                    }
+                }
+            }
+        }
+
+        for (int y = y0; y < y1; ++y)
+        {
+            for (int x = x0; x < x1; ++x)
+            {
+                bool retrace = false;
+                for (const auto& rect : tileFootprints)
+                {
+                    retrace = retrace || (x >= rect.x0 && x < rect.x1 && y >= rect.y0 && y < rect.y1);
+                }
+
+                const size_t index = static_cast<size_t>(y) * width + x;
+                const PixelSample& pixel = pixels[index];
+                for (size_t i = 0; !retrace && pixel.shadowRadius >= 0.f && i < tileCones.size(); ++i)
+                {
+                    retrace = tileCones[i]->Shadows(pixel.shadowOrigin, pixel.shadowRadius);
+                }
+
+                mask[index] = retrace ? 1 : 0;
+                count += retrace ? 1 : 0;
+            }
+        }
+
+        maskedTiles[tile] = count > 0 ? 1 : 0;
+        retracedPixels += count;
+    });
+    timings.trace += Elapsed(start);
+
+    timings.incremental = true;
+    timings.retracedPixels = retracedPixels;
+    timings.rays += retracedPixels;
+
+    RenderPass(scene, camera, framebuffer, {1, false, pixels.data(), mask.data()});
+    Antialias(scene, camera, framebuffer, mask.data());
+}
+
+void Raytracer::StoreFrame(const Scene& scene, const Camera& camera, Framebuffer& framebuffer)
+{
+    frame.valid = settings.incrementalRendering;
+    if (!frame.valid)
     {
         return;
     }
 
-    // Projection axes scale.
-    const float sy = std::tanf(camera.VFov() / 2.f);
-    const float sx = std::tanf(camera.HFov() / 2.f);
+    frame.id = ++lastFrameId;
+    framebuffer.SetFrameId(frame.id);
+    frame.width = framebuffer.Width();
+    frame.height = framebuffer.Height();
+    frame.projection = Projection(camera, frame.width, frame.height);
+    frame.drawDistance = camera.drawDistance;
+    frame.backgroundColor = scene.backgroundColor;
+    frame.ambientLight = scene.ambientLight;
+    frame.lights.clear();
+    for (const auto& light : scene.lights)
+    {
+        frame.lights.push_back(light != nullptr ? *light : Light());
+    }
+    frame.resolving = framebuffer.Resolving();
+}
+
+void Raytracer::Resolve(Framebuffer& framebuffer, const bool masked)
+{
+    // Bands of rows resolved in parallel, the bands are the rows of tiles.
+    const int rows = settings.tileSize;
+    const int bands = (framebuffer.Height() + rows - 1) / rows;
+    const int tilesX = (framebuffer.Width() + rows - 1) / rows;
 
-    const auto look = camera.Look();
-    const auto up = camera.Up() * sy;
-    const auto left = Math::Vector::Cross(camera.Look(), camera.Up()) * sx;
+    // The anti-aliasing of the retraced pixels can change the pixels of the neighbouring tiles.
+    const int reach = settings.antialiasingSamples >= 4 ? 1 : 0;
+    const auto retraced = [&](const int band)
+    {
+        const int first = std::max(band - reach, 0) * tilesX;
+        const int last = std::min(band + reach + 1, bands) * tilesX;
+        return std::find(maskedTiles.begin() + first, maskedTiles.begin() + last, 1) != maskedTiles.begin() + last;
+    };
 
-    // Apply transformations.
-    for (auto primitive : scene.primitives)
+    const auto start = Clock::now();
+    threadPool->Run(bands, [&](const int band)
     {
-        primitive->Transform();
+        if (!masked || retraced(band))
+        {
+            framebuffer.Resolve(band * rows, (band + 1) * rows);
+        }
+    });
+    timings.resolve += Elapsed(start);
+}
+
+int Raytracer::AntialiasingGrid() const
+{
+    int grid = 1;
+    while ((grid + 1) * (grid + 1) <= settings.antialiasingSamples)
+    {
+        ++grid;
     }
+    return grid;
+}
 
-    // For each vertical pixels.
-    for (int y = 0; y < height; ++y)
+void Raytracer::Antialias(const Scene& scene, const Camera& camera, Framebuffer& framebuffer, const uint8_t* const mask, PixelCosts* const costs)
+{
+    if (AntialiasingGrid() <= 1)
     {
-        // For each horizontal pixels.
-        for (int x = 0; x < width; ++x)
+        return;
+    }
+
+    const int width = framebuffer.Width();
+    const int height = framebuffer.Height();
+    const Projection projection = FramebufferProjection(camera, framebuffer);
+
+    const int tileSize = settings.tileSize;
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+
+    std::atomic<uint64_t> antialiasedPixels(0);
+    std::atomic<uint64_t> shadowRays(0);
+
+    // The pixel samples are only read, the refined colors go to the framebuffer.
+    const auto start = Clock::now();
+    threadPool->Run(tilesX * tilesY, [&](const int tile)
+    {
+        const int x0 = (tile % tilesX) * tileSize;
+        const int y0 = (tile / tilesX) * tileSize;
+        const int x1 = std::min(x0 + tileSize, width);
+        const int y1 = std::min(y0 + tileSize, height);
+        uint64_t tileShadowRays = 0;
+        StatisticsCounters counters;
+        antialiasedPixels += AntialiasTile(scene, accelerator, projection, camera.drawDistance, framebuffer, mask, costs, x0, y0, x1, y1, tileShadowRays, counters);
+        shadowRays += tileShadowRays;
+        threadCounters[ThreadPool::ThreadIndex()].counters += counters;
+    });
+
+    const uint64_t samples = antialiasedPixels * static_cast<uint64_t>(AntialiasingGrid() * AntialiasingGrid());
+    timings.trace += Elapsed(start);
+    timings.antialiasedPixels = antialiasedPixels;
+    timings.antialiasingSamples = samples;
+    timings.shadowRays += shadowRays;
+    timings.rays += samples + shadowRays;
+}
+
+bool Raytracer::Edge(const int x, const int y, const int width, const int height) const
+{
+    const PixelSample& pixel = pixels[static_cast<size_t>(y) * width + x];
+
+    // Compare the pixel with a neighbour, colors are clamped to the displayed range.
+    const auto differs = [&](const int nx, const int ny)
+    {
+        if (nx < 0 || nx >= width || ny < 0 || ny >= height)
+        {
+            return false;
+        }
+
+        const PixelSample& neighbour = pixels[static_cast<size_t>(ny) * width + nx];
+        if (neighbour.primitive != pixel.primitive)
+        {
+            return true;
+        }
+
+        const float threshold = settings.antialiasingThreshold;
+        for (int i = 0; i < 3; ++i)
         {
-            // Screen-space to normal-space (-1;1)
-            const float ny = 2.f * (0.5f - (y + 0.5f) / height);
-            const float nx = 2.f * (0.5f - (x + 0.5f) / width);
-            
-            // Ray from cam position to far-plane intersection point.
-            const Math::Ray ray(camera.position, look + up * ny + left * nx);
+            const float a = Math::Clamp(pixel.color[i], 0.f, 1.f);
+            const float b = Math::Clamp(neighbour.color[i], 0.f, 1.f);
+            if (std::abs(a - b) > threshold)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    return differs(x - 1, y) || differs(x + 1, y) || differs(x, y - 1) || differs(x, y + 1);
+}
 
-            // Compte pixel color.
-            const auto color = Raycast(ray, scene, camera.drawDistance);
+uint64_t Raytracer::AntialiasTile(const Scene& scene, const Accelerator& accelerator, const Projection& projection, const float drawDistance, Framebuffer& framebuffer, const uint8_t* const mask, PixelCosts* const costs, const int x0, const int y0, const int x1, const int y1, uint64_t& shadowRays, StatisticsCounters& counters)
+{
+    const int width = framebuffer.Width();
+    const int height = framebuffer.Height();
+    const int grid = AntialiasingGrid();
+    const float cell = 1.f / static_cast<float>(grid);
+    uint64_t antialiasedPixels = 0;
 
-            // Store result to framebuffer.
-            framebuffer.SetPixel(x, y, color);
+    // A masked pixel or its neighbour, their edges could change.
+    const auto masked = [&](const int x, const int y)
+    {
+        for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1); ++ny)
+        {
+            for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); ++nx)
+            {
+                if (mask[static_cast<size_t>(ny) * width + nx] != 0)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    for (int y = y0; y < y1; ++y)
+    {
+        for (int x = x0; x < x1; ++x)
+        {
+            if (mask != nullptr && !masked(x, y))
+            {
+                continue;
+            }
+
+            // Pixels which are no longer edges return to their single sample.
+            PixelSample& pixel = pixels[static_cast<size_t>(y) * width + x];
+            if (!Edge(x, y, width, height))
+            {
+                if (mask != nullptr)
+                {
+                    framebuffer.SetPixel(x, y, pixel.color);
+                    pixel.shadowRadius = (pixel.primitive != nullptr) ? 0.f : -1.f;
+                }
+                continue;
+            }
+
+            // One jittered sample in every cell of the grid accumulated in the framebuffer, the pixel center sample is replaced.
+            for (int i = 0; i < grid * grid; ++i)
+            {
+                // The jitter depends on the image pixel, so the framebuffer parts get the same samples.
+                const int imageX = x + projection.offsetX;
+                const int imageY = y + projection.offsetY;
+                const float sx = (static_cast<float>(i % grid) + Jitter(imageX, imageY, 2 * i)) * cell;
+                const float sy = (static_cast<float>(i / grid) + Jitter(imageX, imageY, 2 * i + 1)) * cell;
+                const Math::Ray ray = projection.PixelRay(x, y, sx, sy);
+                const auto sample = TracePixel(ray, scene, accelerator, drawDistance, shadowRays, costs, static_cast<size_t>(y) * width + x, counters);
+                if (i == 0)
+                {
+                    framebuffer.SetPixel(x, y, sample.color);
+                }
+                else
+                {
+                    framebuffer.AddSample(x, y, sample.color);
+                }
+
+                // Shadow sphere containing the sample.
+                if (sample.primitive != nullptr)
+                {
+                    if (pixel.shadowRadius < 0.f)
+                    {
+                        pixel.shadowOrigin = sample.shadowOrigin;
+                        pixel.shadowRadius = 0.f;
+                    }
+                    pixel.shadowRadius = std::max(pixel.shadowRadius, Math::Vector::Distance(pixel.shadowOrigin, sample.shadowOrigin));
+                }
+            }
+
+            ++antialiasedPixels;
         }
     }
+    return antialiasedPixels;
 }
 
-Math::Vector Raytracer::Raycast(const Math::Ray& ray, const Scene& scene, const float drawDistance) const
+bool Raytracer::Pass::Traced(const int x, const int y, const int width) const
 {
-    float distance = drawDistance;
+    const int coarse = 2 * blockSize;
+    return x % blockSize == 0 && y % blockSize == 0 && !(refine && x % coarse == 0 && y % coarse == 0) &&
+        (mask == nullptr || mask[static_cast<size_t>(y) * width + x] != 0);
+}
 
-    RaycastSample sample;
-    RaycastSample finalSample;
-    int materialId = 0;
+uint64_t Raytracer::Pass::PixelCount(const int width, const int height) const
+{
+    // Grid points in the framebuffer.
+    const auto points = [&](const int size)
+    {
+        return static_cast<uint64_t>((width + size - 1) / size) * static_cast<uint64_t>((height + size - 1) / size);
+    };
+    return refine ? points(blockSize) - points(2 * blockSize) : points(blockSize);
+}
+
+void Raytracer::Pass::Store(Framebuffer& framebuffer, const int x, const int y, const PixelSample& pixel) const
+{
+    if (pixels != nullptr)
+    {
+        pixels[static_cast<size_t>(y) * framebuffer.Width() + x] = pixel;
+    }
 
-    for (const auto& primitive : scene.primitives)
+    // Blocks are owned by their traced pixel, so the tiles write different pixels also across their borders.
+    const int x1 = std::min(x + blockSize, framebuffer.Width());
+    const int y1 = std::min(y + blockSize, framebuffer.Height());
+    for (int by = y; by < y1; ++by)
     {
-        if (primitive == nullptr)
+        for (int bx = x; bx < x1; ++bx)
         {
-            continue;
+            framebuffer.SetPixel(bx, by, pixel.color);
         }
+    }
+}
+
+uint64_t Raytracer::RenderTile(const Scene& scene, const Accelerator& accelerator, const Projection& projection, const float drawDistance, Framebuffer& framebuffer, const Pass& pass, const int x0, const int y0, const int x1, const int y1, StatisticsCounters& counters) const
+{
+    // Trace coherent pixel blocks as ray packets, the instrumented pixels are traced one by one.
+    if (settings.packetTracing && Math::Simd::Native && pass.costs == nullptr)
+    {
+        return RenderTilePackets(scene, accelerator, projection, drawDistance, framebuffer, pass, x0, y0, x1, y1, counters);
+    }
+
+    uint64_t shadowRays = 0;
 
-        const float t = primitive->Raycast(ray, distance, sample);
+    // First pixels of the tile on the pass grid.
+    const int step = pass.blockSize;
+    const int gridX0 = (x0 + step - 1) / step * step;
+    const int gridY0 = (y0 + step - 1) / step * step;
+    const int columns = std::max((x1 - gridX0 + step - 1) / step, 0);
+    const int rows = std::max((y1 - gridY0 + step - 1) / step, 0);
+
+    // For each pixel of the pass grid in the traversal order.
+    traversal.ForEach(columns, rows, [&](const int column, const int row)
+    {
+        const int x = gridX0 + column * step;
+        const int y = gridY0 + row * step;
 
-        // No intersection.
-        if (t == INFINITY)
+        // Pixel traced by a previous pass.
+        if (!pass.Traced(x, y, framebuffer.Width()))
         {
-            continue;
+            return;
         }
 
-        distance = t;
-        finalSample = sample;
-        materialId = primitive->materialId;
+        // Ray from cam position through the pixel center.
+        const Math::Ray ray = projection.PixelRay(x, y, 0.5f, 0.5f);
+
+        // Compte pixel color.
+        const auto pixel = TracePixel(ray, scene, accelerator, drawDistance, shadowRays, pass.costs, static_cast<size_t>(y) * framebuffer.Width() + x, counters);
+
+        // Store result to framebuffer.
+        pass.Store(framebuffer, x, y, pixel);
+    });
+    return shadowRays;
+}
+
+uint64_t Raytracer::RenderTilePackets(const Scene& scene, const Accelerator& accelerator, const Projection& projection, const float drawDistance, Framebuffer& framebuffer, const Pass& pass, const int x0, const int y0, const int x1, const int y1, StatisticsCounters& counters) const
+{
+    uint64_t shadowRays = 0;
+    std::vector<Math::Ray> rays;
+    rays.reserve(RayPacket::Size);
+
+    RayPacket packet;
+    PacketHit hit;
+
+    // Packets cover neighbouring pixels of the pass grid.
+    const int step = pass.blockSize;
+    const int gridX0 = (x0 + step - 1) / step * step;
+    const int gridY0 = (y0 + step - 1) / step * step;
+    if (gridX0 >= x1 || gridY0 >= y1)
+    {
+        return 0;
     }
+    const int lastX = gridX0 + (x1 - 1 - gridX0) / step * step;
+    const int lastY = gridY0 + (y1 - 1 - gridY0) / step * step;
+
+    // Packets of the pass grid in the traversal order.
+    const int packetStepX = RayPacket::Width * step;
+    const int packetStepY = RayPacket::Height * step;
+    const int columns = (x1 - gridX0 + packetStepX - 1) / packetStepX;
+    const int rows = (y1 - gridY0 + packetStepY - 1) / packetStepY;
+
+    traversal.ForEach(columns, rows, [&](const int column, const int row)
+    {
+        const int x = gridX0 + column * packetStepX;
+        const int y = gridY0 + row * packetStepY;
+
+        // Lanes outside of the tile or traced by a previous pass are inactive, their rays only fill the packet.
+        rays.clear();
+        for (int lane = 0; lane < RayPacket::Size; ++lane)
+        {
+            const int px = std::min(x + lane % RayPacket::Width * step, lastX);
+            const int py = std::min(y + lane / RayPacket::Width * step, lastY);
+            rays.push_back(projection.PixelRay(px, py, 0.5f, 0.5f));
+        }
+        bool anyActive = false;
+        for (int lane = 0; lane < RayPacket::Size; ++lane)
+        {
+            const int px = x + lane % RayPacket::Width * step;
+            const int py = y + lane / RayPacket::Width * step;
+            const bool active = px < x1 && py < y1 && pass.Traced(px, py, framebuffer.Width());
+            packet.Set(lane, rays[lane]);
+            hit.distance[lane] = active ? drawDistance : -INFINITY;
+            hit.primitive[lane] = nullptr;
+            anyActive = anyActive || active;
+        }
+
+        // All pixels are masked out.
+        if (!anyActive)
+        {
+            return;
+        }
+
+        accelerator.Raycast(packet, hit, counters);
+
+        // Shade the lanes.
+        for (int lane = 0; lane < RayPacket::Size; ++lane)
+        {
+            const int px = x + lane % RayPacket::Width * step;
+            const int py = y + lane / RayPacket::Width * step;
+            if (px >= x1 || py >= y1 || !pass.Traced(px, py, framebuffer.Width()))
+            {
+                continue;
+            }
+
+            // No intersection, use background color and skip shading.
+            const bool missed = (hit.primitive[lane] == nullptr || hit.distance[lane] >= drawDistance);
+            counters.Primary(!missed);
+            if (missed)
+            {
+                PixelSample background;
+                background.color = scene.backgroundColor;
+                pass.Store(framebuffer, px, py, background);
+                continue;
+            }
+
+            PixelSample pixel;
+            pixel.color = Lighting(rays[lane], scene, accelerator, hit.sample[lane], *hit.primitive[lane], shadowRays, counters);
+            pixel.shadowOrigin = ShadowOrigin(hit.sample[lane]);
+            pixel.shadowRadius = 0.f;
+            pixel.primitive = hit.primitive[lane];
+            pass.Store(framebuffer, px, py, pixel);
+        }
+    });
+    return shadowRays;
+}
+
+Raytracer::Projection::Projection(const Camera& camera, const int width_, const int height_, const int offsetX_, const int offsetY_):
+    origin{camera.position},
+    look{camera.Look()},
+    width{static_cast<float>(width_)},
+    height{static_cast<float>(height_)},
+    offsetX{offsetX_},
+    offsetY{offsetY_}
+{
+    // Projection axes scale.
+    const float sy = std::tan(camera.VFov() / 2.f);
+    const float sx = std::tan(camera.HFov() / 2.f);
+
+    up = camera.Up() * sy;
+    left = Math::Vector::Cross(camera.Look(), camera.Up()) * sx;
+}
+
+bool Raytracer::Projection::operator==(const Projection& other) const
+{
+    return origin == other.origin && look == other.look && up == other.up && left == other.left &&
+        width == other.width && height == other.height && offsetX == other.offsetX && offsetY == other.offsetY;
+}
+
+Raytracer::Projection::Rect Raytracer::Projection::Footprint(const Math::Box& box) const
+{
+    const Rect screen = {0, 0, static_cast<int>(width), static_cast<int>(height)};
+
+    // Dual basis of the ray directions look + up * ny + left * nx.
+    const auto lookDual = Math::Vector::Cross(up, left);
+    const auto upDual = Math::Vector::Cross(left, look);
+    const auto leftDual = Math::Vector::Cross(look, up);
+    const float det = look * lookDual;
+    if (det == 0.f)
+    {
+        return screen;
+    }
+
+    float minX = INFINITY;
+    float minY = INFINITY;
+    float maxX = -INFINITY;
+    float maxY = -INFINITY;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const Math::Vector point(
+            (corner & 1) ? box.max.x : box.min.x,
+            (corner & 2) ? box.max.y : box.min.y,
+            (corner & 4) ? box.max.z : box.min.z,
+            0.f
+        );
+        const auto d = point - origin;
+
+        // The box reaches behind the camera, its projection is unbounded.
+        const float t = (d * lookDual) / det;
+        if (!(t > 0.f))
+        {
+            return screen;
+        }
+
+        const float nx = (d * leftDual) / det / t;
+        const float ny = (d * upDual) / det / t;
+        const float x = width * (0.5f - 0.5f * nx);
+        const float y = height * (0.5f - 0.5f * ny);
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+    }
+
+    // Pixels touching the projection with a pixel margin for the rounding.
+    Rect rect;
+    rect.x0 = static_cast<int>(Math::Clamp(std::floor(minX) - 1.f, 0.f, width));
+    rect.y0 = static_cast<int>(Math::Clamp(std::floor(minY) - 1.f, 0.f, height));
+    rect.x1 = static_cast<int>(Math::Clamp(std::ceil(maxX) + 1.f, 0.f, width));
+    rect.y1 = static_cast<int>(Math::Clamp(std::ceil(maxY) + 1.f, 0.f, height));
+    return rect;
+}
+
+Math::Ray Raytracer::Projection::Ray(const float x, const float y) const
+{
+    // Screen-space to normal-space (-1;1)
+    const float ny = 2.f * (0.5f - y / height);
+    const float nx = 2.f * (0.5f - x / width);
+
+    // Ray from cam position to far-plane intersection point.
+    return Math::Ray(origin, look + up * ny + left * nx);
+}
+
+Math::Ray Raytracer::Projection::PixelRay(const int x, const int y, const float sx, const float sy) const
+{
+    return Ray(static_cast<float>(x + offsetX) + sx, static_cast<float>(y + offsetY) + sy);
+}
+
+Raytracer::PixelSample Raytracer::TracePixel(const Math::Ray& ray, const Scene& scene, const Accelerator& accelerator, const float drawDistance, uint64_t& shadowRays, PixelCosts* const costs, const size_t index, StatisticsCounters& counters) const
+{
+    if (costs == nullptr)
+    {
+        return Raycast(ray, scene, accelerator, drawDistance, shadowRays, counters);
+    }
+
+    TraceCounters pixelCounters;
+    const uint64_t start = Cycles();
+    const auto pixel = Raycast(ray, scene, accelerator, drawDistance, shadowRays, pixelCounters);
+    costs->Add(index, pixelCounters, Cycles() - start);
+    counters += pixelCounters;
+    return pixel;
+}
+
+template <typename Counters>
+Raytracer::PixelSample Raytracer::Raycast(const Math::Ray& ray, const Scene& scene, const Accelerator& accelerator, const float drawDistance, uint64_t& shadowRays, Counters& counters) const
+{
+    RaycastSample finalSample;
+    PixelSample pixel;
+
+    const float distance = accelerator.Raycast(ray, drawDistance, finalSample, pixel.primitive, counters);
 
     // No intersection, use background color and skip shading.
+    counters.Primary(distance < drawDistance);
     if (distance >= drawDistance)
     {
-        return scene.backgroundColor;
+        pixel.primitive = nullptr;
+        pixel.color = scene.backgroundColor;
+        return pixel;
     }
 
+    pixel.color = Lighting(ray, scene, accelerator, finalSample, *pixel.primitive, shadowRays, counters);
+    pixel.shadowOrigin = ShadowOrigin(finalSample);
+    pixel.shadowRadius = 0.f;
+    return pixel;
+}
+
+Math::Vector Raytracer::ShadowOrigin(const RaycastSample& sample) const
+{
+    return sample.position + sample.normal * settings.shadowBias;
+}
+
+template <typename Counters>
+Math::Vector Raytracer::Lighting(const Math::Ray& ray, const Scene& scene, const Accelerator& accelerator, const RaycastSample& finalSample, const Primitive& primitive, uint64_t& shadowRays, Counters& counters) const
+{
+    int materialId = primitive.materialId;
+
     // If materialId is invalid, use default material.
     if (materialId < 0 || materialId >= static_cast<int>(materials.size()))
     {
         materialId = 0;
     }
 
-    const auto material = materials[materialId];
+    const Material& material = materials[materialId];
 
     // Final color initialized to ambient lighting result.
-    Math::Vector color = Math::Vector::Mul(material->diffuseColor, scene.ambientLight);
+    Math::Vector color = Math::Vector::Mul(material.diffuseColor, scene.ambientLight);
 
-    // Shading.
-    for (const auto& light : scene.lights)
+    // Shadow rays start above the surface.
+    const auto shadowOrigin = ShadowOrigin(finalSample);
+
+    // Shading, only the lights in range are visited.
+    for (const uint32_t index : lightGrid.Lights(finalSample.position))
     {
-        color += Shade(finalSample, ray.origin, *light, *material);
+        const auto& light = scene.lights[index];
+        const auto contribution = Shade(finalSample, ray.origin, *light, material);
+        counters.Light();
+
+        // Unlit surface, no shadow ray is needed.
+        if (contribution == Math::Vector())
+        {
+            continue;
+        }
+
+        // Any primitive between the surface and the light.
+        if (light->castShadows && material.receiveShadows)
+        {
+            const auto toLight = light->position - shadowOrigin;
+            const Math::Ray shadowRay(shadowOrigin, toLight);
+            ++shadowRays;
+            const bool occluded = accelerator.Occluded(shadowRay, toLight.Length(), counters);
+            counters.Shadow(occluded);
+            if (occluded)
+            {
+                continue;
+            }
+        }
+
+        color += contribution;
     }
     return color;
 }
 
 Math::Vector Raytracer::Shade(const RaycastSample& sample, const Math::Vector& camera, const Light& light, const Material& material) const
 {
-    if (light.radius <= 0.f)
+    // Distance from light.
+    const float lightDistance = Math::Vector::Distance(sample.position, light.position);
+
+    // Point is out of light range.
+    if (!(lightDistance < light.radius))
     {
         return Math::Vector();
     }
@@ -133,9 +1098,6 @@ Math::Vector Raytracer::Shade(const RaycastSample& sample, const Math::Vector& c
     // Half vector.
     const auto half = Math::Vector::Normalized(v + l);
 
-    // Distance from light.
-    const float lightDistance = Math::Vector::Distance(sample.position, light.position);
-
     const float cos = sample.normal * l;
 
     // Backface lighting.
@@ -144,22 +1106,16 @@ Math::Vector Raytracer::Shade(const RaycastSample& sample, const Math::Vector& c
         return Math::Vector();
     }
 
-    // Point is out of light range.
-    if (lightDistance >= light.radius)
-    {
-        return Math::Vector();
-    }
-
     // Inverse-Square falloff.
     // float falloff *= light.intensity / (lightDistance * lightDistance + 0.00001f);
 
     // Exponential falloff.
-    const float falloff = light.intensity * std::powf(1.f - lightDistance / light.radius, light.exp);
+    const float falloff = light.intensity * std::pow(1.f - lightDistance / light.radius, light.exp);
 
     const Math::Vector diffuse = Math::Vector::Mul(material.diffuseColor, light.color * (falloff * cos));
 
     // Specular.
-    const float specularIntensity = std::powf(std::max(sample.normal * half, 0.f), material.specularExp) * (material.specularIntensity * falloff);
+    const float specularIntensity = std::pow(std::max(sample.normal * half, 0.f), material.specularExp) * (material.specularIntensity * falloff);
     const Math::Vector specular = Math::Vector::Mul(light.color, material.specularColor) * specularIntensity;
 
     // Final color composition.
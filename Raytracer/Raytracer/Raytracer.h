@@ -1,11 +1,22 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <vector>
 #include "Math/Math.h"
 #include "Raytracer/Framebuffer.h"
 #include "Raytracer/Camera.h"
 #include "Raytracer/Primitives.h"
+#include "Raytracer/Accelerator.h"
+#include "Raytracer/AlignedAllocator.h"
+#include "Raytracer/LightGrid.h"
+#include "Raytracer/PixelOrder.h"
+#include "Raytracer/RenderStats.h"
+#include "Raytracer/SceneArena.h"
+#include "Raytracer/ThreadPool.h"
+#include "Raytracer/TraceCounters.h"
 
 struct Light
 {
@@ -14,6 +25,9 @@ struct Light
     float radius = 0.f;
     float intensity = 0.f;
     float exp = 2.f;
+
+    // Test the light visibility with shadow rays.
+    bool castShadows = true;
 };
 
 struct Material
@@ -22,6 +36,9 @@ struct Material
     Math::Vector specularColor;
     float specularExp = 0.f;
     float specularIntensity = 0.f;
+
+    // Surfaces with this material can be shadowed, otherwise all lights in range are visible.
+    bool receiveShadows = true;
 };
 
 struct Scene
@@ -29,9 +46,106 @@ struct Scene
     Math::Vector backgroundColor;
     Math::Vector ambientLight;
 
-    // These objects are referenced because they could be managed in different places.
-    std::vector<std::shared_ptr<const Primitive>> primitives;
-    std::vector<std::shared_ptr<const Light>> lights;
+    // Handles of the scene objects, valid for the lifetime of their storage, usually the arena.
+    std::vector<const Primitive*> primitives;
+    std::vector<const Light*> lights;
+
+    // Contiguous storage of the scene objects, they are destroyed together with the scene.
+    SceneArena arena;
+};
+
+struct RenderSettings
+{
+    // Number of rendering threads, 0 uses all hardware threads.
+    int threadCount = 0;
+
+    // Width and height of the square tiles rendered by the threads.
+    int tileSize = 32;
+
+    // Traversal order of the pixels or packets within a tile, it only changes the memory access pattern.
+    PixelOrder pixelOrder = PixelOrder::Hilbert;
+
+    // Trace primary rays in SIMD packets (2x2 pixels with SSE, 4x2 pixels with AVX2).
+    // Hits are bit-identical with the single ray path, which is used if SIMD is not available.
+    bool packetTracing = true;
+
+    // Shadow rays start this distance above the surface to avoid self-intersections.
+    float shadowBias = 0.01f;
+
+    // Adaptive anti-aliasing. Pixels whose hit primitive (and so the material) differs from a neighbour
+    // or whose color differs by more than the threshold in any channel are traced again with a stratified
+    // grid of jittered samples. The sample count is rounded down to a square grid (8 samples use the 2x2 grid),
+    // values 2 and 3 are raised to the 2x2 grid and values up to 1 disable the anti-aliasing.
+    int antialiasingSamples = 1;
+    float antialiasingThreshold = 0.1f;
+
+    // Re-trace only the pixels affected by the changed primitives if the camera, framebuffer size, lights,
+    // background and ambient light did not change since the last frame. The framebuffer must hold the last frame,
+    // it is the same framebuffer or its copy, see Framebuffer::CopyFrom().
+    // The affected pixels are the old and new screen-space footprints of the primitives and the pixels
+    // whose shadow rays can pass them. Changes of the primitive list or of an unbounded primitive
+    // render the full frame. Changed material properties are not detected.
+    bool incrementalRendering = false;
+
+    // Record the work and the time of every pixel of Render(), see Raytracer::Costs().
+    // Instrumented frames trace single rays without packets and are never incremental, so they are slower.
+    bool costInstrumentation = false;
+};
+
+// Durations of the Render() phases in seconds, RenderProgressive() sums them over the rendered passes.
+struct RenderTimings
+{
+    // Transformation of the changed primitives.
+    double transform = 0.0;
+
+    // Acceleration structure and light grid update.
+    double build = 0.0;
+
+    // Tracing and shading of all tiles.
+    double trace = 0.0;
+
+    // Conversion of the accumulated colors to the 8-bit pixels.
+    double resolve = 0.0;
+
+    // Number of traced rays, primary and shadow rays.
+    uint64_t rays = 0;
+
+    // Number of traced shadow rays.
+    uint64_t shadowRays = 0;
+
+    // Pixels refined by the adaptive anti-aliasing and their extra primary rays.
+    uint64_t antialiasedPixels = 0;
+    uint64_t antialiasingSamples = 0;
+
+    // The frame was rendered incrementally and the number of re-traced pixels.
+    bool incremental = false;
+    uint64_t retracedPixels = 0;
+};
+
+// Per-pixel costs of an instrumented frame, row-major arrays of the framebuffer size.
+// Costs of the anti-aliased pixels include their samples.
+struct PixelCosts
+{
+    int width = 0;
+    int height = 0;
+
+    // Primitive and triangle intersection tests of the primary and shadow rays.
+    std::vector<float> tests;
+
+    // Acceleration structure nodes visited by the rays, including the mesh hierarchies.
+    std::vector<float> nodes;
+
+    // Lights shaded at the hit points.
+    std::vector<float> lights;
+
+    // Elapsed time stamp counter cycles, nanoseconds on the platforms without the counter.
+    std::vector<float> cycles;
+
+    // Clear the arrays to the framebuffer size.
+    void Reset(const int width, const int height);
+
+    // Add the work and the elapsed cycles to the pixel.
+    void Add(const size_t index, const TraceCounters&, const uint64_t elapsed);
 };
 
 class Raytracer
@@ -39,15 +153,261 @@ class Raytracer
 public:
     Raytracer();
 
-    // Add a material and returns its id.
-    int AddMaterial(const std::shared_ptr<const Material>);
+    // Raytracer rendering with the thread pool shared by several raytracers, which must not render at the same time.
+    // The thread count of the settings is not used.
+    explicit Raytracer(std::shared_ptr<ThreadPool>);
 
-    // Render scene.
-    void Render(const Scene&, const Camera&, Framebuffer&) const;
+    // Add a copy of the material and returns its id.
+    int AddMaterial(const Material&);
 
-private:
-    Math::Vector Raycast(const Math::Ray&, const Scene&, const float drawDistance) const;
+    // Materials by their ids, the default material has id 0.
+    const std::vector<Material>& Materials() const { return materials; }
+
+    // Change settings. Changing the thread count restarts the own thread pool, a shared one is kept.
+    // Anti-aliasing sample counts 2 and 3 are raised to 4, see RenderSettings::antialiasingSamples.
+    void SetSettings(const RenderSettings&);
+    const RenderSettings& Settings() const { return settings; }
+
+    // Number of the rendering threads including the calling thread.
+    int ThreadCount() const { return threadPool->ThreadCount(); }
+
+    // Render scene. The framebuffer is split into tiles rendered in parallel,
+    // the result does not depend on the thread count. The framebuffer is resolved at the end.
+    // Only primitives changed since the previous call are transformed again and the acceleration
+    // structure is kept between the calls, see Primitive::Invalidate() and Accelerator::Update().
+    void Render(const Scene&, const Camera&, Framebuffer&);
+
+    // Called after each progressive pass with its block size, returns false to cancel the remaining passes.
+    using PassCallback = std::function<bool(int blockSize)>;
+
+    // Render scene from coarse to fine. The first pass traces one ray per 8x8 pixel block and fills the block,
+    // the next passes trace only the pixels not traced yet and fill 4x4 and 2x2 blocks and finally single pixels.
+    // The last pass completes the same image as Render() with the same number of rays, including the anti-aliasing.
+    // The framebuffer is resolved after each pass and can be presented in the callback. Returns false if the passes were cancelled.
+    bool RenderProgressive(const Scene&, const Camera&, Framebuffer&, const PassCallback&);
+
+    // Render the part of an image of the full size, the framebuffer covers the pixels from (x, y), e.g. a tile of an image
+    // rendered on several machines. The pixels are bit-identical with the same pixels of Render(), except the anti-aliasing
+    // of the framebuffer border pixels whose outer neighbours are not known. Render one pixel larger part and discard its
+    // border to get identical anti-aliased pixels. The incremental rendering is not used.
+    void RenderRegion(const Scene&, const Camera&, Framebuffer&, const int fullWidth, const int fullHeight, const int x, const int y);
+
+    // Timings of the last Render() call.
+    const RenderTimings& Timings() const { return timings; }
+
+    // Counters and phase times of the last Render(), RenderProgressive() or RenderRegion() call.
+    const RenderStats& Stats() const { return stats; }
+
+    // Per-pixel costs of the last Render() call with the cost instrumentation, see RenderSettings.
+    const PixelCosts& Costs() const { return costs; }
+
+    // Diffuse and specular contribution of the light to the surface sample seen from the camera position.
     Math::Vector Shade(const RaycastSample& sample, const Math::Vector& camera, const Light&, const Material&) const;
 
-    std::vector<std::shared_ptr<const Material>> materials;
+private:
+    // Primary rays generator.
+    struct Projection
+    {
+        Math::Vector origin;
+        Math::Vector look;
+        Math::Vector up;
+        Math::Vector left;
+        float width = 0.f;
+        float height = 0.f;
+
+        // Position of the framebuffer in the image.
+        int offsetX = 0;
+        int offsetY = 0;
+
+        Projection() = default;
+        Projection(const Camera&, const int width, const int height, const int offsetX = 0, const int offsetY = 0);
+
+        bool operator==(const Projection&) const;
+
+        // Pixels [x0; x1) x [y0; y1).
+        struct Rect
+        {
+            int x0;
+            int y0;
+            int x1;
+            int y1;
+        };
+
+        // Pixels whose rays can hit the box, the whole framebuffer if the box reaches behind the camera.
+        Rect Footprint(const Math::Box&) const;
+
+        // Ray through the image point, pixel centers are at (x + 0.5, y + 0.5).
+        Math::Ray Ray(const float x, const float y) const;
+
+        // Ray through the point (sx, sy) within the framebuffer pixel, in [0; 1) for points inside of the pixel.
+        Math::Ray PixelRay(const int x, const int y, const float sx, const float sy) const;
+    };
+
+    // Image size and the framebuffer position in the image of the RenderRegion() call.
+    struct Region
+    {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Traced pixel: color and primitive hit (nullptr for the background) of the pixel center.
+    // The shadow rays of the pixel, including the anti-aliasing samples, start in the sphere
+    // around the shadow origin, the radius is negative if no shadow ray starts in the pixel.
+    struct PixelSample
+    {
+        Math::Vector color;
+        Math::Vector shadowOrigin;
+        float shadowRadius = -1.f;
+        const Primitive* primitive = nullptr;
+    };
+
+    // Scene state of the last frame for the incremental rendering.
+    struct Frame
+    {
+        // The frame was completed and the pixel samples are valid.
+        bool valid = false;
+
+        // Identifier of the frame in the framebuffer, see Framebuffer::FrameId().
+        uint64_t id = 0;
+        int width = 0;
+        int height = 0;
+        Projection projection;
+        float drawDistance = 0.f;
+        Math::Vector backgroundColor;
+        Math::Vector ambientLight;
+        std::vector<Light> lights;
+        ResolveSettings resolving;
+    };
+
+    // Pixels traced by a rendering pass. The traced pixels lie on the grid with the block size and their color
+    // fills the whole block. Refining passes skip the pixels traced by the previous pass with twice the block size.
+    struct Pass
+    {
+        int blockSize;
+        bool refine;
+
+        // Traced pixels for the anti-aliasing and the incremental rendering, nullptr if they are disabled.
+        PixelSample* pixels = nullptr;
+
+        // Only the pixels with nonzero mask values are traced, all if nullptr.
+        const uint8_t* mask = nullptr;
+
+        // Costs of the instrumented pixels, nullptr without the instrumentation.
+        PixelCosts* costs = nullptr;
+
+        bool Traced(const int x, const int y, const int width) const;
+
+        // Number of pixels traced in the framebuffer.
+        uint64_t PixelCount(const int width, const int height) const;
+
+        // Store the color of the traced pixel to its block.
+        void Store(Framebuffer&, const int x, const int y, const PixelSample&) const;
+    };
+
+    // Counters of a rendering thread on its own cache lines, the tile counters are added after every tile.
+    // The vector allocator keeps the alignment, operator new of C++14 does not.
+    struct alignas(64) ThreadCounters
+    {
+        StatisticsCounters counters;
+    };
+
+    // Transform the changed primitives, update the acceleration structure and bin the lights.
+    // Allocates the pixel samples for the anti-aliasing and clears the thread counters.
+    void Prepare(const Scene&, const Framebuffer&);
+
+    // Sum the thread counters and set the statistics of the call started at the start time.
+    void CollectStats(const std::chrono::steady_clock::time_point start);
+
+    // Projection of the framebuffer pixels, the region of the current RenderRegion() call or the whole image.
+    Projection FramebufferProjection(const Camera&, const Framebuffer&) const;
+
+    // Render the pass over all tiles, the timings are added to the current ones.
+    // Masked passes skip the tiles without masked pixels.
+    void RenderPass(const Scene&, const Camera&, Framebuffer&, const Pass&);
+
+    // Pixel samples are needed by the anti-aliasing or the incremental rendering.
+    bool KeepPixels() const;
+
+    // The last frame can be updated incrementally.
+    bool Incremental(const Scene&, const Camera&, const Framebuffer&) const;
+
+    // Mark the pixels affected by the changed primitives in the mask and re-trace them.
+    void RenderIncremental(const Scene&, const Camera&, Framebuffer&);
+
+    // Remember the scene state of the completed frame and mark the framebuffer with the frame identifier.
+    void StoreFrame(const Scene&, const Camera&, Framebuffer&);
+
+    // Resolve the framebuffer rows in parallel.
+    // The masked resolve skips the bands of tiles without retraced pixels and their neighbours.
+    void Resolve(Framebuffer&, const bool masked = false);
+
+    // Side of the stratified sample grid of the anti-aliased pixels, 1 if the anti-aliasing is disabled.
+    int AntialiasingGrid() const;
+
+    // Supersample the pixels on the edges of the last rendered pixel samples.
+    // With the mask only the masked pixels and their neighbours are updated, the other ones reset to their samples.
+    // The costs of the samples are added to the instrumented pixels.
+    void Antialias(const Scene&, const Camera&, Framebuffer&, const uint8_t* mask = nullptr, PixelCosts* costs = nullptr);
+
+    // Pixel differs from a neighbour in the primitive or in the color.
+    bool Edge(const int x, const int y, const int width, const int height) const;
+
+    // Supersample the edge pixels of the tile and return their count, the shadow rays are added to the counter.
+    // The shadow spheres of the pixel samples are extended by the samples.
+    uint64_t AntialiasTile(const Scene&, const Accelerator&, const Projection&, const float drawDistance, Framebuffer&, const uint8_t* mask, PixelCosts* costs, const int x0, const int y0, const int x1, const int y1, uint64_t& shadowRays, StatisticsCounters&);
+
+    // Render the tile and return the number of traced shadow rays, the work is added to the counters.
+    uint64_t RenderTile(const Scene&, const Accelerator&, const Projection&, const float drawDistance, Framebuffer&, const Pass&, const int x0, const int y0, const int x1, const int y1, StatisticsCounters&) const;
+    uint64_t RenderTilePackets(const Scene&, const Accelerator&, const Projection&, const float drawDistance, Framebuffer&, const Pass&, const int x0, const int y0, const int x1, const int y1, StatisticsCounters&) const;
+
+    // Color of the ray and the hit primitive, the work is counted with the NoCounters or TraceCounters policy.
+    template <typename Counters>
+    PixelSample Raycast(const Math::Ray&, const Scene&, const Accelerator&, const float drawDistance, uint64_t& shadowRays, Counters&) const;
+
+    // Raycast() of the pixel ray, with the costs its work and time are also added to the pixel.
+    PixelSample TracePixel(const Math::Ray&, const Scene&, const Accelerator&, const float drawDistance, uint64_t& shadowRays, PixelCosts* costs, const size_t index, StatisticsCounters&) const;
+
+    // Start of the shadow rays above the surface.
+    Math::Vector ShadowOrigin(const RaycastSample&) const;
+
+    // Color of the surface hit, ambient and all visible lights in range.
+    // The traced shadow rays are added to the shadowRays counter.
+    template <typename Counters>
+    Math::Vector Lighting(const Math::Ray&, const Scene&, const Accelerator&, const RaycastSample&, const Primitive&, uint64_t& shadowRays, Counters&) const;
+
+    std::vector<Material> materials;
+
+    RenderSettings settings;
+    std::shared_ptr<ThreadPool> threadPool;
+    bool sharedThreadPool = false;
+
+    // Acceleration structure of the last rendered scene.
+    Accelerator accelerator;
+
+    // Pixel traversal order of the tiles.
+    PixelTraversal traversal;
+
+    // Lights of the last rendered scene binned by their range.
+    LightGrid lightGrid;
+
+    // Pixel samples of the last rendered frame, used by the anti-aliasing and the incremental rendering.
+    std::vector<PixelSample> pixels;
+
+    // Pixels and tiles re-traced by the incremental rendering.
+    std::vector<uint8_t> mask;
+    std::vector<uint8_t> maskedTiles;
+
+    Frame frame;
+
+    // Rendered part of the image, zero size outside of RenderRegion().
+    Region region;
+
+    RenderTimings timings;
+    PixelCosts costs;
+
+    // Counters of the rendering threads and the statistics of the last call.
+    std::vector<ThreadCounters, AlignedAllocator<ThreadCounters>> threadCounters;
+    RenderStats stats;
 };
\ No newline at end of file
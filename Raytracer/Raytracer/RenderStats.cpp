@@ -0,0 +1,44 @@
+#include "RenderStats.h"
+#include <cstdio>
+
+void RenderStats::SetCounters(const TraceCounters& counters)
+{
+    primaryRays = counters.primaryRays;
+    primaryHits = counters.primaryHits;
+    primaryMisses = counters.primaryRays - counters.primaryHits;
+    shadowRays = counters.shadowRays;
+    shadowHits = counters.shadowHits;
+    shadowMisses = counters.shadowRays - counters.shadowHits;
+    nodes = counters.nodes;
+    triangleTests = counters.tests[static_cast<int>(PrimitiveType::Triangle)];
+    sphereTests = counters.tests[static_cast<int>(PrimitiveType::Sphere)];
+    planeTests = counters.tests[static_cast<int>(PrimitiveType::Plane)];
+    genericTests = counters.tests[static_cast<int>(PrimitiveType::Generic)];
+    lightEvaluations = counters.lights;
+}
+
+std::string RenderStats::Json() const
+{
+    const auto count = [](const uint64_t value)
+    {
+        return static_cast<unsigned long long>(value);
+    };
+
+    char text[1024];
+    std::snprintf(text, sizeof(text),
+        "{\"enabled\":%s,"
+        "\"primaryRays\":%llu,\"primaryHits\":%llu,\"primaryMisses\":%llu,"
+        "\"shadowRays\":%llu,\"shadowHits\":%llu,\"shadowMisses\":%llu,"
+        "\"nodes\":%llu,"
+        "\"tests\":{\"triangle\":%llu,\"sphere\":%llu,\"plane\":%llu,\"generic\":%llu},"
+        "\"lightEvaluations\":%llu,"
+        "\"times\":{\"transform\":%.9f,\"build\":%.9f,\"trace\":%.9f,\"resolve\":%.9f,\"total\":%.9f}}",
+        enabled ? "true" : "false",
+        count(primaryRays), count(primaryHits), count(primaryMisses),
+        count(shadowRays), count(shadowHits), count(shadowMisses),
+        count(nodes),
+        count(triangleTests), count(sphereTests), count(planeTests), count(genericTests),
+        count(lightEvaluations),
+        transform, build, trace, resolve, total);
+    return text;
+}
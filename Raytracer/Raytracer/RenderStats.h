@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "Raytracer/TraceCounters.h"
+
+// Counters and phase times of the last rendered frame, see Raytracer::Stats().
+// The counters are summed from the per-thread counters after the frame. They stay zero
+// if the library is compiled with RAYTRACER_STATS=0, the times are always measured.
+struct RenderStats
+{
+    // The counters are compiled in.
+    bool enabled = RAYTRACER_STATS != 0;
+
+    // Primary rays including the anti-aliasing samples, the hits found a primitive.
+    uint64_t primaryRays = 0;
+    uint64_t primaryHits = 0;
+    uint64_t primaryMisses = 0;
+
+    // Shadow rays, the hits found an occluder and the misses reached the light.
+    uint64_t shadowRays = 0;
+    uint64_t shadowHits = 0;
+    uint64_t shadowMisses = 0;
+
+    // Visited acceleration structure nodes, the packet traversals count a node once per packet.
+    uint64_t nodes = 0;
+
+    // Intersection tests by the primitive type, the packet kernels count all lanes.
+    // Triangles of the instanced meshes are triangle tests.
+    uint64_t triangleTests = 0;
+    uint64_t sphereTests = 0;
+    uint64_t planeTests = 0;
+    uint64_t genericTests = 0;
+
+    // Lights evaluated at the hit points.
+    uint64_t lightEvaluations = 0;
+
+    // Wall times of the phases in seconds, see RenderTimings, and of the whole call.
+    double transform = 0.0;
+    double build = 0.0;
+    double trace = 0.0;
+    double resolve = 0.0;
+    double total = 0.0;
+
+    // Set the counters from the thread counters summed over the frame.
+    void SetCounters(const TraceCounters&);
+
+    // Single line JSON object with all values, the times are in seconds.
+    std::string Json() const;
+};
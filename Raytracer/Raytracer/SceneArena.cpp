@@ -0,0 +1,33 @@
+#include "SceneArena.h"
+#include <algorithm>
+
+const size_t SceneArena::FirstBlockSize;
+const size_t SceneArena::MaxBlockSize;
+
+SceneArena::~SceneArena()
+{
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+    {
+        it->destroy(it->object);
+    }
+}
+
+void* SceneArena::Allocate(const size_t size, const size_t alignment)
+{
+    void* memory = current;
+    if (current == nullptr || std::align(alignment, size, memory, remaining) == nullptr)
+    {
+        // New block large enough for the aligned object, the rest of the old block is left unused.
+        const size_t blockSize = std::max(nextBlockSize, size + alignment);
+        blocks.emplace_back(new unsigned char[blockSize]);
+        nextBlockSize = std::min(2 * nextBlockSize, MaxBlockSize);
+
+        memory = blocks.back().get();
+        remaining = blockSize;
+        std::align(alignment, size, memory, remaining);
+    }
+
+    current = static_cast<unsigned char*>(memory) + size;
+    remaining -= size;
+    return memory;
+}
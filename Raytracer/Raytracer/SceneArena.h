@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Contiguous storage of the scene objects: primitives and lights.
+// Objects are constructed one after another in large blocks instead of separate heap allocations.
+// The returned pointers are plain handles owned by the arena, there is no reference counting.
+// They are valid until the arena is destroyed, which destroys all objects and frees the blocks at once.
+// The arena is not thread-safe.
+class SceneArena
+{
+public:
+    SceneArena() = default;
+    SceneArena(const SceneArena&) = delete;
+    SceneArena& operator=(const SceneArena&) = delete;
+    ~SceneArena();
+
+    // Construct the object in the arena.
+    template <typename T, typename... Args>
+    T* Make(Args&&... args);
+
+    // Number of the allocated blocks and of the constructed objects.
+    size_t BlockCount() const { return blocks.size(); }
+    size_t ObjectCount() const { return objectCount; }
+
+private:
+    // The first block is small for the small scenes, the next ones double up to the maximum size.
+    static const size_t FirstBlockSize = 4096;
+    static const size_t MaxBlockSize = 1 << 20;
+
+    // Destructor of an object, they run in the reverse order of the construction.
+    struct Destructor
+    {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    // Memory of the given size and alignment in the current block or in a new one.
+    void* Allocate(const size_t size, const size_t alignment);
+
+    std::vector<std::unique_ptr<unsigned char[]>> blocks;
+    std::vector<Destructor> destructors;
+    size_t objectCount = 0;
+
+    // Free part of the current block.
+    unsigned char* current = nullptr;
+    size_t remaining = 0;
+    size_t nextBlockSize = FirstBlockSize;
+};
+
+template <typename T, typename... Args>
+T* SceneArena::Make(Args&&... args)
+{
+    T* const object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+    {
+        destructors.push_back({object, [](void* pointer) { static_cast<T*>(pointer)->~T(); }});
+    }
+    ++objectCount;
+    return object;
+}
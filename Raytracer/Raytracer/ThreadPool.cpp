@@ -0,0 +1,158 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+    // Pool index of the thread working on the tasks.
+    thread_local int threadIndex = 0;
+
+    // Number of the pool threads, values < 1 use all hardware threads.
+    size_t PoolSize(const int threadCount)
+    {
+        if (threadCount < 1)
+        {
+            return static_cast<size_t>(std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+        }
+        return static_cast<size_t>(threadCount);
+    }
+}
+
+ThreadPool::ThreadPool(const int threadCount):
+    queues(PoolSize(threadCount))
+{
+    // The thread 0 is the caller of the Run() function.
+    for (int i = 1; i < ThreadCount(); ++i)
+    {
+        threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(signalMutex);
+        stop = true;
+    }
+    wakeCondition.notify_all();
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::Run(const int count, const std::function<void(int)>& task)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    job = &task;
+    pending = count;
+
+    // Distribute the tasks in contiguous blocks, neighbouring tasks stay on the same thread.
+    const int threadCount = ThreadCount();
+    for (int i = 0; i < threadCount; ++i)
+    {
+        const int begin = count * i / threadCount;
+        const int end = count * (i + 1) / threadCount;
+
+        std::lock_guard<std::mutex> lock(queues[i].mutex);
+        for (int t = begin; t < end; ++t)
+        {
+            queues[i].tasks.push_back(t);
+        }
+    }
+
+    // Wake up the workers.
+    if (!threads.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(signalMutex);
+            ++generation;
+        }
+        wakeCondition.notify_all();
+    }
+
+    // Work on the calling thread too.
+    Work(0);
+
+    // Wait for the tasks stolen by other threads.
+    std::unique_lock<std::mutex> lock(signalMutex);
+    doneCondition.wait(lock, [this] { return pending.load() == 0; });
+    job = nullptr;
+}
+
+int ThreadPool::ThreadIndex()
+{
+    return threadIndex;
+}
+
+void ThreadPool::WorkerLoop(const int index)
+{
+    uint64_t seenGeneration = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(signalMutex);
+            wakeCondition.wait(lock, [&] { return stop || generation != seenGeneration; });
+            if (stop)
+            {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        Work(index);
+    }
+}
+
+void ThreadPool::Work(const int index)
+{
+    threadIndex = index;
+    int task = 0;
+    while (Pop(index, task) || Steal(index, task))
+    {
+        (*job)(task);
+
+        // The last finished task signals the waiting caller.
+        if (pending.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(signalMutex);
+            doneCondition.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::Pop(const int index, int& task)
+{
+    Queue& queue = queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::Steal(const int index, int& task)
+{
+    const int threadCount = ThreadCount();
+    for (int i = 1; i < threadCount; ++i)
+    {
+        Queue& queue = queues[(index + i) % threadCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Raytracer/AlignedAllocator.h"
+
+// Persistent pool of worker threads.
+// Every thread owns a task deque, idle threads steal tasks from the other deques.
+// There is no global task queue and no global lock on the task path.
+class ThreadPool
+{
+public:
+    // The calling thread of the Run() function works as one of the threads,
+    // so the pool starts threadCount - 1 background threads. Values < 1 use all hardware threads.
+    explicit ThreadPool(const int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int ThreadCount() const { return static_cast<int>(queues.size()); }
+
+    // Index of the pool thread running the current task, in [0; ThreadCount()), the caller of Run() is 0.
+    static int ThreadIndex();
+
+    // Run task(i) for each i in range [0; count) and wait for all tasks.
+    // Tasks are initially split to the thread deques in contiguous blocks.
+    void Run(const int count, const std::function<void(int)>& task);
+
+private:
+    // Deques on separate cache lines, the allocator keeps the alignment.
+    struct alignas(64) Queue
+    {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    void WorkerLoop(const int index);
+
+    // Execute the tasks until all deques are empty.
+    void Work(const int index);
+
+    // Pop a task from the front of the own deque.
+    bool Pop(const int index, int& task);
+
+    // Steal a task from the back of another thread deque.
+    bool Steal(const int index, int& task);
+
+    std::vector<Queue, AlignedAllocator<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    // Current job, valid while there are pending tasks.
+    const std::function<void(int)>* job = nullptr;
+    std::atomic<int> pending{0};
+
+    // Worker wake-up and job completion signaling.
+    std::mutex signalMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    uint64_t generation = 0;
+    bool stop = false;
+};
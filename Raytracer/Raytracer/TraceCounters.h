@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include "Raytracer/PrimitiveData.h"
+#include "Raytracer/RayPacket.h"
+
+// The render statistics are counted unless the library is compiled with RAYTRACER_STATS=0.
+#ifndef RAYTRACER_STATS
+#define RAYTRACER_STATS 1
+#endif
+
+// Work of the ray queries counted by the instrumented traversals.
+// Packet traversals count a node once per packet and a test for every lane.
+struct TraceCounters
+{
+    static const int TypeCount = static_cast<int>(PrimitiveType::Generic) + 1;
+
+    // Primary rays including the anti-aliasing samples and the rays which hit a primitive.
+    uint64_t primaryRays = 0;
+    uint64_t primaryHits = 0;
+
+    // Shadow rays and the rays which hit an occluder.
+    uint64_t shadowRays = 0;
+    uint64_t shadowHits = 0;
+
+    // Visited acceleration structure nodes of all hierarchy levels.
+    uint64_t nodes = 0;
+
+    // Intersection tests by the PrimitiveType, the triangles of the instanced meshes are counted as triangles.
+    uint64_t tests[TypeCount] = {};
+
+    // Lights shaded at the hit points.
+    uint64_t lights = 0;
+
+    void Primary(const bool hit) { ++primaryRays; primaryHits += hit ? 1 : 0; }
+    void Shadow(const bool hit) { ++shadowRays; shadowHits += hit ? 1 : 0; }
+    void AddNodes(const uint64_t count) { nodes += count; }
+    void Test(const PrimitiveType type) { ++tests[static_cast<int>(type)]; }
+    void AddTests(const PrimitiveType type, const uint64_t count) { tests[static_cast<int>(type)] += count; }
+    void PacketTest(const PrimitiveType type) { tests[static_cast<int>(type)] += RayPacket::Size; }
+    void Light() { ++lights; }
+
+    // Intersection tests of all types.
+    uint64_t Tests() const;
+
+    TraceCounters& operator+=(const TraceCounters&);
+};
+
+// Counter policy of the uninstrumented queries, compiles to nothing.
+struct NoCounters
+{
+    void Primary(const bool) {}
+    void Shadow(const bool) {}
+    void AddNodes(const uint64_t) {}
+    void Test(const PrimitiveType) {}
+    void AddTests(const PrimitiveType, const uint64_t) {}
+    void PacketTest(const PrimitiveType) {}
+    void Light() {}
+
+    NoCounters& operator+=(const NoCounters&) { return *this; }
+    NoCounters& operator+=(const TraceCounters&) { return *this; }
+};
+
+// Counter policy of the rendering, the render statistics.
+#if RAYTRACER_STATS
+using StatisticsCounters = TraceCounters;
+#else
+using StatisticsCounters = NoCounters;
+#endif
+
+inline uint64_t TraceCounters::Tests() const
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < TypeCount; ++i)
+    {
+        sum += tests[i];
+    }
+    return sum;
+}
+
+inline TraceCounters& TraceCounters::operator+=(const TraceCounters& other)
+{
+    primaryRays += other.primaryRays;
+    primaryHits += other.primaryHits;
+    shadowRays += other.shadowRays;
+    shadowHits += other.shadowHits;
+    nodes += other.nodes;
+    for (int i = 0; i < TypeCount; ++i)
+    {
+        tests[i] += other.tests[i];
+    }
+    lights += other.lights;
+    return *this;
+}
@@ -0,0 +1,21 @@
+#include "TriangleMesh.h"
+
+void TriangleMesh::SetGeometry(std::vector<float> x, std::vector<float> y, std::vector<float> z, std::vector<uint32_t> indices)
+{
+    auto mesh = std::make_shared<MeshGeometry>();
+    mesh->Build(std::move(x), std::move(y), std::move(z), std::move(indices));
+    geometry = std::move(mesh);
+
+    // World bounds must be updated.
+    Invalidate();
+}
+
+void TriangleMesh::SetGeometry(const std::vector<Math::Vector>& vertices, const std::vector<uint32_t>& indices)
+{
+    auto mesh = std::make_shared<MeshGeometry>();
+    mesh->Build(vertices, indices);
+    geometry = std::move(mesh);
+
+    // World bounds must be updated.
+    Invalidate();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Math/Math.h"
+#include "Raytracer/Instance.h"
+
+// Indexed triangle mesh with a single object transformation (position, rotation).
+// The mesh is an instance of its own geometry, see Instance and MeshGeometry.
+class TriangleMesh: public Instance
+{
+public:
+    // Set the mesh geometry and build the mesh BVH, see MeshGeometry::Build().
+    void SetGeometry(std::vector<float> x, std::vector<float> y, std::vector<float> z, std::vector<uint32_t> indices);
+    void SetGeometry(const std::vector<Math::Vector>& vertices, const std::vector<uint32_t>& indices);
+
+    size_t VertexCount() const { return geometry != nullptr ? geometry->VertexCount() : 0; }
+    size_t TriangleCount() const { return geometry != nullptr ? geometry->TriangleCount() : 0; }
+};